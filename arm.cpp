@@ -23,8 +23,17 @@
 #include <cstring>
 
 #include "arm.hpp"
+#include "cache.hpp"
+#include "callgraph.hpp"
+#include "cp15.hpp"
+#include "disasm.hpp"
 #include "endian.h"
+#include "linux.hpp"
 #include "memory.hpp"
+#include "perf.hpp"
+#include "replay.hpp"
+#include "semihost.hpp"
+#include "stats.hpp"
 
 /* Shift/Rotate macros */
 #define LSL(x,y)	(x << y)
@@ -32,6 +41,22 @@
 #define ASR(x,y)	((x & (1 << 31)) ? ((x >> y) | ((~0 >> (32 - y)) << (32 - y))) : (x >> y))
 #define ROR(x,y)	((x >> y) | (x << (32 - y)))
 
+/*
+ * Only the active mode's registers live in r[] and spsr. A mode switch
+ * parks r13, r14 and the SPSR of the old mode in its bank slots and
+ * loads the new ones (plus r8-r12 when entering or leaving FIQ), so
+ * taking an interrupt never copies the whole register file.
+ */
+
+/* Bank of each mode */
+static const u8 ModeBank[32] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	BANK_USR, BANK_FIQ, BANK_IRQ, BANK_SVC,		// 0x10-0x13
+	0, 0, 0, BANK_ABT,				// 0x14-0x17
+	0, 0, 0, BANK_UND,				// 0x18-0x1B
+	0, 0, 0, BANK_USR,				// 0x1C-0x1F
+};
+
 
 ARM::ARM(void)
 {
@@ -40,10 +65,64 @@ ARM::ARM(void)
 	lr = (u32 *)(r + 14);
 	pc = (u32 *)(r + 15);
 
+	/* Tracing */
+	verbose = true;
+	trace   = NULL;
+	replay  = NULL;
+	calls   = NULL;
+	mix     = NULL;
+
+	/* Watchpoints */
+	watched = false;
+
+	/* High-level SWIs */
+	trapswi = false;
+
+#ifdef __CACHE_MODEL__
+	/* No timing model */
+	model = NULL;
+#endif
+
+	/* Cycle table */
+	CycleTable::Init();
+
+	/* System control coprocessor */
+	cp15    = new CP15(this);
+	aborted = false;
+
+	/* Performance counters */
+	perf = new PerfCounters(this);
+
+	Memory::SetFaultHook(Fault, this);
+
+	/* Host output */
+	output[0] = new Writer(stdout);
+	output[1] = new Writer(stderr);
+
+	/* Built-in syscalls */
+	kernel   = NULL;
+	semihost = new Semihost(this);
+
 	/* Reset */
 	Reset();
 }
 
+ARM::~ARM(void)
+{
+	/* Free host output */
+	delete output[0];
+	delete output[1];
+
+	/* Free semihosting */
+	delete semihost;
+
+	/* Free coprocessor */
+	delete cp15;
+
+	/* Free counters */
+	delete perf;
+}
+
 bool ARM::CondCheck(u32 opcode)
 {
 	/* Check condition */
@@ -122,105 +201,6 @@ bool ARM::CondCheck(u16 opcode)
 	return false;
 }
 
-void ARM::CondPrint(u32 opcode)
-{
-	/* Check condition */
-	switch (opcode >> 28) {
-	case EQ:
-		printf("eq"); break;
-	case NE:
-		printf("ne"); break;
-	case CS:
-		printf("cs"); break;
-	case CC:
-		printf("cc"); break;
-	case MI:
-		printf("mi"); break;
-	case PL:
-		printf("pl"); break;
-	case VS:
-		printf("vs"); break;
-	case VC:
-		printf("vc"); break;
-	case HI:
-		printf("hi"); break;
-	case LS:
-		printf("ls"); break;
-	case GE:
-		printf("ge"); break;
-	case LT:
-		printf("lt"); break;
-	case GT:
-		printf("gt"); break;
-	case LE:
-		printf("le"); break;
-	}
-}
-
-void ARM::CondPrint(u16 opcode)
-{
-	/* Check condition */
-	switch ((opcode >> 8) & 0xF) {
-	case EQ:
-		printf("eq"); break;
-	case NE:
-		printf("ne"); break;
-	case CS:
-		printf("cs"); break;
-	case CC:
-		printf("cc"); break;
-	case MI:
-		printf("mi"); break;
-	case PL:
-		printf("pl"); break;
-	case VS:
-		printf("vs"); break;
-	case VC:
-		printf("vc"); break;
-	case HI:
-		printf("hi"); break;
-	case LS:
-		printf("ls"); break;
-	case GE:
-		printf("ge"); break;
-	case LT:
-		printf("lt"); break;
-	case GT:
-		printf("gt"); break;
-	case LE:
-		printf("le"); break;
-	}
-}
-
-void ARM::SuffPrint(u32 opcode)
-{
-	if ((opcode >> 20) & 1)
-		printf("s");
-}
-
-void ARM::ShiftPrint(u32 opcode)
-{
-	u32 amt = (opcode >> 7)  & 0x1F;
-
-	if (!amt)
-		return;
-
-	switch ((opcode >> 5) & 3) {
-	case 0:
-		printf(",LSL#%d", amt);
-		break;
-	case 1:
-		printf(",LSR#%d", amt);
-		break;
-	case 2:
-		printf(",ASR#%d", amt);
-		break;
-	case 3:
-		printf(",ROR#%d", amt);
-		break;
-	}
-}
-
 bool ARM::CarryFrom(u32 a, u32 b)
 {
 	return ((a + b) < a) ? true : false;
@@ -335,10 +315,8 @@ void ARM::Parse(void)
 {
 	u32 opcode;
 
-	printf("%08X [A] ", *pc);
-
 	/* Read opcode */
-	opcode = Memory::Read32(*pc);
+	opcode = Memory::Fetch32(*pc);
 
 	/* Update PC */
 	*pc += sizeof(opcode);
@@ -360,13 +338,17 @@ void ARM::Parse(void)
 	bool S = (opcode >> 20) & 1;
 	bool L = (opcode >> 20) & 1;
 
+	/* Cycle cost (a failed condition issues in one cycle and reads nothing) */
+	u16 entry = CycleTable::Arm[CycleTable::ArmIndex(opcode)];
+
+	if ((opcode >> 28) == 0xF || CondCheck(opcode))
+		Charge(entry, CycleTable::ArmUses(entry, opcode), Rd);
+	else
+		Charge(1, 0, 16);
+
 	if (((opcode >> 8) & 0xFFFFF) == 0x12FFF) {
 		bool link = (opcode >> 5) & 1;
 
-		printf("b%sx", (link) ? "l" : "");
-		CondPrint(opcode);
-		printf(" r%d\n", Rm);
-
 		if (!CondCheck(opcode))
 			return;
 
@@ -381,26 +363,18 @@ void ARM::Parse(void)
 	if ((opcode >> 24) == 0xEF) {
 		u32 Imm = opcode & 0xFFFFFF;
 
-		printf("swi 0x%X\n", Imm);
-		ParseSvc(Imm & 0xFF);
+		ParseSvc(Imm);
 
 		return;
 	}
 
 	if (((opcode >> 22) & 0x3F) == 0 &&
 	    ((opcode >>  4) & 0x0F) == 9) {
-		printf("%s", (W) ? "mla" : "mul");
-		CondPrint(opcode);
-		SuffPrint(opcode);
-
-		printf(" r%d, r%d, r%d", Rn, Rm, Rs);
-		if (W)
-			printf(", r%d", Rd);
-		printf("\n");
-
 		if (!CondCheck(opcode))
 			return;
 
+		cost += CycleTable::Multiply(r[Rs]);
+
 		if (W)
 			r[Rn] = (r[Rm] * r[Rs] + r[Rd]) & 0xFFFFFFFF;
 		else
@@ -418,18 +392,6 @@ void ARM::Parse(void)
 	case 0: {
 		switch ((opcode >> 21) & 0xF) {
 		case 0: {		// AND
-			printf("and");
-			CondPrint(opcode);
-			SuffPrint(opcode);
-
-			if (!I) {
-				printf(" r%d, r%d, r%d", Rd, Rn, Rm);
-				ShiftPrint(opcode);
-			} else
-				printf(" r%d, r%d, #0x%X", Rd, Rn, ROR(Imm, amt));
-
-			printf("\n");
-
 			if (!CondCheck(opcode))
 				return;
 
@@ -443,22 +405,10 @@ void ARM::Parse(void)
 				cpsr.n = r[Rd] >> 31;
 			}
 
-			return;
+			break;
 		}
 
 		case 1: {		// EOR
-			printf("eor");
-			CondPrint(opcode);
-			SuffPrint(opcode);
-
-			if (!I) {
-				printf(" r%d, r%d, r%d", Rd, Rn, Rm);
-				ShiftPrint(opcode);
-			} else
-				printf(" r%d, r%d, #0x%X", Rd, Rn, ROR(Imm, amt));
-
-			printf("\n");
-
 			if (!CondCheck(opcode))
 				return;
 
@@ -472,22 +422,10 @@ void ARM::Parse(void)
 				cpsr.n = r[Rd] >> 31;
 			}
 
-			return;
+			break;
 		}
 
 		case 2: {		// SUB
-			printf("sub");
-			CondPrint(opcode);
-			SuffPrint(opcode);
-
-			if (!I) {
-				printf(" r%d, r%d, r%d", Rd, Rn, Rm);
-				ShiftPrint(opcode);
-			} else
-				printf(" r%d, r%d, #0x%X", Rd, Rn, ROR(Imm, amt));
-
-			printf("\n");
-
 			if (!CondCheck(opcode))
 				return;
 
@@ -503,22 +441,10 @@ void ARM::Parse(void)
 				cpsr.n = r[Rd] >> 31;
 			}
 
-			return;
+			break;
 		}
 
 		case 3: {		// RSB
-			printf("rsb");
-			CondPrint(opcode);
-			SuffPrint(opcode);
-
-			if (!I) {
-				printf(" r%d, r%d, r%d", Rd, Rn, Rm);
-				ShiftPrint(opcode);
-			} else
-				printf(" r%d, r%d, #0x%X", Rd, Rn, ROR(Imm, amt));
-
-			printf("\n");
-
 			if (!CondCheck(opcode))
 				return;
 
@@ -534,22 +460,10 @@ void ARM::Parse(void)
 				cpsr.n = r[Rd] >> 31;
 			}
 
-			return;
+			break;
 		}
 
 		case 4: {		// ADD
-			printf("add");
-			CondPrint(opcode);
-			SuffPrint(opcode);
-
-			if (!I) {
-				printf(" r%d, r%d, r%d", Rd, Rn, Rm);
-				ShiftPrint(opcode);
-			} else
-				printf(" r%d, r%d, #0x%X", Rd, Rn, ROR(Imm, amt));
-
-			printf("\n");
-
 			if (!CondCheck(opcode))
 				return;
 
@@ -568,22 +482,10 @@ void ARM::Parse(void)
 				cpsr.n = r[Rd] >> 31;
 			}
 
-			return;
+			break;
 		}
 
 		case 5: {		// ADC
-			printf("adc");
-			CondPrint(opcode);
-			SuffPrint(opcode);
-
-			if (!I) {
-				printf(" r%d, r%d, r%d", Rd, Rn, Rm);
-				ShiftPrint(opcode);
-			} else
-				printf(" r%d, r%d, #0x%X", Rd, Rn, ROR(Imm, amt));
-
-			printf("\n");
-
 			if (!CondCheck(opcode))
 				return;
 
@@ -597,22 +499,10 @@ void ARM::Parse(void)
 				cpsr.n = r[Rd] >> 31;
 			}
 
-			return;
+			break;
 		}
 
 		case 6: {		// SBC
-			printf("sbc");
-			CondPrint(opcode);
-			SuffPrint(opcode);
-
-			if (!I) {
-				printf(" r%d, r%d, r%d", Rd, Rn, Rm);
-				ShiftPrint(opcode);
-			} else
-				printf(" r%d, r%d, #0x%X", Rd, Rn, ROR(Imm, amt));
-
-			printf("\n");
-
 			if (!CondCheck(opcode))
 				return;
 
@@ -628,22 +518,10 @@ void ARM::Parse(void)
 				cpsr.n = r[Rd] >> 31;
 			}
 
-			return;
+			break;
 		}
 
 		case 7: {		// RSC
-			printf("rsc");
-			CondPrint(opcode);
-			SuffPrint(opcode);
-
-			if (!I) {
-				printf(" r%d, r%d, r%d", Rd, Rn, Rm);
-				ShiftPrint(opcode);
-			} else
-				printf(" r%d, r%d, #0x%X", Rd, Rn, ROR(Imm, amt));
-
-			printf("\n");
-
 			if (!CondCheck(opcode))
 				return;
 
@@ -659,127 +537,78 @@ void ARM::Parse(void)
 				cpsr.n = r[Rd] >> 31;
 			}
 
-			return;
+			break;
 		}
 
 		case 8: {		// TST/MRS
 			if (S) {
 				u32 result;
 
-				printf("tst");
-				CondPrint(opcode);
-
-				if (!I) {
-					printf(" r%d, r%d\n", Rn, Rm);
-					ShiftPrint(opcode);
-
+				if (!I)
 					result = r[Rn] & Shift(opcode, r[Rm]);
-				} else {
-					printf(" r%d, #0x%X\n", Rn, ROR(Imm, amt));
+				else
 					result = r[Rn] & ROR(Imm, amt);
-				}
 
 				cpsr.z = result == 0;
 				cpsr.n = result >> 31;
-			} else {
-				printf("mrs r%d, cpsr\n", Rd);
-				r[Rd] = cpsr.value;
-			}
+			} else
+				ParseMrs(opcode);
 
-			return;
+			break;
 		}
 
 		case 9: {		// TEQ/MSR
 			if (S) {
 				u32 result;
 
-				printf("teq");
-				CondPrint(opcode);
-
-				if (!I) {
-					printf(" r%d, r%d\n", Rn, Rm);
-					ShiftPrint(opcode);
-
+				if (!I)
 					result = r[Rn] ^ Shift(opcode, r[Rm]);
-				} else {
-					printf(" r%d, #0x%X\n", Rn, ROR(Imm, amt));
+				else
 					result = r[Rn] ^ ROR(Imm, amt);
-				}
 
 				cpsr.z = result == 0;
 				cpsr.n = result >> 31;
-			} else {
-				if (I) {
-					printf("msr cpsr, r%d\n", Rm);
-					cpsr.value = r[Rm];
-				} else {
-					printf("msr cpsr, 0x%08X\n", Imm);
-					cpsr.value = Imm;
-				}
-			}
+			} else
+				ParseMsr(opcode);
 
-			return;
+			break;
 		}
 
 		case 10: {		// CMP/MRS2
 			if (S) {
 				u32 value;
 
-				printf("cmp");
-				CondPrint(opcode);
-
-				if (I) {
+				if (I)
 					value = ROR(Imm, amt);
-					printf(" r%d, 0x%08X\n", Rn, value);
-				} else {
+				else
 					value = r[Rm];
-					printf(" r%d, r%d\n", Rn, Rm);
-				}
 
 				if (CondCheck(opcode))
 					Substract(r[Rn], value);
 			} else
-				printf("mrs2\n");
+				ParseMrs(opcode);
 
-			return;
+			break;
 		}
 
 		case 11: {		// CMN/MSR2
 			if (S) {
 				u32 value;
 
-				printf("cmn");
-				CondPrint(opcode);
-
-				if (I) {
+				if (I)
 					value = ROR(Imm, amt);
-					printf(" r%d, 0x%08X\n", Rn, value);
-				} else {
+				else
 					value = r[Rm];
-					printf(" r%d, r%d\n", Rn, Rm);
-				}
 
 				if (CondCheck(opcode))
 					Addition(r[Rn], value);
 			} else
-				printf("msr2\n");
+				ParseMsr(opcode);
 
-			return;
+			break;
 		}
 
 		case 12: {		// ORR
-			printf("orr");
-			CondPrint(opcode);
-			SuffPrint(opcode);
-
-			if (!I) {
-				printf(" r%d, r%d, r%d", Rd, Rn, Rm);
-				ShiftPrint(opcode);
-			} else
-				printf(" r%d, r%d, #0x%X", Rd, Rn, ROR(Imm, amt));
-
-			printf("\n");
-
 			if (!CondCheck(opcode))
 				return;
 
@@ -793,22 +622,10 @@ void ARM::Parse(void)
 				cpsr.n = r[Rd] >> 31;
 			}
 
-			return;
+			break;
 		}
 
 		case 13: {		// MOV
-			printf("mov");
-			CondPrint(opcode);
-			SuffPrint(opcode);
-
-			if (!I) {
-				printf(" r%d, r%d", Rd, Rm);
-				ShiftPrint(opcode);
-			} else
-				printf(" r%d, #0x%X", Rd, ROR(Imm, amt));
-
-			printf("\n");
-
 			if (!CondCheck(opcode))
 				return;
 
@@ -822,22 +639,10 @@ void ARM::Parse(void)
 				cpsr.n = r[Rd] >> 31;
 			}
 
-			return;
+			break;
 		}
 
 		case 14: {		// BIC
-			printf("bic");
-			CondPrint(opcode);
-			SuffPrint(opcode);
-
-			if (!I) {
-				printf(" r%d, r%d, r%d", Rd, Rn, Rm);
-				ShiftPrint(opcode);
-			} else
-				printf(" r%d, r%d, #0x%X", Rd, Rn, ROR(Imm, amt));
-
-			printf("\n");
-
 			if (!CondCheck(opcode))
 				return;
 
@@ -851,22 +656,10 @@ void ARM::Parse(void)
 				cpsr.n = r[Rd] >> 31;
 			}
 
-			return;
+			break;
 		}
 
 		case 15: {		// MVN
-			printf("mvn");
-			CondPrint(opcode);
-			SuffPrint(opcode);
-
-			if (!I) {
-				printf(" r%d, r%d", Rd, Rm);
-				ShiftPrint(opcode);
-			} else
-				printf(" r%d, #0x%X", Rd, ROR(Imm, amt));
-
-			printf("\n");
-
 			if (!CondCheck(opcode))
 				return;
 
@@ -880,18 +673,20 @@ void ARM::Parse(void)
 				cpsr.n = r[Rd] >> 31;
 			}
 
-			return;
+			break;
 		}
 		}
+
+		/* Exception return (S set with pc as destination, USR/SYS have no SPSR) */
+		if (S && Rd == 15 && ((opcode >> 23) & 3) != 2 && bank.current != BANK_USR)
+			SetCPSR(spsr);
+
+		return;
 	}
 
 	case 1: {		// LDR/STR
 		u32  addr, value, wb;
 
-		printf("%s%s", (L) ? "ldr" : "str", (B) ? "b" : "");
-		CondPrint(opcode);
-		printf(" r%d,", Rd);
-
 		Imm = opcode & 0xFFF;
 
 		if (L && Rn == 15) {
@@ -901,22 +696,13 @@ void ARM::Parse(void)
 			if (CondCheck(opcode))
 				r[Rd] = value;
 
-			printf(" =0x%X\n", value);
 			return;
 		}
 
-		printf(" [r%d", Rn);
-
-		if (I) {
+		if (I)
 			value = Shift(opcode, r[Rm]);
-
-			printf(", %sr%d", (U) ? "" : "-", Rm);
-			ShiftPrint(opcode);
-		} else {
+		else
 			value = Imm;
-			printf(", #%s0x%X", (U) ? "" : "-", value);
-		}
-		printf("]%s\n", (W) ? "!" : "");
 
 		if (!CondCheck(opcode))
 			return;
@@ -952,53 +738,19 @@ void ARM::Parse(void)
 
 	switch ((opcode >> 25) & 7) {
 	case 4: {		// LDM/STM
-		u32  start = r[Rn];
-		bool pf    = false;
+		u32 start = r[Rn];
 
-		if (L) {
-			printf("ldm");
-			if (Rn == 13)
-				printf("%c%c", (P) ? 'e' : 'f', (U) ? 'd' : 'a');
-			else
-				printf("%c%c", (U) ? 'i' : 'd', (P) ? 'b' : 'a');
-		} else {
-			printf("stm");
-			if (Rn == 13)
-				printf("%c%c", (P) ? 'f' : 'e', (U) ? 'a' : 'd');
-			else
-				printf("%c%c", (U) ? 'i' : 'd', (P) ? 'b' : 'a');
-		}
-
-		if (Rn == 13)
-			printf(" sp");
-		else
-			printf(" r%d", Rn);
+		/* S bit: user bank transfer, or exception return with pc */
+		bool ret  = B && L && (opcode & (1 << 15));
+		bool user = B && !ret;
 
-		if (W) printf("!");
-		printf(", {");
-
-		for (s32 i = 0; i < 16; i++) {
-			if ((opcode >> i) & 1) {
-				if (pf) printf(", ");
-				printf("r%d", i);
-
-				pf = true;
-			}
-		}
-
-		printf("}");
-		if (B) {
-			printf("^");
-			if (opcode & (1 << 15))
-				cpsr.value = spsr;
-		}
-		printf("\n");
+		cost += CycleTable::Transfer(opcode & 0xFFFF);
 
 		if (L) {
 			for (s32 i = 0; i < 16; i++) {
 				if ((opcode >> i) & 1) {
 					if (P)  start += (U) ? sizeof(u32) : -sizeof(u32);
-					r[i] = Memory::Read32(start);
+					*((user) ? UserReg(i) : &r[i]) = Memory::Read32(start);
 					if (!P) start += (U) ? sizeof(u32) : -sizeof(u32);
 				}
 			}
@@ -1006,28 +758,28 @@ void ARM::Parse(void)
 			for (s32 i = 15; i >= 0; i--) {
 				if ((opcode >> i) & 1) {
 					if (P)  start += (U) ? sizeof(u32) : -sizeof(u32);
-					Memory::Write32(start, r[i]);
+					Memory::Write32(start, *((user) ? UserReg(i) : &r[i]));
 					if (!P) start += (U) ? sizeof(u32) : -sizeof(u32);
 				}
 			}
 		}
 
 		if (W) r[Rn] = start;
+
+		/* Restore status (not on a data abort, USR/SYS have no SPSR) */
+		if (ret && !aborted && bank.current != BANK_USR)
+			SetCPSR(spsr);
+
 		return;
 	}
 
 	case 5: {		// B/BL
 		bool link = opcode & (1 << 24);
 
-		printf("b%s", (link) ? "l" : "");
-		CondPrint(opcode);
-
 		Imm = (opcode & 0xFFFFFF) << 2;
 		if (Imm & (1 << 25)) Imm = ~(~Imm & 0xFFFFFF);
 		Imm += sizeof(opcode);
 
-		printf(" 0x%08X\n", *pc + Imm);
-
 		if (!CondCheck(opcode))
 			return;
 
@@ -1037,27 +789,50 @@ void ARM::Parse(void)
 		return;
 	}
 
-	case 7: {		// MRC
-		printf("mrc ...\n");
+	case 7: {		// MRC/MCR
+		u32 cp  = (opcode >> 8) & 0xF;
+		u32 op2 = (opcode >> 5) & 7;
+
+		/* Register transfers to CP15 only */
+		if ((opcode & (1 << 24)) || !(opcode & (1 << 4)) || cp != 15)
+			return;
+
+		if (!CondCheck(opcode))
+			return;
+
+		if (L) {
+			u32 value = cp15->Read(Rn, Rm, op2);
+
+			/* Rd = pc sets the flags */
+			if (Rd == 15)
+				cpsr.value = (cpsr.value & 0x0FFFFFFF) | (value & 0xF0000000);
+			else
+				r[Rd] = value;
+		} else
+			cp15->Write(Rn, Rm, op2, (Rd == 15) ? *pc + 4 : r[Rd]);
+
 		return;
 	}
 	}
-
-	printf("Unknown opcode! (0x%08X)\n", opcode);
 }
 
 void ARM::ParseThumb(void)
 {
 	u16 opcode;
-
-	printf("%08X [T] ", *pc);
+	u16 entry;
 
 	/* Read opcode */
-	opcode = Memory::Read16(*pc);
+	opcode = Memory::Fetch16(*pc);
 
 	/* Update PC */
 	*pc += sizeof(opcode);
 
+	/* Cycle cost */
+	entry = CycleTable::Thumb[opcode >> 8];
+
+	Charge(entry, CycleTable::ThumbUses(entry, opcode),
+	       (entry & CYCLE_HIRD) ? (opcode >> 8) & 7 : opcode & 7);
+
 	if ((opcode >> 13) == 0) {
 		u32 Imm = (opcode >> 6) & 0x1F;
 		u32 Rn  = (opcode >> 6) & 7;
@@ -1079,7 +854,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("lsl r%d, r%d, #0x%02X\n", Rd, Rm, Imm);
 			return;
 		}
 
@@ -1097,7 +871,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("lsr r%d, r%d, #0x%02X\n", Rd, Rm, Imm);
 			return;
 		}
 
@@ -1115,7 +888,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("asr r%d, r%d, #0x%02X\n", Rd, Rm, Imm);
 			return;
 		}
 
@@ -1126,23 +898,18 @@ void ARM::ParseThumb(void)
 				if (opcode & 0x200) {
 					r[Rd] = Substract(r[Rm], Imm);
 
-					printf("sub r%d, r%d, #0x%02X\n", Rd, Rm, Imm);
 					return;
 				} else {
 					r[Rd] = Addition(r[Rm], Imm);
-
-					printf("add r%d, r%d, #0x%02X\n", Rd, Rm, Imm);
 				}
 			} else {
 				if (opcode & 0x200) {
 					r[Rd] = Substract(r[Rm], r[Rn]);
 
-					printf("sub r%d, r%d, r%d\n", Rd, Rm, Rn);
 					return;
 				} else {
 					r[Rd] = Addition(r[Rm], r[Rn]);
 
-					printf("add r%d, r%d, r%d\n", Rd, Rm, Rn);
 					return;
 				}
 			}
@@ -1163,28 +930,24 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rn] == 0;
 			cpsr.n = r[Rn] >> 31;
 
-			printf("mov r%d, #0x%02X\n", Rn, Imm);
 			return;
 		}
 
 		case 1: {		// CMP
 			Substract(r[Rn], Imm);
 
-			printf("cmp r%d, #0x%02X\n", Rn, Imm);
 			return;
 		}
 
 		case 2: {		// ADD
 			r[Rn] = Addition(r[Rn], Imm);
 
-			printf("add r%d, #0x%02X\n", Rn, Imm);
 			return;
 		}
 
 		case 3: {		// SUB
 			r[Rn] = Substract(r[Rn], Imm);
 
-			printf("sub r%d, #0x%02X\n", Rn, Imm);
 			return;
 		}
 		}
@@ -1201,7 +964,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("and r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
@@ -1211,7 +973,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("eor r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
@@ -1231,7 +992,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("lsl r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
@@ -1251,7 +1011,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("lsr r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
@@ -1276,7 +1035,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("asr r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
@@ -1287,7 +1045,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("adc r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
@@ -1298,7 +1055,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("sbc r%d, r%d\n", Rd, Rm);
 			return;
 		}
 			
@@ -1316,7 +1072,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("ror r%d, r%d\n", Rd, Rm);
 			return;			
 		}
 
@@ -1326,7 +1081,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = result == 0;
 			cpsr.n = result >> 31;
 
-			printf("tst r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
@@ -1336,14 +1090,12 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("neg r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
 		case 10: {		// CMP
 			Substract(r[Rd], r[Rm]);
 
-			printf("cmp r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
@@ -1353,12 +1105,8 @@ void ARM::ParseThumb(void)
 
 				cpsr.z = r[Rd] == 0;
 				cpsr.n = r[Rd] >> 31;
-
-				printf("mvn r%d, r%d\n", Rd, Rm);
 			} else {
 				Addition(r[Rd], r[Rm]);
-
-				printf("cmn r%d, r%d\n", Rd, Rm);
 			}
 
 			return;
@@ -1370,17 +1118,17 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("orr r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
 		case 13: {		// MUL
+			cost += CycleTable::Multiply(r[Rd]);
+
 			r[Rd] *= r[Rm];
 
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("mul r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
@@ -1390,7 +1138,6 @@ void ARM::ParseThumb(void)
 			cpsr.z = r[Rd] == 0;
 			cpsr.n = r[Rd] >> 31;
 
-			printf("bic r%d, r%d\n", Rd, Rm);
 			return;
 		}
 		}
@@ -1404,7 +1151,6 @@ void ARM::ParseThumb(void)
 		cpsr.t = r[Rm] & 1;
 		*pc    = r[Rm] & ~1;
 
-		printf("blx r%d\n", Rm);
 		return;
 	}
 
@@ -1416,26 +1162,22 @@ void ARM::ParseThumb(void)
 		case 0: {		// ADD
 			r[Rd] = Addition(r[Rd], r[Rm]);
 
-			printf("add r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
 		case 1: {		// CMP
 			Substract(r[Rd], r[Rm]);
 
-			printf("cmp r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
 		case 2: {		// MOV (NOP)
 			if (Rd == 8 && Rm == 8) {
-				printf("nop\n");
 				return;
 			}
 
 			r[Rd] = r[Rm];
 
-			printf("mov r%d, r%d\n", Rd, Rm);
 			return;
 		}
 
@@ -1447,7 +1189,6 @@ void ARM::ParseThumb(void)
 			else
 				*pc = r[Rm] & ~1;
 
-			printf("bx r%d\n", Rm);
 			return;
 		}
 		}
@@ -1460,7 +1201,6 @@ void ARM::ParseThumb(void)
 
 		r[Rd] = Memory::Read32(addr);
 
-		printf("ldr r%d, =0x%08X\n", Rd, r[Rd]);
 		return;
 	}
 
@@ -1476,7 +1216,6 @@ void ARM::ParseThumb(void)
 
 			Memory::Write32(addr, value);
 
-			printf("str r%d, [r%d, r%d]\n", Rd, Rn, Rm);
 			return;
 		}
 
@@ -1486,7 +1225,6 @@ void ARM::ParseThumb(void)
 
 			Memory::Write8(addr, value);
 
-			printf("strb r%d, [r%d, r%d]\n", Rd, Rn, Rm);
 			return;
 		}
 
@@ -1495,7 +1233,6 @@ void ARM::ParseThumb(void)
 
 			r[Rd] = Memory::Read32(addr);
 
-			printf("ldr r%d, [r%d, r%d]\n", Rd, Rn, Rm);
 			return;
 		}
 
@@ -1504,7 +1241,6 @@ void ARM::ParseThumb(void)
 
 			r[Rd] = Memory::Read8(addr);
 
-			printf("ldrb r%d, [r%d, r%d]\n", Rd, Rn, Rm);
 			return;
 		}
 		}
@@ -1520,30 +1256,22 @@ void ARM::ParseThumb(void)
 				u32 addr = r[Rn] + (Imm << 2);
 
 				r[Rd] = Memory::Read8(addr);
-
-				printf("ldrb r%d, [r%d, 0x%02X]\n", Rd, Rn, Imm);
 			} else {
 				u32 addr  = r[Rn] + (Imm << 2);
 				u8  value = r[Rd] & 0xFF;
 
 				Memory::Write8(addr, value);
-
-				printf("strb r%d, [r%d, 0x%02X]\n", Rd, Rn, Imm);
 			}
 		} else {
 			if (opcode & 0x800) {
 				u32 addr = r[Rn] + (Imm << 2);
 
 				r[Rd] = Memory::Read32(addr);
-
-				printf("ldr r%d, [r%d, 0x%02X]\n", Rd, Rn, Imm << 2);
 			} else {
 				u32 addr  = r[Rn] + (Imm << 2);
 				u32 value = r[Rd];
 
 				Memory::Write32(addr, value);
-
-				printf("str r%d, [r%d, 0x%02X]\n", Rd, Rn, Imm << 2);
 			}
 		}
 
@@ -1559,15 +1287,11 @@ void ARM::ParseThumb(void)
 			u32 addr = r[Rn] + (Imm << 1);
 
 			r[Rd] = Memory::Read16(addr);
-
-			printf("ldrh r%d, [r%d, 0x%02X]\n", Rd, Rn, Imm << 1);
 		} else {
 			u32 addr  = r[Rn] + (Imm << 1);
 			u16 value = r[Rd];
 
 			Memory::Write16(addr, value);
-
-			printf("strh r%d, [r%d, 0x%02X]\n", Rd, Rn, Imm << 1);
 		}
 
 		return;
@@ -1581,15 +1305,11 @@ void ARM::ParseThumb(void)
 			u32 addr = *sp + (Imm << 2);
 
 			r[Rd] = Memory::Read32(addr);
-
-			printf("ldr r%d, [sp, 0x%02X]\n", Rd, Imm << 2);
 		} else {
 			u32 addr  = *sp + (Imm << 2);
 			u32 value = r[Rd];
 
 			Memory::Write32(addr, value);
-
-			printf("str r%d, [sp, 0x%02X]\n", Rd, Imm << 2);
 		}
 
 		return;
@@ -1601,12 +1321,8 @@ void ARM::ParseThumb(void)
 
 		if (opcode & 0x800) {
 			r[Rd] = *sp + (Imm << 2);
-
-			printf("add r%d, sp, #0x%02X\n", Rd, Imm << 2);
 		} else {
 			r[Rd] = (*pc & ~2) + (Imm << 2);
-
-			printf("add r%d, pc, #0x%02X\n", Rd, Imm << 2);
 		}
 
 		return;
@@ -1619,10 +1335,8 @@ void ARM::ParseThumb(void)
 
 			if (opcode & 0x80) {
 				*sp -= Imm << 2;
-				printf("sub sp, #0x%02X\n", Imm << 2);
 			} else {
 				*sp += Imm << 2;
-				printf("add sp, #0x%02X\n", Imm << 2);
 			}
 
 			return;
@@ -1630,7 +1344,8 @@ void ARM::ParseThumb(void)
 
 		case 2: {		// PUSH
 			bool lrf = opcode & 0x100;
-			bool pf  = false;
+
+			cost += CycleTable::Transfer(opcode & 0x1FF);
 
 			if (lrf)
 				Push(*lr);
@@ -1639,51 +1354,23 @@ void ARM::ParseThumb(void)
 				if ((opcode >> i) & 1)
 					Push(r[i]);
 
-			printf("push {");
-
-			for (s32 i = 0; i < 8; i++) {
-				if ((opcode >> i) & 1) {
-					if (pf) printf(",");
-					printf("r%d", i);
-
-					pf = true;
-				}
-			}
-
-			if (lrf) {
-				if (pf) printf(",");
-				printf("lr");
-			}
-
-			printf("}\n");
 			return;
 		}
 
 		case 6: {		// POP
 			bool pcf = opcode & 0x100;
-			bool pf  = false;
-
-			printf("pop {");
 
-			for (s32 i = 0; i < 8; i++) {
-				if ((opcode >> i) & 1) {
-					if (pf) printf(",");
-					printf("r%d", i);
+			cost += CycleTable::Transfer(opcode & 0x1FF);
 
+			for (s32 i = 0; i < 8; i++)
+				if ((opcode >> i) & 1)
 					r[i] = Pop();
-					pf   = true;
-				}
-			}
 
 			if (pcf) {
-				if (pf) printf(",");
-				printf("pc");
-
 				*pc    = Pop();
 				cpsr.t = *pc & 1;
 			}
 
-			printf("}\n");
 			return;
 		}
 		}
@@ -1692,37 +1379,34 @@ void ARM::ParseThumb(void)
 	if ((opcode >> 12) == 12) {
 		u32 Rn = (opcode >> 8) & 7;
 
-		if (opcode & 0x800) {
-			printf("ldmia r%d!, {", Rn);
+		cost += CycleTable::Transfer(opcode & 0xFF);
 
+		if (opcode & 0x800) {
 			for (u32 i = 0; i < 8; i++) {
 				if ((opcode >> i) & 1) {
 					r[i]   = Memory::Read32(r[Rn]);
 					r[Rn] += sizeof(u32);
-					
-					printf("r%d,", i);
 				}
 			}
 
-			printf("}\n");
 			return;
 		} else {
-			printf("stmia r%d!, {", Rn);
-
 			for (u32 i = 0; i < 8; i++) {
 				if ((opcode >> i) & 1) {
 					Memory::Write32(r[Rn], r[i]);
 					r[Rn] += sizeof(u32);
-					
-					printf("r%d,", i);
 				}
 			}
 
-			printf("}\n");
 			return;
 		}
 	}
 
+	if ((opcode >> 8) == 0xDF) {
+		ParseSvc(opcode & 0xFF);
+		return;
+	}
+
 	if ((opcode >> 12) == 13) {
 		u32 Imm = (opcode & 0xFF) << 1;
 
@@ -1731,10 +1415,6 @@ void ARM::ParseThumb(void)
 
 		Imm += 2;
 
-		printf("b");
-		CondPrint(opcode);
-		printf(" 0x%08X\n", *pc + Imm);
-
 		if (CondCheck(opcode))
 			*pc += Imm;
 
@@ -1750,12 +1430,11 @@ void ARM::ParseThumb(void)
 		} else
 			*pc += Imm + 2;
 
-		printf("b 0x%08X, 0x%X\n", *pc, Imm);
 		return;
 	}
 
 	if ((opcode >> 11) == 0x1E) {
-		u32  opc = Memory::Read16(*pc);
+		u32  opc = Memory::Fetch16(*pc);
 
 		u32  Imm = ((opcode & 0x7FF) << 12) | ((opc & 0x7FF) << 1);
 		bool blx = ((opcode >> 11) & 3) == 3;
@@ -1769,22 +1448,211 @@ void ARM::ParseThumb(void)
 		} else
 			*pc += Imm + 2;
 
-		if (blx) {
+		if (blx)
 			cpsr.t = 0;
-			printf("blx 0x%08X\n", *pc);
-		} else
-			printf("bl 0x%08X\n", *pc);
 
 		return;
 	}
+}
+
+void ARM::Bank(u32 mode)
+{
+	u32 next = ModeBank[mode & 0x1F];
+	u32 prev = bank.current;
+
+	/* Same bank */
+	if (next == prev)
+		return;
+
+	/* Park current registers */
+	bank.sp  [prev] = r[13];
+	bank.lr  [prev] = r[14];
+	bank.spsr[prev] = spsr;
+
+	/* Swap r8-r12 */
+	if (prev == BANK_FIQ || next == BANK_FIQ) {
+		memcpy(bank.fiq[prev == BANK_FIQ], r + 8, sizeof(bank.fiq[0]));
+		memcpy(r + 8, bank.fiq[next == BANK_FIQ], sizeof(bank.fiq[0]));
+	}
+
+	/* Load new registers */
+	r[13] = bank.sp  [next];
+	r[14] = bank.lr  [next];
+	spsr  = bank.spsr[next];
+
+	bank.current = next;
+}
+
+void ARM::SetCPSR(u32 value)
+{
+	/* Switch registers, then status */
+	Bank(value & 0x1F);
+
+	cpsr.value = value;
+
+	/* Protection unit privilege */
+	Memory::SetUser(cpsr.mode == MODE_USR);
+}
+
+u32 *ARM::UserReg(u32 idx)
+{
+	/* Banked r13/r14 */
+	if (idx >= 13 && idx < 15 && bank.current != BANK_USR)
+		return (idx == 13) ? &bank.sp[BANK_USR] : &bank.lr[BANK_USR];
+
+	/* Banked r8-r12 */
+	if (idx >= 8 && idx < 13 && bank.current == BANK_FIQ)
+		return &bank.fiq[0][idx - 8];
+
+	return &r[idx];
+}
+
+void ARM::Exception(u32 vector, u32 ret)
+{
+	u32 status = cpsr.value;
+	u32 mode;
+
+	/* Target mode */
+	switch (vector) {
+	case VECTOR_UND:
+		mode = MODE_UND;
+		break;
+
+	case VECTOR_PABT:
+	case VECTOR_DABT:
+		mode = MODE_ABT;
+		break;
+
+	case VECTOR_IRQ:
+		mode = MODE_IRQ;
+		break;
+
+	case VECTOR_FIQ:
+		mode = MODE_FIQ;
+		break;
+
+	default:
+		mode = MODE_SVC;
+		break;
+	}
+
+	/* Enter mode */
+	Bank(mode);
+
+	spsr  = status;
+	*lr   = ret;
+
+	cpsr.mode = mode;
+	cpsr.t    = 0;
+	cpsr.I    = 1;
+
+	Memory::SetUser(false);
+
+	if (vector == VECTOR_FIQ || vector == VECTOR_RESET)
+		cpsr.F = 1;
+
+	/* Jump to vector */
+	*pc = vectors + vector;
+}
+
+bool ARM::Interrupt(bool fiq)
+{
+	/* Masked */
+	if ((fiq) ? cpsr.F : cpsr.I)
+		return false;
+
+	/* Return with SUBS pc, lr, #4 */
+	Exception((fiq) ? VECTOR_FIQ : VECTOR_IRQ, *pc + 4);
+
+	return true;
+}
+
+void ARM::ParseMrs(u32 opcode)
+{
+	u32 Rd = (opcode >> 12) & 0xF;
+	bool R = (opcode >> 22) & 1;
+
+	/* Check encoding */
+	if ((opcode & 0x0FBF0FFF) != 0x010F0000)
+		return;
+
+	if (!CondCheck(opcode))
+		return;
+
+	/* Read status register */
+	r[Rd] = (R) ? spsr : cpsr.value;
+}
+
+void ARM::ParseMsr(u32 opcode)
+{
+	u32  value, mask = 0;
+	bool R = (opcode >> 22) & 1;
+
+	/* Check encoding */
+	if ((opcode & 0x0FB0FFF0) != 0x0120F000 &&
+	    (opcode & 0x0FB0F000) != 0x0320F000)
+		return;
+
+	if (!CondCheck(opcode))
+		return;
+
+	/* Operand */
+	if ((opcode >> 25) & 1) {
+		u32 Imm = opcode & 0xFF;
+		u32 amt = ((opcode >> 8) & 0xF) << 1;
+
+		value = ROR(Imm, amt);
+	} else
+		value = r[opcode & 0xF];
+
+	/* Field mask (c, x, s, f) */
+	for (u32 i = 0; i < 4; i++) {
+		if ((opcode >> (16 + i)) & 1)
+			mask |= 0xFF << (i * 8);
+	}
+
+	/* Write status register */
+	if (R) {
+		spsr = (spsr & ~mask) | (value & mask);
+		return;
+	}
 
-	printf("Unknown opcode! (0x%04X)\n", opcode);
+	/* User mode only changes the flags */
+	if (cpsr.mode == MODE_USR)
+		mask &= 0xFF000000;
+
+	SetCPSR((cpsr.value & ~mask) | (value & mask));
 }
 
-void ARM::ParseSvc(u8 num)
+void ARM::ParseSvc(u32 num)
 {
 	u32 *ret = r + 0;
 
+	/* Replayed syscall */
+	if (replay && replay->Lookup(icount, *ret, finished))
+		return;
+
+	/* Semihosting call */
+	if (num == ((cpsr.t) ? SEMIHOST_THUMB : SEMIHOST_ARM)) {
+		semihost->Call();
+		goto out;
+	}
+
+	/* Guest SWI handler */
+	if (trapswi) {
+		Exception(VECTOR_SWI, *pc);
+		return;
+	}
+
+	/* Linux syscall */
+	if (kernel) {
+		kernel->Call(num);
+		goto out;
+	}
+
+	/* Syscall number */
+	num &= 0xFF;
+
 	/* Parse syscall */
 	switch (num) {
 	case 0: {		// exit
@@ -1794,20 +1662,28 @@ void ARM::ParseSvc(u8 num)
 	}
 
 	case 4: {		// write
+		struct iovec iov[WRITER_IOVS];
+
 		u32 fd   = r[0];
 		u32 addr = r[1];
 		u32 len  = r[2];
+		u32 cnt;
 
 		/* No output descriptor */
 		if (fd < 1 || fd > 2)
 			break;
 
-		/* Print string */
-		for (u32 i = 0; i < len; i++)
-			cout << Memory::Read8(addr + i);
+		/* Resolve guest buffer into host spans */
+		cnt = Memory::Spans(addr, len, iov, WRITER_IOVS, false);
 
 		/* Return value */
-		*ret = len;
+		*ret = 0;
+
+		for (u32 i = 0; i < cnt; i++)
+			*ret += iov[i].iov_len;
+
+		/* Write spans */
+		output[fd - 1]->Write(iov, cnt);
 
 		break;
 	}
@@ -1815,6 +1691,107 @@ void ARM::ParseSvc(u8 num)
 	default:
 		printf("         [S] Unhandled syscall! (%02X)\n", num);
 	}
+
+out:
+	/* Log result */
+	if (replay)
+		replay->Log(icount, *ret, finished);
+}
+
+void ARM::SvcStore(u32 address, const void *buf, u32 size)
+{
+	struct iovec iov[WRITER_IOVS];
+	const u8    *src = (const u8 *)buf;
+
+	u32 cnt;
+
+	/* Copy to guest */
+	cnt = Memory::Spans(address, size, iov, WRITER_IOVS, true);
+
+	for (u32 i = 0; i < cnt; i++) {
+		memcpy(iov[i].iov_base, src, iov[i].iov_len);
+		src += iov[i].iov_len;
+	}
+
+	/* Log for replay */
+	SvcLog(address, iov, cnt, src - (const u8 *)buf);
+}
+
+void ARM::SvcLog(u32 address, const struct iovec *iov, u32 cnt, u32 size)
+{
+	/* Not recording */
+	if (!replay)
+		return;
+
+	/* Log guest memory written by the syscall */
+	for (u32 i = 0; i < cnt && size; i++) {
+		u32 len = (iov[i].iov_len < size) ? iov[i].iov_len : size;
+
+		replay->LogData(address, iov[i].iov_base, len);
+
+		address += len;
+		size    -= len;
+	}
+}
+
+void ARM::Print(u32 address)
+{
+	/* Buffered guest output goes first (keeps the order on stdout) */
+	Flush();
+
+	/* Print instruction */
+	if (cpsr.t) {
+		u16 opcode = Memory::Fetch16(address);
+		u16 next   = Memory::Fetch16(address + sizeof(opcode));
+
+		Disasm::Thumb(stdout, address, opcode, next);
+	} else
+		Disasm::Arm(stdout, address, Memory::Fetch32(address));
+}
+
+void ARM::Record(u32 address)
+{
+	u32 opcode;
+	u8  flags = 0;
+
+	/* Read opcode */
+	if (cpsr.t) {
+		opcode = Memory::Fetch16(address);
+		flags |= REC_THUMB;
+
+		/* BL pair */
+		if ((opcode >> 11) == 0x1E) {
+			opcode |= (u32)Memory::Fetch16(address + 2) << 16;
+			flags  |= REC_WIDE;
+		}
+	} else
+		opcode = Memory::Fetch32(address);
+
+	/* Parse instruction */
+	if (cpsr.t)
+		ParseThumb();
+	else
+		Parse();
+
+	/* Record instruction */
+	trace->Record(address, opcode, flags, r, cpsr.value);
+}
+
+void ARM::Tally(u32 address)
+{
+	/* Count against the flags before execution */
+	if (cpsr.t) {
+		u16 opcode = Memory::Fetch16(address);
+
+		/* Only conditional branches test the flags */
+		bool bcc = (opcode >> 12) == 13 && (opcode >> 8) != 0xDF;
+
+		mix->Thumb(opcode, !bcc || CondCheck(opcode));
+	} else {
+		u32 opcode = Memory::Fetch32(address);
+
+		mix->Arm(opcode, CondCheck(opcode));
+	}
 }
 
 void ARM::Reset(void)
@@ -1823,8 +1800,36 @@ void ARM::Reset(void)
 	memset(r, 0, sizeof(r));
 	cpsr.value = spsr = 0;
 
+	/* Reset banks */
+	memset(&bank, 0, sizeof(bank));
+	bank.current = BANK_USR;
+
+	/* Coprocessor (low vectors) */
+	cp15->Reset();
+	aborted = false;
+
+	Memory::SetUser(false);
+
 	/* Reset flag */
 	finished = false;
+
+	/* Reset counters */
+	icount = 0;
+	cycles = 0;
+
+	perf->Reset();
+
+	cost     = 1;
+	loadreg  = 16;
+	loadwait = 0;
+	taken    = false;
+
+	/* Drop pending events */
+	events.Clear();
+
+	/* Nothing to attend */
+	__atomic_store_n(&attention, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&sample,    0, __ATOMIC_RELAXED);
 }
 
 bool ARM::Step(void)
@@ -1833,6 +1838,8 @@ bool ARM::Step(void)
 
 	/* Check finish flag */
 	if (finished) {
+		Flush();
+
 		cout << "FINISHED! (return: " << r[0] << ")" << endl;
 		return false;
 	}
@@ -1847,13 +1854,187 @@ bool ARM::Step(void)
 		return false;
 	}
 
+	/* Execute instruction */
+	Execute();
+
+	/* Deliver due events and interrupts */
+	return (Retire() == STOP_NONE);
+}
+
+void ARM::Execute(void)
+{
+	u32  address = *pc;
+	bool thumb   = cpsr.t;
+	u32  status  = cpsr.value;
+	u32  saved[15];
+
+	/* Registers before the instruction (base-restored aborts) */
+	if (Memory::Protected())
+		memcpy(saved, r, sizeof(saved));
+
+	/* Publish for samplers */
+	__atomic_store_n(&sample, address | thumb, __ATOMIC_RELAXED);
+
+#ifdef __CACHE_MODEL__
+	/* Instruction fetch */
+	if (model)
+		model->Fetch(address);
+#endif
+
+	/* Print instruction */
+	if (verbose)
+		Print(address);
+
+	/* Count instruction mix */
+	if (mix && Memory::Allowed(address, PERM_EXEC))
+		Tally(address);
+
 	/* Parse instruction */
-	if (cpsr.t)
+	if (!Memory::Allowed(address, PERM_EXEC)) {
+		Exception(VECTOR_PABT, address + 4);
+		cost = 1;
+	} else if (trace)
+		Record(address);
+	else if (cpsr.t)
 		ParseThumb();
 	else
 		Parse();
 
-	return true;
+	/* Data abort (return with SUBS pc, lr, #8) */
+	if (aborted) {
+		aborted = false;
+
+		/* Base restored, loaded registers not written */
+		if (cpsr.value != status)
+			SetCPSR(status);
+
+		memcpy(r, saved, sizeof(saved));
+
+		Exception(VECTOR_DABT, address + 8);
+	}
+
+	/* Taken branch (not the sequential successor in the state it ran in) */
+	taken = (*pc != address + ((thumb) ? 2 : 4)) || (cpsr.t != thumb);
+
+#ifdef __CACHE_MODEL__
+	/* Track calls, charge stalls */
+	if (model) {
+		model->Flow(address, *pc, *lr, thumb, taken);
+		cycles += model->Stalls();
+	}
+#endif
+
+	/* Count instruction (taken branches refill the pipeline) */
+	icount++;
+	cycles += cost + ((taken) ? CYCLE_REFILL : 0);
+
+	/* Track calls */
+	if (calls)
+		calls->Flow(address, *pc, *lr, thumb, taken);
+
+	/* Take checkpoint */
+	if (replay)
+		replay->Tick();
+}
+
+u32 ARM::Attend(bool stops)
+{
+	u32 word = __atomic_load_n(&attention, __ATOMIC_ACQUIRE);
+
+	/* Stop request (left pending if not taken now) */
+	if (stops && (word & ATTN_STOP)) {
+		Attention(ATTN_STOP, false);
+		return STOP_HALT;
+	}
+
+	/* Interrupts (FIQ first, level sensitive) */
+	if ((word & ATTN_FIQ) && Interrupt(true))
+		return STOP_NONE;
+
+	if (word & ATTN_IRQ)
+		Interrupt(false);
+
+	return STOP_NONE;
+}
+
+void ARM::Watch(void *priv, u32 address, u32 value, u8 flags)
+{
+	ARM *cpu  = (ARM *)priv;
+	u32  size = (flags & ACCESS_BLOCK) ? value : (flags & ACCESS_SIZE);
+	u8   type = (flags & ACCESS_WRITE) ? WATCH_WRITE : WATCH_READ;
+
+	vector<Watchpoint>::iterator it;
+
+	/* Search watchpoint */
+	for (it = cpu->watchpoint.begin(); it != cpu->watchpoint.end(); it++) {
+		/* Access overlaps the watched range */
+		if ((it->type & type) &&
+		    address < it->address + it->size &&
+		    it->address < address + size) {
+			cpu->watched  = true;
+			cpu->watchhit = *it;
+			return;
+		}
+	}
+}
+
+#ifdef __CACHE_MODEL__
+void ARM::SetModel(CacheModel *model)
+{
+	/* Set timing model */
+	this->model = model;
+
+	/* Current attributes */
+	if (model)
+		model->Configure(cp15);
+}
+#endif
+
+void ARM::Fault(void *priv, u32 address, u32 value, u8 flags)
+{
+	ARM *cpu = (ARM *)priv;
+
+	/* Taken after the instruction */
+	cpu->aborted = true;
+}
+
+u32 ARM::Run(u64 count, bool resume)
+{
+	/* Clear watchpoint hit */
+	watched = false;
+
+	/* Deliver events due before the first instruction */
+	events.Dispatch(cycles);
+
+	for (u64 i = 0; i < count; i++) {
+		u32 reason;
+
+		/* Check finish flag */
+		if (finished)
+			return STOP_FINISH;
+
+		/* Remove thumb bit */
+		*pc &= ~1;
+
+		/* Check breakpoint (a resumed CPU leaves the current one) */
+		if ((i || !resume) && BreakFind(*pc))
+			return STOP_BREAK;
+
+		/* Execute instruction */
+		Execute();
+
+		/* Deliver due events and interrupts (same order as Step) */
+		reason = Retire();
+
+		/* Check watchpoint */
+		if (watched)
+			return STOP_WATCH;
+
+		if (reason != STOP_NONE)
+			return reason;
+	}
+
+	return STOP_NONE;
 }
 
 void ARM::BreakAdd(u32 address)
@@ -1864,8 +2045,12 @@ void ARM::BreakAdd(u32 address)
 	ret = BreakFind(address);
 
 	/* Add breakpoint */
-	if (!ret)
+	if (!ret) {
 		breakpoint.push_back(address);
+
+		/* Mark page */
+		Memory::Mark(address, 1, PAGE_BREAK);
+	}
 }
 
 void ARM::BreakDel(u32 address)
@@ -1877,15 +2062,25 @@ void ARM::BreakDel(u32 address)
 		/* Delete breakpoint */
 		if (*it == address) {
 			breakpoint.erase(it);
-			return;
+			break;
 		}
 	}
+
+	/* Remark page */
+	Memory::Unmark(address, 1, PAGE_BREAK);
+
+	for (it = breakpoint.begin(); it != breakpoint.end(); it++)
+		Memory::Mark(*it, 1, PAGE_BREAK);
 }
 
 bool ARM::BreakFind(u32 address)
 {
 	vector<u32>::iterator it;
 
+	/* No breakpoint in this page */
+	if (!(Memory::Flags(address) & PAGE_BREAK))
+		return false;
+
 	/* Search breakpoint */
 	for (it = breakpoint.begin(); it != breakpoint.end(); it++) {
 		/* Found breakpoint */
@@ -1896,6 +2091,56 @@ bool ARM::BreakFind(u32 address)
 	return false;
 }
 
+void ARM::SetFlush(u32 policy)
+{
+	/* Set flush policy */
+	output[0]->SetPolicy(policy);
+	output[1]->SetPolicy(policy);
+}
+
+void ARM::Flush(void)
+{
+	/* Flush host output */
+	output[0]->Flush();
+	output[1]->Flush();
+}
+
+void ARM::WatchAdd(u32 address, u32 size, u8 type)
+{
+	Watchpoint watch;
+
+	/* Add watchpoint */
+	watch.address = address;
+	watch.size    = size;
+	watch.type    = type;
+
+	watchpoint.push_back(watch);
+
+	/* Mark pages */
+	Memory::Mark(address, size, PAGE_WATCH);
+	Memory::SetWatchHook(Watch, this);
+}
+
+void ARM::WatchDel(u32 address, u32 size, u8 type)
+{
+	vector<Watchpoint>::iterator it;
+
+	/* Search watchpoint */
+	for (it = watchpoint.begin(); it != watchpoint.end(); it++) {
+		/* Delete watchpoint */
+		if (it->address == address && it->size == size && it->type == type) {
+			watchpoint.erase(it);
+			break;
+		}
+	}
+
+	/* Remark pages */
+	Memory::Unmark(address, size, PAGE_WATCH);
+
+	for (it = watchpoint.begin(); it != watchpoint.end(); it++)
+		Memory::Mark(it->address, it->size, PAGE_WATCH);
+}
+
 void ARM::DumpRegs(void)
 {
 	cout << "REGISTERS DUMP:" << endl;
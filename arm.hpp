@@ -22,10 +22,24 @@
 #define _ARM9_HPP_
 
 #include <vector>
+#include "cycles.hpp"
+#include "scheduler.hpp"
+#include "trace.hpp"
 #include "types.h"
+#include "writer.hpp"
 
 using namespace std;
 
+/* Forward declarations */
+class CacheModel;
+class CallGraph;
+class InstrMix;
+class CP15;
+class Linux;
+class PerfCounters;
+class Replay;
+class Semihost;
+
 
 /* Condition codes */
 enum {
@@ -46,8 +60,85 @@ enum {
 	AL = 14,
 };
 
+/* Processor modes */
+enum {
+	MODE_USR = 0x10,
+	MODE_FIQ = 0x11,
+	MODE_IRQ = 0x12,
+	MODE_SVC = 0x13,
+	MODE_ABT = 0x17,
+	MODE_UND = 0x1B,
+	MODE_SYS = 0x1F,
+};
+
+/* Register banks */
+enum {
+	BANK_USR   = 0,			// Also SYS (and legacy mode 0)
+	BANK_FIQ   = 1,
+	BANK_IRQ   = 2,
+	BANK_SVC   = 3,
+	BANK_ABT   = 4,
+	BANK_UND   = 5,
+	BANK_COUNT = 6,
+};
+
+/* Exception vectors */
+enum {
+	VECTOR_RESET = 0x00,
+	VECTOR_UND   = 0x04,
+	VECTOR_SWI   = 0x08,
+	VECTOR_PABT  = 0x0C,
+	VECTOR_DABT  = 0x10,
+	VECTOR_IRQ   = 0x18,
+	VECTOR_FIQ   = 0x1C,
+};
+
+/* Banked registers (slots of the inactive modes) */
+struct RegBanks {
+	u32 sp  [BANK_COUNT];
+	u32 lr  [BANK_COUNT];
+	u32 spsr[BANK_COUNT];
+	u32 fiq [2][5];			// r8-r12 outside/inside FIQ
+	u32 current;			// Bank in r[] and spsr
+};
+
+/* Stop reasons */
+enum {
+	STOP_NONE   = 0,		// Step count exhausted
+	STOP_BREAK  = 1,
+	STOP_WATCH  = 2,
+	STOP_FINISH = 3,
+	STOP_HALT   = 4,		// Host stop request
+};
+
+/* Attention bits */
+enum {
+	ATTN_IRQ  = 1 << 0,
+	ATTN_FIQ  = 1 << 1,
+	ATTN_STOP = 1 << 2,
+};
+
+/* Watchpoint types */
+enum {
+	WATCH_READ  = 1 << 0,
+	WATCH_WRITE = 1 << 1,
+};
+
+/* Watchpoint */
+struct Watchpoint {
+	u32 address;
+	u32 size;
+	u8  type;
+};
+
 /* ARM class */
 class ARM {
+	friend class CP15;
+	friend class Linux;
+	friend class MicroBench;
+	friend class Replay;
+	friend class Semihost;
+
 	/* Registers */
 	u32 r[16];
 	u32 *pc;
@@ -57,6 +148,19 @@ class ARM {
 	/* Special registers */
 	union {
 		struct {
+#ifdef __HOST_LE__
+			u16  mode:5;
+			bool t:1;
+			bool F:1;
+			bool I:1;
+
+			unsigned pad:20;
+
+			bool v:1;
+			bool c:1;
+			bool z:1;
+			bool n:1;
+#else
 			bool n:1;
 			bool z:1;
 			bool c:1;
@@ -68,27 +172,93 @@ class ARM {
 			bool F:1;
 			bool t:1;
 			u16  mode:5;
+#endif
 		};
 		u32 value;
 	} cpsr;
 	u32 spsr;
 
+	/* Banked registers */
+	RegBanks bank;
+
+	/* Exception vector base */
+	u32 vectors;
+
+	/* SWIs enter the SVC vector */
+	bool trapswi;
+
+	/* System control coprocessor */
+	CP15 *cp15;
+
+	/* Performance counters */
+	PerfCounters *perf;
+
+	/* Data abort raised by the current instruction */
+	bool aborted;
+
+#ifdef __CACHE_MODEL__
+	/* Cache timing model */
+	CacheModel *model;
+#endif
+
 	/* Breakpoint list */
 	vector<u32> breakpoint;
 
+	/* Watchpoint list */
+	vector<Watchpoint> watchpoint;
+	Watchpoint watchhit;
+	bool       watched;
+
 	/* Finish flag */
 	bool finished;
 
+	/* Instruction counter */
+	u64 icount;
+
+	/* Cycle counter and events */
+	u64       cycles;
+	Scheduler events;
+
+	/* Cycle accounting */
+	u32 cost;			// Cycles of the current instruction
+	u32 loadreg;			// Destination of the last load (16 if none)
+	u32 loadwait;			// Its load-use interlock
+
+	/* Last instruction was a taken branch */
+	bool taken;
+
+	/* Executing instruction (bit 0 set in Thumb state), for samplers */
+	u32 sample;
+
+	/* Attention word (set from devices and other threads) */
+	u32 attention;
+
+	/* Tracing */
+	bool   verbose;
+	Trace *trace;
+
+	/* Checkpoints */
+	Replay *replay;
+
+	/* Call graph profiler */
+	CallGraph *calls;
+
+	/* Instruction mix statistics */
+	InstrMix *mix;
+
+	/* Host output (stdout, stderr) */
+	Writer *output[2];
+
+	/* Linux syscalls */
+	Linux *kernel;
+
+	/* Semihosting */
+	Semihost *semihost;
+
 private:
 	/* Condition functions */
 	bool CondCheck (u32 opcode);
 	bool CondCheck (u16 opcode);
-	void CondPrint (u32 opcode);
-	void CondPrint (u16 opcode);
-
-	/* Print functions */
-	void SuffPrint (u32 opcode);
-	void ShiftPrint(u32 opcode);
 
 	/* Helper functions */
 	bool CarryFrom (u32 a, u32 b);
@@ -104,25 +274,82 @@ private:
 	void Push(u32 value);
 	u32  Pop (void);
 
+	/* Cycle function, once per retired instruction (table entry, registers read, load destination) */
+	inline void Charge(u16 entry, u32 uses, u32 dst) {
+		cost = entry & CYCLE_BASE;
+
+		/* Uses the result of the previous load */
+		if (uses & (1 << loadreg))
+			cost += loadwait;
+
+		loadwait = (entry & CYCLE_WAIT) >> CYCLE_WAIT_SHIFT;
+		loadreg  = (loadwait) ? dst : 16;
+	}
+
+	/* Mode functions */
+	void Bank    (u32 mode);
+	void SetCPSR (u32 value);
+	u32 *UserReg (u32 idx);
+	void Exception(u32 vector, u32 ret);
+
 	/* Parse functions */
 	void Parse(void);
 	void ParseThumb(void);
-	void ParseSvc(u8 num);
+	void ParseMrs(u32 opcode);
+	void ParseMsr(u32 opcode);
+	void ParseSvc(u32 num);
+
+	/* Syscall helpers */
+	void SvcStore(u32 address, const void *buf, u32 size);
+	void SvcLog  (u32 address, const struct iovec *iov, u32 cnt, u32 size);
+
+	/* Trace functions */
+	void Print (u32 address);
+	void Record(u32 address);
+	void Tally (u32 address);
+
+	/* Execute functions */
+	void Execute(void);
+	u32  Attend (bool stops = true);
+
+	/* Instruction boundary (due events, then interrupts on block exits) */
+	inline u32 Retire(bool stops = true) {
+		events.Dispatch(cycles);
+
+		if (taken && __atomic_load_n(&attention, __ATOMIC_RELAXED))
+			return Attend(stops);
+
+		return STOP_NONE;
+	}
+
+	/* Memory hooks */
+	static void Watch(void *priv, u32 address, u32 value, u8 flags);
+	static void Fault(void *priv, u32 address, u32 value, u8 flags);
 
 public:
-	ARM(void);
+	 ARM(void);
+	~ARM(void);
 
 	/* Reset function */
 	void Reset(void);
 
 	/* Execute functions */
 	bool Step(void);
+	u32  Run (u64 count, bool resume = false);
 
 	/* Breakpoint functions */
 	void BreakAdd (u32 address);
 	void BreakDel (u32 address);
 	bool BreakFind(u32 address);
 
+	/* Watchpoint functions */
+	void WatchAdd(u32 address, u32 size, u8 type);
+	void WatchDel(u32 address, u32 size, u8 type);
+
+	inline const Watchpoint &WatchHit(void) {
+		return watchhit;
+	}
+
 	/* Dump functions */
 	void DumpRegs(void);
 	void DumpStack(u32 count);
@@ -139,6 +366,106 @@ public:
 	inline void SetPC(u32 val) {
 		*pc = val;
 	}
+
+	/* CPSR peek/poke */
+	inline u32 PeekCPSR(void) {
+		return cpsr.value;
+	}
+
+	inline void PokeCPSR(u32 val) {
+		SetCPSR(val);
+	}
+
+	/* Interrupt request (false if masked) */
+	bool Interrupt(bool fiq);
+
+#ifdef __CACHE_MODEL__
+	/* Timing model */
+	void SetModel(CacheModel *model);
+#endif
+
+	/* Attention functions */
+	inline void Attention(u32 bits, bool set) {
+		if (set)
+			__atomic_fetch_or (&attention,  bits, __ATOMIC_RELEASE);
+		else
+			__atomic_fetch_and(&attention, ~bits, __ATOMIC_RELEASE);
+	}
+
+	inline void Halt(void) {
+		Attention(ATTN_STOP, true);
+	}
+
+	/* Instruction counter */
+	inline u64 Count(void) {
+		return icount;
+	}
+
+	/* Cycle counter */
+	inline u64 Cycles(void) {
+		return cycles;
+	}
+
+	/* Last instruction branched (block exit) */
+	inline bool Taken(void) {
+		return taken;
+	}
+
+	/* Sampled instruction (safe from other threads) */
+	inline u32 Sample(void) {
+		return __atomic_load_n(&sample, __ATOMIC_RELAXED);
+	}
+
+	/* Performance counters */
+	inline PerfCounters *Counters(void) {
+		return perf;
+	}
+
+	/* Event scheduler */
+	inline Scheduler *Events(void) {
+		return &events;
+	}
+
+	/* Trace setup */
+	inline void SetVerbose(bool val) {
+		verbose = val;
+	}
+
+	inline void SetTrace(Trace *val) {
+		trace = val;
+	}
+
+	/* Checkpoint setup */
+	inline void SetReplay(Replay *val) {
+		replay = val;
+	}
+
+	/* Call graph setup */
+	inline void SetCallGraph(CallGraph *val) {
+		calls = val;
+	}
+
+	/* Statistics setup */
+	inline void SetMix(InstrMix *val) {
+		mix = val;
+	}
+
+	/* Syscall setup */
+	inline void SetKernel(Linux *val) {
+		kernel = val;
+	}
+
+	inline void SetTrapSwi(bool val) {
+		trapswi = val;
+	}
+
+	/* Output functions */
+	void SetFlush(u32 policy);
+	void Flush(void);
+
+	inline Writer *Output(u32 idx) {
+		return output[idx];
+	}
 };
 
 #endif /* _ARM9_HPP_ */
@@ -0,0 +1,61 @@
+/*
+ * ARM9 emulator - Microbenchmark tool
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstring>
+
+#include "arm.hpp"
+#include "microbench.hpp"
+
+using namespace std;
+
+
+static void Usage(const char *name)
+{
+	cerr << "[USAGE]: " << name << " [filter]" << endl;
+	cerr << endl;
+	cerr << "Runs the host microbenchmarks whose name contains <filter> (all by default):" << endl;
+	cerr << "  read32/write32   Memory accesses for different region counts" << endl;
+	cerr << "  vspace           Byte-swapping reads and writes" << endl;
+	cerr << "  cond, shift      Condition checks and the shifter" << endl;
+	cerr << "  add, sub         Flag computation" << endl;
+	cerr << "  decode, step     Instruction classes through Parse/ParseThumb" << endl;
+}
+
+int main(int argc, char **argv)
+{
+	ARM Cpu;
+
+	/* Show usage */
+	if (argc > 2 || (argc > 1 && !strcmp(argv[1], "-h"))) {
+		Usage(argv[0]);
+		return 1;
+	}
+
+	MicroBench Bench(&Cpu, (argc > 1) ? argv[1] : NULL);
+
+	/* No instruction printing */
+	Cpu.SetVerbose(false);
+
+	/* Run benchmarks */
+	Bench.RunAll();
+	Bench.Report();
+
+	return 0;
+}
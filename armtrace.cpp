@@ -0,0 +1,192 @@
+/*
+ * ARM9 emulator - Trace tool
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include "disasm.hpp"
+#include "memory.hpp"
+#include "symbols.hpp"
+#include "trace.hpp"
+#include "traceidx.hpp"
+
+using namespace std;
+
+
+/* Record being rendered */
+static TraceRecord Current;
+
+
+static u32 ReadLiteral(u32 address)
+{
+	/* Find load in the record */
+	for (u32 i = 0; i < Current.naccess; i++) {
+		TraceAccess *acc = &Current.access[i];
+
+		if (acc->address == address && !(acc->flags & ACCESS_WRITE))
+			return acc->value;
+	}
+
+	return -1;
+}
+
+static int Dis(const char *filename, const char *elffile)
+{
+	TraceReader Reader;
+	bool ret;
+
+	/* Open trace */
+	ret = Reader.Open(filename);
+	if (!ret) {
+		cerr << "[ERROR]: Could not open the trace file!" << endl;
+		return 1;
+	}
+
+	/* Load symbols */
+	if (elffile) {
+		ret = Symbols::Load(elffile);
+		if (!ret) {
+			cerr << "[ERROR]: Could not load the symbols!" << endl;
+			return 1;
+		}
+	}
+
+	/* Literals come from the recorded loads */
+	Disasm::Read = ReadLiteral;
+
+	/* Render records */
+	while (Reader.Next(Current)) {
+		const char *name;
+		u32 offset;
+
+		/* Function entry */
+		if (Symbols::Lookup(Current.pc, name, offset) && !offset)
+			printf("<%s>:\n", name);
+
+		if (Current.flags & REC_THUMB)
+			Disasm::Thumb(stdout, Current.pc, Current.opcode, Current.opcode >> 16);
+		else
+			Disasm::Arm(stdout, Current.pc, Current.opcode);
+	}
+
+	return 0;
+}
+
+static int Index(const char *filename)
+{
+	bool ret;
+
+	/* Build indexes */
+	ret = TraceIndex::Build(filename);
+	if (!ret) {
+		cerr << "[ERROR]: Could not index the trace file!" << endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int Execs(const char *filename, u32 pc)
+{
+	TraceIndex Index;
+	const IndexExec *first;
+
+	u64  count;
+	bool ret;
+
+	/* Open indexes */
+	ret = Index.Open(filename);
+	if (!ret) {
+		cerr << "[ERROR]: Could not open the trace index!" << endl;
+		return 1;
+	}
+
+	/* Find executions */
+	count = Index.Executions(pc, first);
+
+	for (u64 i = 0; i < count; i++)
+		printf("%llu\n", first[i].index);
+
+	return 0;
+}
+
+static int LastWrite(const char *filename, u32 address, u64 before)
+{
+	TraceIndex Index;
+	IndexWrite entry;
+
+	bool ret;
+
+	/* Open indexes */
+	ret = Index.Open(filename);
+	if (!ret) {
+		cerr << "[ERROR]: Could not open the trace index!" << endl;
+		return 1;
+	}
+
+	/* Find write */
+	ret = Index.LastWrite(address, before, entry);
+	if (!ret) {
+		printf("No write to 0x%08X before instruction %llu\n", address, before);
+		return 1;
+	}
+
+	printf("%llu: write%d 0x%08X = 0x%08X\n", entry.index, entry.size, entry.address, entry.value);
+	return 0;
+}
+
+static void Usage(const char *name)
+{
+	cerr << "[USAGE]: " << name << " <command> <trace file> [args]" << endl;
+	cerr << endl;
+	cerr << "Commands:" << endl;
+	cerr << "  dis       <trace> [elf]         Render the trace as disassembly (labelled with symbols)" << endl;
+	cerr << "  index     <trace>               Build the execution and write indexes" << endl;
+	cerr << "  execs     <trace> <pc>          List executions of an address" << endl;
+	cerr << "  lastwrite <trace> <addr> <n>    Find the last write to an address before instruction n" << endl;
+}
+
+int main(int argc, char **argv)
+{
+	/* Show usage */
+	if (argc < 3) {
+		Usage(argv[0]);
+		return 1;
+	}
+
+	/* Disassemble */
+	if (!strcmp(argv[1], "dis"))
+		return Dis(argv[2], (argc > 3) ? argv[3] : NULL);
+
+	/* Build indexes */
+	if (!strcmp(argv[1], "index"))
+		return Index(argv[2]);
+
+	/* Executions query */
+	if (!strcmp(argv[1], "execs") && argc > 3)
+		return Execs(argv[2], strtoul(argv[3], NULL, 16));
+
+	/* Last write query */
+	if (!strcmp(argv[1], "lastwrite") && argc > 4)
+		return LastWrite(argv[2], strtoul(argv[3], NULL, 16), strtoull(argv[4], NULL, 10));
+
+	cerr << "[ERROR]: Invalid command!" << endl;
+	return 1;
+}
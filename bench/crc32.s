@@ -0,0 +1,92 @@
+/*
+ * ARM9 emulator benchmark - CRC32 (Thumb)
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Bitwise CRC32 (reflected, polynomial 0xEDB88320) over a 1KB buffer
+ * filled from a linear congruential generator. Exits with the low byte
+ * of the last CRC.
+ */
+
+	.syntax unified
+	.arm
+	.text
+
+_start:
+	adr	r0, thumb + 1
+	bx	r0
+
+	.thumb
+thumb:
+	/* Fill buffer */
+	ldr	r0, =buffer
+	ldr	r1, =1024
+	ldr	r2, =12345
+	ldr	r3, =1103515245
+1:	muls	r2, r3, r2
+	adds	r2, #123
+	adds	r4, r2, #0
+	lsrs	r4, r4, #16
+	strb	r4, [r0]
+	adds	r0, #1
+	subs	r1, #1
+	bne	1b
+
+	ldr	r7, =120		@ Passes
+	ldr	r3, =0xEDB88320
+
+pass:
+	ldr	r0, =buffer
+	ldr	r1, =1024
+	movs	r5, #0
+	subs	r5, #1			@ CRC = ~0
+
+byte:
+	ldrb	r4, [r0]
+	eors	r5, r4
+	movs	r6, #8
+
+bit:
+	adds	r2, r5, #0
+	lsls	r2, r2, #31		@ Low bit
+	lsrs	r5, r5, #1
+	cmp	r2, #0
+	beq	2f
+	eors	r5, r3
+2:	subs	r6, #1
+	bne	bit
+
+	adds	r0, #1
+	subs	r1, #1
+	bne	byte
+
+	subs	r7, #1
+	bne	pass
+
+	/* Exit with checksum */
+	movs	r0, #0
+	subs	r0, #1
+	eors	r0, r5
+	lsls	r0, r0, #24
+	lsrs	r0, r0, #24
+	swi	0
+
+	.ltorg
+	.align	2
+buffer:
+	.space	1024
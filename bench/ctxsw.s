@@ -0,0 +1,82 @@
+/*
+ * ARM9 emulator benchmark - Context switcher (ARM)
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Round-robin switches between four tasks, saving and restoring ten
+ * registers per switch with STMDB/LDMIA, and runs a few instructions of
+ * task work in between. Exits with the low byte of the saved registers.
+ */
+
+	.syntax unified
+	.arm
+	.text
+
+	.equ	TCB_REGS, 40		@ r1-r8, sp, lr
+	.equ	TCB_SIZE, 48		@ Registers, next, pad
+
+_start:
+	ldr	r11, =500000		@ Switches
+	ldr	r0, =tcbs
+
+switch:
+	/* Task work */
+	add	r1, r1, #1
+	add	r2, r2, r1
+	eor	r3, r3, r2
+	add	r4, r4, r3
+
+	/* Save context (below the link word) */
+	add	r0, r0, #TCB_REGS
+	stmdb	r0, {r1-r8, sp, lr}
+
+	/* Next task, restore context */
+	ldr	r0, [r0]
+	ldmia	r0, {r1-r8, sp, lr}
+
+	subs	r11, r11, #1
+	bne	switch
+
+	/* Exit with checksum (r1-r4 of every task) */
+	ldr	r0, =tcbs
+	mov	r1, #0
+	mov	r2, #4
+1:	ldmia	r0, {r3-r6}
+	add	r1, r1, r3
+	add	r1, r1, r4
+	add	r1, r1, r5
+	add	r1, r1, r6
+	add	r0, r0, #TCB_SIZE
+	subs	r2, r2, #1
+	bne	1b
+
+	and	r0, r1, #0xFF
+	swi	0
+
+	.ltorg
+	.align	2
+
+tcbs:
+	.space	TCB_REGS
+	.word	tcbs + TCB_SIZE * 1, 0
+	.space	TCB_REGS
+	.word	tcbs + TCB_SIZE * 2, 0
+	.space	TCB_REGS
+	.word	tcbs + TCB_SIZE * 3, 0
+	.space	TCB_REGS
+	.word	tcbs, 0
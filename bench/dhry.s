@@ -0,0 +1,111 @@
+/*
+ * ARM9 emulator benchmark - Dhrystone-like integer mix (ARM)
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Record copies (LDM/STM), a string compare, procedure calls through
+ * the stack and a small enumeration switch, the shape of the Dhrystone
+ * main loop. Exits with a checksum of the final state.
+ */
+
+	.syntax unified
+	.arm
+	.text
+
+_start:
+	ldr	sp, =stack
+	ldr	r11, =100000		@ Iterations
+	mov	r10, #0			@ Checksum
+
+loop:
+	/* Record assignment */
+	ldr	r0, =rec_a
+	ldr	r1, =rec_b
+	ldmia	r0, {r2-r9}
+	add	r2, r2, r11
+	stmia	r1, {r2-r9}
+
+	/* String compare */
+	ldr	r0, =str_1
+	ldr	r1, =str_2
+	mov	lr, pc
+	b	strcmp
+	add	r10, r10, r0
+
+	/* Arithmetic procedure */
+	mov	r0, r11
+	mov	lr, pc
+	b	proc
+	eor	r10, r10, r0
+
+	/* Enumeration switch */
+	and	r0, r11, #3
+	cmp	r0, #0
+	addeq	r10, r10, #1
+	cmp	r0, #1
+	subeq	r10, r10, #2
+	cmp	r0, #2
+	eoreq	r10, r10, #3
+	cmp	r0, #3
+	addeq	r10, r10, r10, lsl #1
+
+	subs	r11, r11, #1
+	bne	loop
+
+	/* Exit with checksum (record sum, order independent) */
+	ldr	r1, =rec_b
+	ldmia	r1, {r2-r9}
+	add	r0, r10, r2
+	add	r0, r0, r3
+	add	r0, r0, r4
+	add	r0, r0, r5
+	add	r0, r0, r6
+	add	r0, r0, r7
+	add	r0, r0, r8
+	add	r0, r0, r9
+	and	r0, r0, #0xFF
+	swi	0
+
+strcmp:
+	ldrb	r2, [r0], #1
+	ldrb	r3, [r1], #1
+	cmp	r2, r3
+	bne	1f
+	cmp	r2, #0
+	bne	strcmp
+1:	sub	r0, r2, r3
+	mov	pc, lr
+
+proc:
+	stmdb	sp!, {r4, r5, lr}
+	mov	r4, #3
+	mul	r5, r0, r4
+	sub	r5, r5, #7
+	add	r0, r5, r0, lsr #2
+	ldmia	sp!, {r4, r5, pc}
+
+	.ltorg
+
+rec_a:	.word	1, 2, 3, 4, 5, 6, 7, 8
+rec_b:	.space	32
+str_1:	.asciz	"DHRYSTONE PROGRAM, 1'ST STRING"
+str_2:	.asciz	"DHRYSTONE PROGRAM, 2'ND STRING"
+
+	.align	2
+	.space	256
+stack:
@@ -0,0 +1,117 @@
+/*
+ * ARM9 emulator benchmark - Branchy state machine (Thumb)
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A tokenizer over 4KB of pseudo-random bytes: each byte is classified
+ * (digit, letter, punctuation or space) by compare chains and drives a
+ * four-state machine that counts numbers, words and symbols. Exits with
+ * the low byte of the token counts.
+ */
+
+	.syntax unified
+	.arm
+	.text
+
+_start:
+	adr	r0, thumb + 1
+	bx	r0
+
+	.thumb
+thumb:
+	/* Fill input */
+	ldr	r0, =input
+	ldr	r1, =4096
+	ldr	r2, =12345
+	ldr	r3, =1103515245
+1:	muls	r2, r3, r2
+	adds	r2, #123
+	adds	r4, r2, #0
+	lsrs	r4, r4, #24
+	strb	r4, [r0]
+	adds	r0, #1
+	subs	r1, #1
+	bne	1b
+
+	movs	r1, #0			@ Numbers
+	movs	r2, #0			@ Words
+	movs	r3, #0			@ Symbols
+	ldr	r5, =200		@ Passes
+
+pass:
+	ldr	r0, =input
+	ldr	r6, =4096
+	movs	r7, #0			@ State (0 idle, 1 number, 2 word, 3 symbol)
+
+next:
+	subs	r6, #1
+	ldrb	r4, [r0, r6]
+
+	/* Classify (0 digit, 1 letter, 2 punctuation, 3 space) */
+	cmp	r4, #64
+	blo	digit
+	cmp	r4, #160
+	blo	letter
+	cmp	r4, #224
+	blo	punct
+
+space:
+	movs	r7, #0
+	b	step
+
+digit:
+	cmp	r7, #1
+	beq	step			@ Still in a number
+	cmp	r7, #2
+	beq	step			@ Digits continue a word
+	adds	r1, #1
+	movs	r7, #1
+	b	step
+
+letter:
+	cmp	r7, #2
+	beq	step
+	cmp	r7, #1
+	bne	2f
+	subs	r1, #1			@ A number running into letters is a word
+2:	adds	r2, #1
+	movs	r7, #2
+	b	step
+
+punct:
+	adds	r3, #1
+	movs	r7, #3
+
+step:
+	cmp	r6, #0
+	bne	next
+
+	subs	r5, #1
+	bne	pass
+
+	/* Exit with checksum */
+	adds	r0, r1, r2
+	adds	r0, r0, r3
+	lsls	r0, r0, #24
+	lsrs	r0, r0, #24
+	swi	0
+
+	.ltorg
+	.align	2
+input:
+	.space	4096
@@ -0,0 +1,70 @@
+/*
+ * ARM9 emulator benchmark - Syscall-heavy logger (ARM)
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Formats a counter in decimal (by repeated subtraction of powers of
+ * ten) into a log line and writes it to stderr with a write syscall,
+ * once per iteration. Exits with the low byte of the bytes written.
+ */
+
+	.syntax unified
+	.arm
+	.text
+
+	.equ	MSG_LEN, 21		@ "log: iteration 00000\n"
+
+_start:
+	ldr	r11, =20000		@ Lines
+	mov	r10, #0			@ Bytes written
+
+line:
+	/* Format counter (5 digits) */
+	ldr	r1, =digits
+	ldr	r3, =powers
+	mov	r0, r11
+
+1:	ldr	r2, [r3], #4		@ Power of ten
+	mov	r4, #'0'
+2:	cmp	r0, r2
+	subhs	r0, r0, r2
+	addhs	r4, r4, #1
+	bhs	2b
+	strb	r4, [r1], #1
+	cmp	r2, #1
+	bne	1b
+
+	/* Write line */
+	mov	r0, #2
+	ldr	r1, =msg
+	mov	r2, #MSG_LEN
+	swi	4
+	add	r10, r10, r0
+
+	subs	r11, r11, #1
+	bne	line
+
+	/* Exit with checksum */
+	and	r0, r10, #0xFF
+	swi	0
+
+	.ltorg
+
+powers:	.word	10000, 1000, 100, 10, 1
+msg:	.ascii	"log: iteration "
+digits:	.ascii	"00000\n"
@@ -0,0 +1,99 @@
+/*
+ * ARM9 emulator benchmark - Block copies (Thumb)
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Copies a 4KB buffer with LDMIA/STMIA bursts, then copies it back a
+ * byte at a time, on every pass. Exits with a rotate-XOR checksum of the
+ * destination words folded to a byte, so misplaced data changes it.
+ */
+
+	.syntax unified
+	.arm
+	.text
+
+_start:
+	adr	r0, thumb + 1
+	bx	r0
+
+	.thumb
+thumb:
+	/* Fill source */
+	ldr	r0, =src
+	ldr	r1, =1024
+	ldr	r2, =12345
+	ldr	r3, =1103515245
+1:	muls	r2, r3, r2
+	adds	r2, #123
+	stmia	r0!, {r2}
+	subs	r1, #1
+	bne	1b
+
+	ldr	r7, =500		@ Passes
+
+pass:
+	/* Burst copy (16 bytes per step) */
+	ldr	r0, =src
+	ldr	r1, =dst
+	ldr	r6, =256
+2:	ldmia	r0!, {r2-r5}
+	stmia	r1!, {r2-r5}
+	subs	r6, #1
+	bne	2b
+
+	/* Byte copy back */
+	ldr	r0, =dst
+	ldr	r1, =src
+	ldr	r6, =4096
+3:	subs	r6, #1
+	ldrb	r2, [r0, r6]
+	strb	r2, [r1, r6]
+	bne	3b
+
+	subs	r7, #1
+	bne	pass
+
+	/* Exit with checksum */
+	ldr	r0, =dst
+	ldr	r1, =1024
+	movs	r2, #0
+	movs	r4, #5
+4:	ldmia	r0!, {r3}
+	rors	r2, r4
+	eors	r2, r3
+	subs	r1, #1
+	bne	4b
+
+	/* Fold to a byte */
+	adds	r3, r2, #0
+	lsrs	r3, r3, #16
+	eors	r2, r3
+	adds	r3, r2, #0
+	lsrs	r3, r3, #8
+	eors	r2, r3
+	lsls	r2, r2, #24
+	lsrs	r2, r2, #24
+	adds	r0, r2, #0
+	swi	0
+
+	.ltorg
+	.align	2
+src:
+	.space	4096
+dst:
+	.space	4096
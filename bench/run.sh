@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# ARM9 emulator - Benchmark runner
+#
+# Runs every benchmark image under every engine the emulator was built
+# with and prints one JSON record per run (guest MIPS and wall time from
+# --hostperf, and the guest's exit checksum).
+#
+# Usage: bench/run.sh <armemu> <image.bin>...
+#
+# The images are prebuilt big-endian ARMv5TE binaries loaded at 0. To
+# rebuild one after editing its source:
+#
+#   llvm-mc -triple=armebv5te -filetype=obj bench/crc32.s -o crc32.o
+#   llvm-objcopy -O binary crc32.o bench/crc32.bin
+#
+
+EMU=$1
+shift
+
+STEPS=2000000000
+
+if [ -z "$EMU" ] || [ $# -eq 0 ]; then
+	echo "[USAGE]: $0 <armemu> <image.bin>..." >&2
+	exit 1
+fi
+
+# Engines: name and extra options
+ENGINES="interpreter:"
+ENGINES="$ENGINES stats:-s/dev/null"
+ENGINES="$ENGINES calls:-k/dev/null"
+
+# Cache model (only in CACHE=1 builds)
+if $EMU -q -c b "$1" 1 ffffffff >/dev/null 2>&1; then
+	ENGINES="$ENGINES cache:-c"
+fi
+
+first=1
+
+echo "["
+
+for image in "$@"; do
+	name=$(basename "$image" .bin)
+
+	for engine in $ENGINES; do
+		label=${engine%%:*}
+		opts=${engine#*:}
+
+		# Run (guest output discarded)
+		out=$($EMU -q -H $opts b "$image" $STEPS ffffffff 2>/dev/null)
+
+		echo "$out" | awk -v bench="$name" -v engine="$label" -v first="$first" '
+			/^FINISHED!/  { gsub(/[()]/, ""); result = $3 }
+			/^wall time/  { wall = $3 }
+			/^guest/      { mips = $2; instr = $4; gsub(/\(/, "", instr) }
+			END {
+				if (!first)
+					printf(",\n")
+				printf("  { \"bench\": \"%s\", \"engine\": \"%s\", \"instructions\": %s, " \
+				       "\"mips\": %s, \"wall\": %s, \"result\": %s }",
+				       bench, engine, instr, mips, wall, (result == "") ? "null" : result)
+			}'
+
+		first=0
+	done
+done
+
+echo
+echo "]"
@@ -0,0 +1,82 @@
+/*
+ * ARM9 emulator benchmark - Insertion sort (ARM)
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Insertion sort of 256 pseudo-random words, refilled and sorted again
+ * on every pass. Exits with a checksum of the sorted array ends.
+ */
+
+	.syntax unified
+	.arm
+	.text
+
+_start:
+	ldr	r11, =60		@ Passes
+	ldr	r9, =12345		@ Generator state
+	ldr	r8, =1103515245
+
+pass:
+	/* Fill array */
+	ldr	r0, =array
+	mov	r1, #256
+1:	mla	r9, r8, r9, r11
+	add	r9, r9, #123
+	str	r9, [r0], #4
+	subs	r1, r1, #1
+	bne	1b
+
+	/* Sort (a[j] > key moves up) */
+	ldr	r0, =array
+	mov	r1, #1
+
+outer:
+	ldr	r2, [r0, r1, lsl #2]	@ Key
+	sub	r3, r1, #1
+
+inner:
+	ldr	r4, [r0, r3, lsl #2]
+	cmp	r4, r2
+	bls	2f
+	add	r5, r3, #1
+	str	r4, [r0, r5, lsl #2]
+	subs	r3, r3, #1
+	bpl	inner
+
+2:	add	r5, r3, #1
+	str	r2, [r0, r5, lsl #2]
+
+	add	r1, r1, #1
+	cmp	r1, #256
+	bne	outer
+
+	subs	r11, r11, #1
+	bne	pass
+
+	/* Exit with checksum */
+	ldr	r0, =array
+	ldr	r1, [r0]
+	ldr	r2, [r0, #1020]
+	eor	r0, r1, r2, lsr #24
+	and	r0, r0, #0xFF
+	swi	0
+
+	.ltorg
+	.align	2
+array:
+	.space	1024
@@ -0,0 +1,450 @@
+/*
+ * ARM9 emulator - Cache timing model
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+
+#include "arm.hpp"
+#include "cache.hpp"
+#include "cp15.hpp"
+#include "memory.hpp"
+
+/*
+ * Only built with -D__CACHE_MODEL__ (make CACHE=1). The model sees
+ * every fetch and every data access the CPU makes, classifies it with
+ * per-page attributes derived from the CP15 registers (cacheable,
+ * bufferable, TCM) and charges the resulting stall cycles to the CPU
+ * cycle counter. Caches allocate on read misses only, like the
+ * ARM946E-S; write-through and non-cacheable bufferable writes go
+ * through the write buffer, which drains before every bus read.
+ */
+
+/* Line tag bits */
+#define TAG_VALID	(1 << 0)
+#define TAG_DIRTY	(1 << 1)
+
+
+Cache::Cache(u32 size)
+{
+	/* Allocate sets */
+	sets   = size / (CACHE_WAYS * CACHE_LINE);
+	tags   = new u32[sets * CACHE_WAYS];
+	victim = new u8[sets];
+
+	/* Invalidate */
+	Invalidate();
+}
+
+Cache::~Cache(void)
+{
+	/* Free sets */
+	delete[] tags;
+	delete[] victim;
+}
+
+bool Cache::Probe(u32 address, bool dirty)
+{
+	u32  line = address & ~(CACHE_LINE - 1);
+	u32 *set  = tags + ((address / CACHE_LINE) % sets) * CACHE_WAYS;
+
+	/* Search ways */
+	for (u32 i = 0; i < CACHE_WAYS; i++) {
+		if ((set[i] & ~(CACHE_LINE - 1)) == line && (set[i] & TAG_VALID)) {
+			if (dirty)
+				set[i] |= TAG_DIRTY;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Cache::Access(u32 address, bool &evict)
+{
+	u32  idx = (address / CACHE_LINE) % sets;
+	u32 *set = tags + idx * CACHE_WAYS;
+	u8   way;
+
+	/* Hit */
+	evict = false;
+
+	if (Probe(address, false))
+		return true;
+
+	/* Replace the next way */
+	way   = victim[idx];
+	evict = (set[way] & (TAG_VALID | TAG_DIRTY)) == (TAG_VALID | TAG_DIRTY);
+
+	set[way]    = (address & ~(CACHE_LINE - 1)) | TAG_VALID;
+	victim[idx] = (way + 1) % CACHE_WAYS;
+
+	return false;
+}
+
+void Cache::Invalidate(void)
+{
+	/* Clear all lines */
+	memset(tags,   0, sets * CACHE_WAYS * sizeof(*tags));
+	memset(victim, 0, sets);
+}
+
+void Cache::Invalidate(u32 address)
+{
+	u32  line = address & ~(CACHE_LINE - 1);
+	u32 *set  = tags + ((address / CACHE_LINE) % sets) * CACHE_WAYS;
+
+	/* Clear matching line */
+	for (u32 i = 0; i < CACHE_WAYS; i++) {
+		if ((set[i] & ~(CACHE_LINE - 1)) == line)
+			set[i] = 0;
+	}
+}
+
+
+CacheModel::CacheModel(ARM *cpu)
+	: icache(ICACHE_SIZE), dcache(DCACHE_SIZE)
+{
+	/* Set parameters */
+	this->cpu = cpu;
+
+	/* Allocate page tables */
+	attr = new u8[PAGE_COUNT];
+	zone = new u8[PAGE_COUNT];
+
+	/* Uncached, unbuffered */
+	memset(attr, 0,               PAGE_COUNT);
+	memset(zone, ZONE_BACKGROUND, PAGE_COUNT);
+
+	/* Empty write buffer */
+	memset(wbuf, 0, sizeof(wbuf));
+	wpos = 0;
+
+	/* Clear counters */
+	memset(Zones, 0, sizeof(Zones));
+
+	func    = NULL;
+	pending = 0;
+}
+
+CacheModel::~CacheModel(void)
+{
+	/* Free page tables */
+	delete[] attr;
+	delete[] zone;
+}
+
+void CacheModel::Hook(void *priv, u32 address, u32 value, u8 flags)
+{
+	CacheModel *Model = (CacheModel *)priv;
+
+	/* Data access */
+	Model->Data(address, flags & ACCESS_WRITE);
+}
+
+u64 CacheModel::Now(void)
+{
+	/* CPU clock plus stalls not yet charged */
+	return cpu->Cycles() + pending;
+}
+
+void CacheModel::Stall(u8 zone, u64 cycles)
+{
+	/* Charge stall */
+	pending += cycles;
+
+	Zones[zone].stalls += cycles;
+	func->stalls       += cycles;
+}
+
+void CacheModel::Count(u8 zone, u64 CacheStats::*field)
+{
+	/* Count access */
+	Zones[zone].*field += 1;
+	func->*field       += 1;
+}
+
+void CacheModel::Buffer(u8 zone)
+{
+	u64 now    = Now();
+	u64 oldest = wbuf[wpos];
+	u64 newest = wbuf[(wpos + WBUF_DEPTH - 1) % WBUF_DEPTH];
+
+	/* Full: wait for the oldest entry */
+	if (oldest > now) {
+		Stall(zone, oldest - now);
+		now = oldest;
+	}
+
+	/* Queue write behind the others */
+	wbuf[wpos] = ((newest > now) ? newest : now) + BUS_FIRST;
+	wpos       = (wpos + 1) % WBUF_DEPTH;
+}
+
+void CacheModel::Drain(u8 zone)
+{
+	u64 now    = Now();
+	u64 newest = wbuf[(wpos + WBUF_DEPTH - 1) % WBUF_DEPTH];
+
+	/* Wait for pending writes */
+	if (newest > now)
+		Stall(zone, newest - now);
+}
+
+void CacheModel::Data(u32 address, bool write)
+{
+	u32  page = address >> PAGE_SHIFT;
+	u8   a    = attr[page];
+	u8   z    = zone[page];
+	bool evict;
+
+	/* Zero-wait memory */
+	if (a & ATTR_TCM) {
+		Count(z, &CacheStats::tcm);
+		return;
+	}
+
+	if (write) {
+		bool back = (a & ATTR_DCACHE) && (a & ATTR_BUFFER);
+
+		/* Write-back hits stay in the cache */
+		if ((a & ATTR_DCACHE) && dcache.Probe(address, back)) {
+			Count(z, &CacheStats::dhits);
+
+			if (back)
+				return;
+		} else
+			Count(z, (a & ATTR_DCACHE) ? &CacheStats::dmisses : &CacheStats::uncached);
+
+		/* Write-through and bufferable writes are queued */
+		if (a & (ATTR_DCACHE | ATTR_BUFFER))
+			Buffer(z);
+		else {
+			Drain(z);
+			Stall(z, BUS_FIRST);
+		}
+
+		return;
+	}
+
+	/* Cached read */
+	if (a & ATTR_DCACHE) {
+		if (dcache.Access(address, evict)) {
+			Count(z, &CacheStats::dhits);
+			return;
+		}
+
+		Count(z, &CacheStats::dmisses);
+
+		/* Write back the victim, then fill */
+		if (evict)
+			Buffer(z);
+
+		Drain(z);
+		Stall(z, BUS_FILL);
+
+		return;
+	}
+
+	/* Bus read */
+	Count(z, &CacheStats::uncached);
+
+	Drain(z);
+	Stall(z, BUS_FIRST);
+}
+
+void CacheModel::Attach(void)
+{
+	/* Hook data accesses */
+	Memory::SetModelHook(Hook, this);
+
+	/* Hook fetches and CP15 */
+	cpu->SetModel(this);
+
+	/* Code before the first call */
+	func = &Funcs[cpu->PeekReg(15)];
+}
+
+void CacheModel::Configure(CP15 *cp15)
+{
+	u32 control = cp15->control;
+	u32 first, count;
+
+	/* Defaults */
+	memset(attr, 0,               PAGE_COUNT);
+	memset(zone, ZONE_BACKGROUND, PAGE_COUNT);
+
+	/* Caches and write buffer only work with the MPU on */
+	if (control & CP15_MPU) {
+		for (u32 i = 0; i < CP15_REGIONS; i++) {
+			u8 value = 0;
+
+			if (!cp15->Pages(i, first, count))
+				continue;
+
+			/* Region attributes */
+			if ((control & CP15_ICACHE) && ((cp15->cacheable[1] >> i) & 1))
+				value |= ATTR_ICACHE;
+			if ((control & CP15_DCACHE) && ((cp15->cacheable[0] >> i) & 1))
+				value |= ATTR_DCACHE;
+			if ((cp15->bufferable >> i) & 1)
+				value |= ATTR_BUFFER;
+
+			memset(attr + first, value,            count);
+			memset(zone + first, ZONE_REGION + i,  count);
+		}
+	}
+
+	/* TCMs (the DTCM shadows the ITCM) */
+	for (s32 i = TCM_INSTR; i >= TCM_DATA; i--) {
+		VSpace *space = cp15->space[i];
+
+		if (!space)
+			continue;
+
+		first = space->vaddr >> PAGE_SHIFT;
+		count = space->pages;
+
+		memset(attr + first, ATTR_TCM, count);
+		memset(zone + first, (i == TCM_INSTR) ? ZONE_ITCM : ZONE_DTCM, count);
+	}
+}
+
+void CacheModel::Invalidate(bool instr, bool all, u32 address)
+{
+	Cache *cache = (instr) ? &icache : &dcache;
+
+	/* Drop lines */
+	if (all)
+		cache->Invalidate();
+	else
+		cache->Invalidate(address);
+}
+
+void CacheModel::Fetch(u32 address)
+{
+	u32  page = address >> PAGE_SHIFT;
+	u8   a    = attr[page];
+	u8   z    = zone[page];
+	bool evict;
+
+	/* Zero-wait memory */
+	if (a & ATTR_TCM) {
+		Count(z, &CacheStats::tcm);
+		return;
+	}
+
+	/* Cached fetch */
+	if (a & ATTR_ICACHE) {
+		if (icache.Access(address, evict)) {
+			Count(z, &CacheStats::ihits);
+			return;
+		}
+
+		Count(z, &CacheStats::imisses);
+		Stall(z, BUS_FILL);
+
+		return;
+	}
+
+	/* Bus fetch */
+	Count(z, &CacheStats::uncached);
+	Stall(z, BUS_FIRST);
+}
+
+void CacheModel::Flow(u32 address, u32 target, u32 link, bool thumb, bool taken)
+{
+	u32 next = address + ((thumb) ? 2 : 4);
+
+	/* Sequential */
+	if (!taken)
+		return;
+
+	/* Call (link points past the branch, or past a Thumb BL pair) */
+	if ((link & ~1) == next || (thumb && (link & ~1) == next + 2)) {
+		CacheFrame frame;
+
+		if (Frames.size() < CACHE_FRAMES) {
+			frame.ret   = link & ~1;
+			frame.stats = func;
+
+			Frames.push_back(frame);
+		}
+
+		func = &Funcs[target & ~1];
+		return;
+	}
+
+	/* Return to a caller */
+	for (u32 i = Frames.size(); i--; ) {
+		if (Frames[i].ret == (target & ~1)) {
+			func = Frames[i].stats;
+			Frames.resize(i);
+
+			break;
+		}
+	}
+}
+
+static bool StallsMore(const pair<u32, CacheStats> &a, const pair<u32, CacheStats> &b)
+{
+	return a.second.stalls > b.second.stalls;
+}
+
+void CacheModel::Report(void)
+{
+	static const char *Names[ZONE_COUNT] = {
+		"region 0", "region 1", "region 2", "region 3",
+		"region 4", "region 5", "region 6", "region 7",
+		"background", "itcm", "dtcm",
+	};
+
+	vector< pair<u32, CacheStats> > Sorted(Funcs.begin(), Funcs.end());
+
+	cout << "CACHE MODEL:" << endl;
+	cout << "============" << endl;
+
+	printf("%-12s %10s %10s %10s %10s %10s %10s %12s\n",
+	       "", "ihits", "imisses", "dhits", "dmisses", "uncached", "tcm", "stalls");
+
+	/* Print zones */
+	for (u32 i = 0; i < ZONE_COUNT; i++) {
+		CacheStats *s = &Zones[i];
+
+		if (!(s->ihits | s->imisses | s->dhits | s->dmisses | s->uncached | s->tcm))
+			continue;
+
+		printf("%-12s %10llu %10llu %10llu %10llu %10llu %10llu %12llu\n", Names[i],
+		       s->ihits, s->imisses, s->dhits, s->dmisses, s->uncached, s->tcm, s->stalls);
+	}
+
+	cout << endl;
+
+	/* Print functions (most stalled first) */
+	sort(Sorted.begin(), Sorted.end(), StallsMore);
+
+	for (u32 i = 0; i < Sorted.size() && i < 16; i++) {
+		CacheStats *s = &Sorted[i].second;
+
+		printf("0x%08X   %10llu %10llu %10llu %10llu %10llu %10llu %12llu\n", Sorted[i].first,
+		       s->ihits, s->imisses, s->dhits, s->dmisses, s->uncached, s->tcm, s->stalls);
+	}
+}
@@ -0,0 +1,168 @@
+/*
+ * ARM9 emulator - Cache timing model
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CACHE_HPP__
+#define __CACHE_HPP__
+
+#include <map>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+/* Cache geometry (ARM946E-S) */
+#define CACHE_WAYS	4
+#define CACHE_LINE	32
+#define ICACHE_SIZE	(8 * 1024)
+#define DCACHE_SIZE	(4 * 1024)
+
+/* Write buffer entries */
+#define WBUF_DEPTH	8
+
+/* Bus latencies (CPU cycles) */
+#define BUS_FIRST	8		// Nonsequential word
+#define BUS_NEXT	2		// Sequential word
+#define BUS_FILL	(BUS_FIRST + (CACHE_LINE / 4 - 1) * BUS_NEXT)
+
+/* Call depth tracked for per-function counters */
+#define CACHE_FRAMES	1024
+
+/* Page attributes */
+enum {
+	ATTR_ICACHE = 1 << 0,
+	ATTR_DCACHE = 1 << 1,
+	ATTR_BUFFER = 1 << 2,
+	ATTR_TCM    = 1 << 3,
+};
+
+/* Statistics zones */
+enum {
+	ZONE_REGION = 0,		// MPU regions 0-7
+	ZONE_BACKGROUND = 8,
+	ZONE_ITCM  = 9,
+	ZONE_DTCM  = 10,
+	ZONE_COUNT = 11,
+};
+
+/* Forward declarations */
+class ARM;
+class CP15;
+
+/* Access counters */
+struct CacheStats {
+	u64 ihits, imisses;
+	u64 dhits, dmisses;
+	u64 uncached;			// Bus accesses (not cacheable)
+	u64 tcm;			// Zero-wait accesses
+	u64 stalls;			// Cycles lost
+};
+
+/* Call frame */
+struct CacheFrame {
+	u32         ret;
+	CacheStats *stats;
+};
+
+
+/* Set-associative cache class */
+class Cache {
+	u32  sets;
+	u32 *tags;			// Line address | valid | dirty
+	u8  *victim;			// Round-robin way per set
+
+public:
+	 Cache(u32 size);
+	~Cache(void);
+
+	/* Lookup (no allocation) */
+	bool Probe(u32 address, bool dirty);
+
+	/* Lookup, fill on miss (returns false on miss) */
+	bool Access(u32 address, bool &evict);
+
+	/* Invalidate functions */
+	void Invalidate(void);
+	void Invalidate(u32 address);
+};
+
+/* Timing model class */
+class CacheModel {
+	ARM *cpu;
+
+	/* Caches */
+	Cache icache;
+	Cache dcache;
+
+	/* Write buffer (drain cycle of each entry) */
+	u64 wbuf[WBUF_DEPTH];
+	u32 wpos;
+
+	/* Page attributes and zones */
+	u8 *attr;
+	u8 *zone;
+
+	/* Counters */
+	CacheStats Zones[ZONE_COUNT];
+	map<u32, CacheStats> Funcs;
+
+	/* Current function */
+	vector<CacheFrame> Frames;
+	CacheStats        *func;
+
+	/* Cycles not yet charged to the CPU */
+	u64 pending;
+
+private:
+	static void Hook(void *priv, u32 address, u32 value, u8 flags);
+
+	u64  Now   (void);
+	void Stall (u8 zone, u64 cycles);
+	void Count (u8 zone, u64 CacheStats::*field);
+	void Buffer(u8 zone);
+	void Drain (u8 zone);
+	void Data  (u32 address, bool write);
+
+public:
+	 CacheModel(ARM *cpu);
+	~CacheModel(void);
+
+	/* Attach function */
+	void Attach(void);
+
+	/* Configuration (from CP15) */
+	void Configure (CP15 *cp15);
+	void Invalidate(bool instr, bool all, u32 address);
+
+	/* Instruction functions */
+	void Fetch(u32 address);
+	void Flow (u32 address, u32 target, u32 link, bool thumb, bool taken);
+
+	/* Stall cycles since the last call */
+	inline u64 Stalls(void) {
+		u64 ret = pending;
+
+		pending = 0;
+		return ret;
+	}
+
+	/* Report function */
+	void Report(void);
+};
+
+#endif /* __CACHE_HPP__ */
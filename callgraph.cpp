@@ -0,0 +1,184 @@
+/*
+ * ARM9 emulator - Call graph profiler
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+
+#include "arm.hpp"
+#include "callgraph.hpp"
+#include "symbols.hpp"
+
+/*
+ * A branch that leaves the link register pointing past itself (BL, BLX
+ * or the second half of a Thumb BL pair) is a call; a branch to the
+ * return address of a frame on the shadow stack (BX LR, POP {pc}, LDM
+ * with pc) is a return, unwinding any frames above it. Self cost is
+ * charged lazily at each switch, so straight-line code costs nothing
+ * beyond the sequential check, and inclusive cost is the distance of
+ * the counters from the call when its frame is popped.
+ */
+
+
+CallGraph::CallGraph(ARM *cpu)
+{
+	/* Set parameters */
+	this->cpu = cpu;
+
+	/* Clear state */
+	func        = 0;
+	mark.instr  = 0;
+	mark.cycles = 0;
+}
+
+void CallGraph::Start(void)
+{
+	/* Clear profile */
+	Funcs.clear();
+	Frames.clear();
+
+	/* Root function */
+	func        = cpu->PeekReg(15);
+	mark.instr  = cpu->Count();
+	mark.cycles = cpu->Cycles();
+}
+
+void CallGraph::Charge(void)
+{
+	CallFunc *f = &Funcs[func];
+
+	u64 instr  = cpu->Count();
+	u64 cycles = cpu->Cycles();
+
+	/* Self cost since the last switch */
+	f->self.instr  += instr  - mark.instr;
+	f->self.cycles += cycles - mark.cycles;
+
+	mark.instr  = instr;
+	mark.cycles = cycles;
+}
+
+void CallGraph::Pop(u32 depth)
+{
+	/* Unwind frames (inclusive cost to the caller's edge) */
+	while (Frames.size() > depth) {
+		CallFrame *frame = &Frames.back();
+		CallEdge  *edge  = &Funcs[frame->func].Callees[func];
+
+		edge->cost.instr  += mark.instr  - frame->entry.instr;
+		edge->cost.cycles += mark.cycles - frame->entry.cycles;
+
+		func = frame->func;
+		Frames.pop_back();
+	}
+}
+
+void CallGraph::Branch(u32 address, u32 next, u32 target, u32 link, bool thumb)
+{
+	u32 ret = link & ~1;
+
+	/* Call (link points past the branch, or past a Thumb BL pair) */
+	if (ret == next || (thumb && ret == next + 2)) {
+		CallFrame frame;
+		CallEdge *edge;
+
+		/* Too deep, keep it in the caller */
+		if (Frames.size() >= CALL_FRAMES)
+			return;
+
+		Charge();
+
+		frame.func  = func;
+		frame.site  = address;
+		frame.ret   = ret;
+		frame.entry = mark;
+
+		Frames.push_back(frame);
+
+		/* Count call */
+		edge = &Funcs[func].Callees[target & ~1];
+		edge->calls++;
+		edge->site = address;
+
+		func = target & ~1;
+		return;
+	}
+
+	/* Return to a caller */
+	for (u32 i = Frames.size(); i--; ) {
+		if (Frames[i].ret == (target & ~1)) {
+			Charge();
+			Pop(i);
+
+			break;
+		}
+	}
+}
+
+bool CallGraph::Save(const char *filename)
+{
+	map<u32, CallFunc>::iterator it;
+	map<u32, CallEdge>::iterator ce;
+
+	CallCost total = { 0, 0 };
+	FILE    *fp;
+
+	/* Close open frames */
+	Charge();
+	Pop(0);
+
+	/* Open file */
+	fp = fopen(filename, "w");
+	if (!fp)
+		return false;
+
+	/* Header */
+	fprintf(fp, "version: 1\n");
+	fprintf(fp, "creator: armemu\n");
+	fprintf(fp, "positions: instr\n");
+	fprintf(fp, "events: Instructions Cycles\n\n");
+
+	for (it = Funcs.begin(); it != Funcs.end(); it++) {
+		CallFunc *f = &it->second;
+
+		/* Self cost (at the entry) */
+		fprintf(fp, "fn=%s\n", Symbols::Format(it->first, false).c_str());
+		fprintf(fp, "0x%08X %llu %llu\n", it->first, f->self.instr, f->self.cycles);
+
+		total.instr  += f->self.instr;
+		total.cycles += f->self.cycles;
+
+		/* Calls (inclusive cost at the call site) */
+		for (ce = f->Callees.begin(); ce != f->Callees.end(); ce++) {
+			CallEdge *e = &ce->second;
+
+			fprintf(fp, "cfn=%s\n", Symbols::Format(ce->first, false).c_str());
+			fprintf(fp, "calls=%llu 0x%08X\n", e->calls, ce->first);
+			fprintf(fp, "0x%08X %llu %llu\n", e->site, e->cost.instr, e->cost.cycles);
+		}
+
+		fprintf(fp, "\n");
+	}
+
+	/* Totals */
+	fprintf(fp, "totals: %llu %llu\n", total.instr, total.cycles);
+
+	/* Close file */
+	fclose(fp);
+
+	return true;
+}
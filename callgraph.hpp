@@ -0,0 +1,99 @@
+/*
+ * ARM9 emulator - Call graph profiler
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CALLGRAPH_HPP__
+#define __CALLGRAPH_HPP__
+
+#include <map>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+/* Constants */
+#define CALL_FRAMES	1024		// Shadow stack depth
+
+/* Cost (instructions, cycles) */
+struct CallCost {
+	u64 instr;
+	u64 cycles;
+};
+
+/* Call edge (inclusive cost of the callee) */
+struct CallEdge {
+	u64      calls;
+	u32      site;			// Last call site
+	CallCost cost;
+};
+
+/* Function */
+struct CallFunc {
+	CallCost           self;
+	map<u32, CallEdge> Callees;
+};
+
+/* Shadow stack frame */
+struct CallFrame {
+	u32      func;			// Caller
+	u32      site;			// Call instruction
+	u32      ret;			// Return address
+	CallCost entry;			// Counters at the call
+};
+
+/* Forward declarations */
+class ARM;
+
+
+/* Call graph profiler class */
+class CallGraph {
+	ARM *cpu;
+
+	/* Functions (by entry address) */
+	map<u32, CallFunc> Funcs;
+
+	/* Shadow stack */
+	vector<CallFrame> Frames;
+	u32               func;		// Current function
+
+	/* Counters at the last switch */
+	CallCost mark;
+
+private:
+	void Charge(void);
+	void Pop   (u32 depth);
+
+public:
+	CallGraph(ARM *cpu);
+
+	/* Start function */
+	void Start(void);
+
+	/* Flow function (after each instruction) */
+	inline void Flow(u32 address, u32 target, u32 link, bool thumb, bool taken) {
+		if (taken)
+			Branch(address, address + ((thumb) ? 2 : 4), target, link, thumb);
+	}
+
+	void Branch(u32 address, u32 next, u32 target, u32 link, bool thumb);
+
+	/* Save function (callgrind format) */
+	bool Save(const char *filename);
+};
+
+#endif /* __CALLGRAPH_HPP__ */
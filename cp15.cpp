@@ -0,0 +1,435 @@
+/*
+ * ARM9 emulator - System control coprocessor
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "arm.hpp"
+#include "cache.hpp"
+#include "cp15.hpp"
+#include "memory.hpp"
+#include "perf.hpp"
+
+/*
+ * TCMs are host buffers owned by the coprocessor and laid over the
+ * memory map as shadow spaces, so moving or enabling them only rebuilds
+ * the affected page table entries. Protection unit regions are flattened
+ * into one permission byte per page whenever a region, permission or
+ * the enable bit changes; accesses then test that byte instead of
+ * walking the regions.
+ *
+ * The ARM946E-S has no performance monitor; c15 c12 borrows the ARM11
+ * layout as a view of the emulator's cycle and instruction counters.
+ */
+
+
+CP15::CP15(ARM *cpu)
+{
+	/* Set parameters */
+	this->cpu = cpu;
+
+	/* Allocate TCM memory */
+	buffer[TCM_DATA]  = new u8[DTCM_SIZE];
+	buffer[TCM_INSTR] = new u8[ITCM_SIZE];
+
+	memset(buffer[TCM_DATA],  0, DTCM_SIZE);
+	memset(buffer[TCM_INSTR], 0, ITCM_SIZE);
+
+	space[TCM_DATA]  = NULL;
+	space[TCM_INSTR] = NULL;
+
+	/* No permissions yet */
+	perm = NULL;
+
+	/* Reset registers */
+	Reset();
+}
+
+CP15::~CP15(void)
+{
+	/* Drop permissions */
+	if (perm)
+		Memory::SetPermissions(NULL);
+
+	/* Free memory (spaces go with Memory::Destroy) */
+	delete[] buffer[TCM_DATA];
+	delete[] buffer[TCM_INSTR];
+	delete[] perm;
+}
+
+u32 CP15::Standard(u32 ext)
+{
+	u32 std = 0;
+
+	/* 4-bit fields to 2-bit fields */
+	for (u32 i = 0; i < CP15_REGIONS; i++)
+		std |= ((ext >> (i * 4)) & 3) << (i * 2);
+
+	return std;
+}
+
+u32 CP15::Extended(u32 std)
+{
+	u32 ext = 0;
+
+	/* 2-bit fields to 4-bit fields */
+	for (u32 i = 0; i < CP15_REGIONS; i++)
+		ext |= ((std >> (i * 2)) & 3) << (i * 4);
+
+	return ext;
+}
+
+u8 CP15::Decode(u32 ap)
+{
+	const u8 rw = PERM_READ | PERM_WRITE;
+
+	/* Privileged and user permissions */
+	switch (ap) {
+	case 1:
+		return rw;
+	case 2:
+		return rw | (PERM_READ << PERM_USER);
+	case 3:
+		return rw | (rw << PERM_USER);
+	case 5:
+		return PERM_READ;
+	case 6:
+		return PERM_READ | (PERM_READ << PERM_USER);
+	default:
+		return 0;
+	}
+}
+
+bool CP15::Pages(u32 idx, u32 &first, u32 &count)
+{
+	u64 size, base;
+
+	/* Disabled */
+	if (!(region[idx] & 1))
+		return false;
+
+	/* Region range (4KB minimum) */
+	size = 2ULL << ((region[idx] >> 1) & 0x1F);
+	if (size < PAGE_SIZE)
+		size = PAGE_SIZE;
+
+	base = region[idx] & ~(size - 1) & 0xFFFFF000;
+
+	first = base >> PAGE_SHIFT;
+	count = size >> PAGE_SHIFT;
+
+	return true;
+}
+
+void CP15::Remap(void)
+{
+	static const u32 Enable[TCM_COUNT] = { CP15_DTCM, CP15_ITCM };
+	static const u32 Size  [TCM_COUNT] = { DTCM_SIZE, ITCM_SIZE };
+
+	/* ITCM first, DTCM shadows it */
+	for (s32 i = TCM_INSTR; i >= TCM_DATA; i--) {
+		u32 base, size;
+
+		/* Unmap TCM */
+		if (space[i])
+			Memory::Remove(space[i]);
+
+		space[i] = NULL;
+
+		/* Disabled */
+		if (!(control & Enable[i]))
+			continue;
+
+		/* Region (the ITCM sits at zero) */
+		base = (i == TCM_INSTR) ? 0 : (tcm[i] & ~(PAGE_SIZE - 1));
+		size = 512U << ((tcm[i] >> 1) & 0x1F);
+
+		/* Not mirrored past its physical size */
+		if (size > Size[i] || !size)
+			size = Size[i];
+
+		/* Map TCM */
+		space[i] = Memory::Overlay(base, size, buffer[i]);
+	}
+}
+
+void CP15::Protect(void)
+{
+	/* Unprotected */
+	if (!(control & CP15_MPU)) {
+		Memory::SetPermissions(NULL);
+		return;
+	}
+
+	/* Allocate permissions */
+	if (!perm)
+		perm = new u8[PAGE_COUNT];
+
+	/* Background: no access */
+	memset(perm, 0, PAGE_COUNT);
+
+	/* Higher regions take priority */
+	for (u32 i = 0; i < CP15_REGIONS; i++) {
+		u32 first, count;
+		u8  data, instr, value;
+
+		if (!Pages(i, first, count))
+			continue;
+
+		/* Region permissions */
+		data  = Decode((access[0] >> (i * 4)) & 0xF);
+		instr = Decode((access[1] >> (i * 4)) & 0xF);
+
+		value  = data;
+		value |= (instr & PERM_READ) ? PERM_EXEC : 0;
+		value |= (instr & (PERM_READ << PERM_USER)) ? (PERM_EXEC << PERM_USER) : 0;
+
+		memset(perm + first, value, count);
+	}
+
+	/* Install permissions */
+	Memory::SetPermissions(perm);
+}
+
+void CP15::Notify(void)
+{
+#ifdef __CACHE_MODEL__
+	/* Rebuild timing attributes */
+	if (cpu->model)
+		cpu->model->Configure(this);
+#endif
+}
+
+u32 CP15::Monitor(u32 op2)
+{
+	PerfCounters *perf = cpu->perf;
+	u32 event;
+
+	switch (op2) {
+	case 0:			// Control
+		return monitor | (perf->Enabled() ? PMNC_ENABLE : 0);
+
+	case 1:			// Cycle counter
+		if (monitor & PMNC_DIVIDER)
+			return perf->Get(PERF_CYCLES) >> 6;
+
+		return perf->Get(PERF_CYCLES);
+
+	case 2:			// Event counters
+	case 3:
+		event = monitor >> ((op2 == 2) ? 20 : 12);
+
+		if ((event & 0xFF) == PMN_INSTR)
+			return perf->Get(PERF_INSTR);
+		if ((event & 0xFF) == PMN_CYCLES)
+			return perf->Get(PERF_CYCLES);
+
+		return 0;
+
+	default:
+		return 0;
+	}
+}
+
+void CP15::Monitor(u32 op2, u32 value)
+{
+	PerfCounters *perf = cpu->perf;
+	u32 event;
+
+	switch (op2) {
+	case 0:			// Control
+		monitor = value & PMNC_WRITABLE;
+
+		/* Zero counters */
+		if (value & PMNC_RESETEVT)
+			perf->Set(PERF_INSTR, 0);
+		if (value & PMNC_RESETCYC)
+			perf->Set(PERF_CYCLES, 0);
+
+		perf->Enable(value & PMNC_ENABLE);
+		break;
+
+	case 1:			// Cycle counter
+		if (monitor & PMNC_DIVIDER)
+			perf->Set(PERF_CYCLES, (u64)value << 6);
+		else
+			perf->Set(PERF_CYCLES, value);
+		break;
+
+	case 2:			// Event counters
+	case 3:
+		event = monitor >> ((op2 == 2) ? 20 : 12);
+
+		if ((event & 0xFF) == PMN_INSTR)
+			perf->Set(PERF_INSTR, value);
+		if ((event & 0xFF) == PMN_CYCLES)
+			perf->Set(PERF_CYCLES, value);
+		break;
+
+	default:
+		break;
+	}
+}
+
+void CP15::Reset(void)
+{
+	/* Reset registers */
+	control    = CP15_RESET;
+	bufferable = 0;
+	process    = 0;
+	monitor    = 0;
+
+	memset(cacheable, 0, sizeof(cacheable));
+	memset(access,    0, sizeof(access));
+	memset(region,    0, sizeof(region));
+	memset(tcm,       0, sizeof(tcm));
+
+	/* Low vectors, no TCMs, no protection */
+	cpu->vectors = 0;
+
+	Remap();
+	Protect();
+	Notify();
+}
+
+u32 CP15::Read(u32 crn, u32 crm, u32 op2)
+{
+	switch (crn) {
+	case 0:			// ID codes
+		if (op2 == 1)
+			return CP15_CACHETYPE;
+		if (op2 == 2)
+			return CP15_TCMSIZE;
+
+		return CP15_ID;
+
+	case 1:			// Control
+		return control;
+
+	case 2:			// Cacheable bits
+		return cacheable[op2 & 1];
+
+	case 3:			// Write buffer control
+		return bufferable;
+
+	case 5:			// Access permissions
+		if (op2 & 2)
+			return access[op2 & 1];
+
+		return Standard(access[op2 & 1]);
+
+	case 6:			// Protection regions
+		return region[crm & 7];
+
+	case 9:			// TCM regions
+		if (crm == 1)
+			return tcm[op2 & 1];
+
+		return 0;
+
+	case 13:		// Process ID
+		return process;
+
+	case 15:		// Performance monitor
+		if (crm == 12)
+			return Monitor(op2);
+
+		return 0;
+
+	default:
+		return 0;
+	}
+}
+
+void CP15::Write(u32 crn, u32 crm, u32 op2, u32 value)
+{
+	u32 old;
+
+	switch (crn) {
+	case 1:			// Control
+		old     = control;
+		control = CP15_RESET | (value & CP15_WRITABLE);
+
+		/* Exception vector base */
+		cpu->vectors = (control & CP15_HIVECTORS) ? 0xFFFF0000 : 0;
+
+		/* Reconfigure memory */
+		if ((old ^ control) & (CP15_DTCM | CP15_ITCM))
+			Remap();
+		if ((old ^ control) & CP15_MPU)
+			Protect();
+
+		Notify();
+		break;
+
+	case 2:			// Cacheable bits
+		cacheable[op2 & 1] = value & 0xFF;
+
+		Notify();
+		break;
+
+	case 3:			// Write buffer control
+		bufferable = value & 0xFF;
+
+		Notify();
+		break;
+
+	case 5:			// Access permissions
+		access[op2 & 1] = (op2 & 2) ? value : Extended(value);
+
+		Protect();
+		break;
+
+	case 6:			// Protection regions
+		region[crm & 7] = value;
+
+		Protect();
+		Notify();
+		break;
+
+	case 7:			// Cache maintenance
+#ifdef __CACHE_MODEL__
+		/* Invalidate (c5 instruction, c6 data) */
+		if (cpu->model && (crm == 5 || crm == 6) && op2 < 2)
+			cpu->model->Invalidate(crm == 5, op2 == 0, value);
+#endif
+		break;
+
+	case 9:			// TCM regions
+		if (crm != 1)
+			break;
+
+		tcm[op2 & 1] = value & 0xFFFFF03E;
+
+		Remap();
+		Notify();
+		break;
+
+	case 13:		// Process ID
+		process = value;
+		break;
+
+	case 15:		// Performance monitor
+		if (crm == 12)
+			Monitor(op2, value);
+		break;
+
+	default:		// Lockdown, test
+		break;
+	}
+}
@@ -0,0 +1,127 @@
+/*
+ * ARM9 emulator - System control coprocessor
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CP15_HPP__
+#define __CP15_HPP__
+
+#include "types.h"
+
+/* Constants (ARM946E-S) */
+#define CP15_ID		0x41059461
+#define CP15_CACHETYPE	0x0F0D2112	// 8KB I-cache, 4KB D-cache
+#define CP15_TCMSIZE	0x00140180	// 16KB DTCM, 32KB ITCM
+#define CP15_REGIONS	8
+
+/* TCM sizes */
+#define DTCM_SIZE	(16 * 1024)
+#define ITCM_SIZE	(32 * 1024)
+
+/* Control register bits */
+enum {
+	CP15_MPU       = 1 << 0,
+	CP15_DCACHE    = 1 << 2,
+	CP15_BIGEND    = 1 << 7,
+	CP15_ICACHE    = 1 << 12,
+	CP15_HIVECTORS = 1 << 13,
+	CP15_DTCM      = 1 << 16,
+	CP15_DTCMLOAD  = 1 << 17,
+	CP15_ITCM      = 1 << 18,
+	CP15_ITCMLOAD  = 1 << 19,
+
+	CP15_RESET     = 0x00000078,	// Should-be-one bits
+	CP15_WRITABLE  = 0x000FF085,
+};
+
+/* Performance monitor control bits (c15 c12, ARM11 layout) */
+enum {
+	PMNC_ENABLE   = 1 << 0,
+	PMNC_RESETEVT = 1 << 1,		// Write only
+	PMNC_RESETCYC = 1 << 2,		// Write only
+	PMNC_DIVIDER  = 1 << 3,		// Cycle counter every 64 cycles
+
+	PMNC_WRITABLE = 0x0FFFF008,	// Divider, event selection
+};
+
+/* Performance monitor events */
+enum {
+	PMN_INSTR  = 0x07,
+	PMN_CYCLES = 0xFF,
+};
+
+/* TCMs */
+enum {
+	TCM_DATA  = 0,
+	TCM_INSTR = 1,
+	TCM_COUNT = 2,
+};
+
+/* Forward declarations */
+class ARM;
+class VSpace;
+
+
+/* System control coprocessor class */
+class CP15 {
+	friend class CacheModel;
+
+	ARM *cpu;
+
+	/* Registers */
+	u32 control;
+	u32 cacheable[2];		// c2 (data, instruction)
+	u32 bufferable;			// c3
+	u32 access[2];			// c5 extended (data, instruction)
+	u32 region[CP15_REGIONS];	// c6
+	u32 tcm[TCM_COUNT];		// c9 region registers
+	u32 process;			// c13
+	u32 monitor;			// c15 c12 performance monitor control
+
+	/* TCM memory */
+	u8     *buffer[TCM_COUNT];
+	VSpace *space [TCM_COUNT];
+
+	/* Page permissions */
+	u8 *perm;
+
+private:
+	static u32 Standard(u32 ext);
+	static u32 Extended(u32 std);
+	static u8  Decode  (u32 ap);
+
+	bool Pages  (u32 idx, u32 &first, u32 &count);
+	void Remap  (void);
+	void Protect(void);
+	void Notify (void);
+
+	u32  Monitor(u32 op2);
+	void Monitor(u32 op2, u32 value);
+
+public:
+	 CP15(ARM *cpu);
+	~CP15(void);
+
+	/* Reset function */
+	void Reset(void);
+
+	/* Register access (MRC/MCR) */
+	u32  Read (u32 crn, u32 crm, u32 op2);
+	void Write(u32 crn, u32 crm, u32 op2, u32 value);
+};
+
+#endif /* __CP15_HPP__ */
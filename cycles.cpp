@@ -0,0 +1,167 @@
+/*
+ * ARM9 emulator - Instruction cycle table
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cycles.hpp"
+
+/*
+ * One entry per decode slot holds the issue cycles of the instruction
+ * class, the interlock a load puts on an instruction that uses its
+ * result right away, and which register fields the class reads (so
+ * immediates are never mistaken for a loaded register). Costs that
+ * depend on operands (multiplier value, register list length, taken
+ * branches) are added by the engine while executing.
+ *
+ * The tables are built once at startup by Init from the encoding
+ * rules, and the engine charges them per retired instruction (the
+ * interpreter has no blocks to charge at once).
+ */
+
+
+u16 CycleTable::Arm  [4096];
+u16 CycleTable::Thumb[256];
+
+
+static u16 Load(u32 wait)
+{
+	return 1 | (wait << CYCLE_WAIT_SHIFT);
+}
+
+static u16 Operand(u32 hi)
+{
+	u32 op = (hi >> 1) & 0xF;
+
+	/* MOV and MVN have no first operand */
+	return (op == 13 || op == 15) ? 0 : CYCLE_RN;
+}
+
+void CycleTable::Init(void)
+{
+	/* ARM instructions */
+	for (u32 idx = 0; idx < 4096; idx++) {
+		u32 hi = idx >> 4;		// Bits 27-20
+		u32 lo = idx & 0xF;		// Bits 7-4
+		u16 e  = 1;
+
+		switch (hi >> 5) {
+		case 0:
+			if (lo == 9) {
+				/* MUL/MLA, long multiplies, SWP */
+				if ((hi & 0xFC) == 0x00)
+					e = (1 + ((hi >> 1) & 1)) | CYCLE_RM | CYCLE_RS | ((hi & 2) ? CYCLE_RD : 0);
+				else if ((hi & 0xF8) == 0x08)
+					e = (2 + ((hi >> 1) & 1)) | CYCLE_RM | CYCLE_RS | ((hi & 2) ? CYCLE_RD | CYCLE_RN : 0);
+				else if ((hi & 0xFB) == 0x10)
+					e = 2 | CYCLE_RN | CYCLE_RM;
+			} else if ((lo & 9) == 9) {
+				/* Halfword and signed transfers (register offset without bit 22) */
+				e = ((hi & 1) ? Load(2) : 1 | CYCLE_RD) | CYCLE_RN | ((hi & 4) ? 0 : CYCLE_RM);
+			} else if (lo & 1) {
+				/* BX/BLX, or a register specified shift */
+				if (hi == 0x12 && (lo == 1 || lo == 3))
+					e = 1 | CYCLE_RM;
+				else
+					e = 2 | Operand(hi) | CYCLE_RM | CYCLE_RS;
+			} else if ((hi & 0xF9) == 0x10) {
+				/* MRS, MSR (bits 19-16 are the field mask) */
+				e = 1 | ((hi & 2) ? CYCLE_RM : 0);
+			} else {
+				/* Immediate shift */
+				e = 1 | Operand(hi) | CYCLE_RM;
+			}
+
+			break;
+
+		case 1:
+			/* Immediate operand (MSR has no register) */
+			if ((hi & 0xFB) != 0x32)
+				e = 1 | Operand(hi);
+
+			break;
+
+		case 2:
+		case 3:
+			/* LDR/LDRB/STR/STRB (register offset in the second half) */
+			e  = (hi & 1) ? Load((hi & 4) ? 2 : 1) : 1 | CYCLE_RD;
+			e |= CYCLE_RN | ((hi >> 5) == 3 ? CYCLE_RM : 0);
+			break;
+
+		case 4:
+		case 6:
+			/* LDM/STM, LDC/STC (base register) */
+			e = 1 | CYCLE_RN;
+			break;
+
+		case 7:
+			/* MRC/MCR */
+			if (!(hi & 0x10) && (lo & 1))
+				e = (hi & 1) ? 2 : 1 | CYCLE_RD;
+
+			break;
+		}
+
+		Arm[idx] = e;
+	}
+
+	/* Thumb instructions */
+	for (u32 idx = 0; idx < 256; idx++) {
+		u16 e = 1;
+
+		if ((idx >> 3) < 0x03) {
+			/* Shift by immediate */
+			e = 1 | CYCLE_T3;
+		} else if ((idx >> 3) == 0x03) {
+			/* ADD/SUB (register or 3-bit immediate) */
+			e = 1 | CYCLE_T3 | ((idx & 4) ? 0 : CYCLE_T6);
+		} else if ((idx >> 5) == 0x1) {
+			/* MOV/CMP/ADD/SUB 8-bit immediate */
+			e = 1 | ((((idx >> 3) & 3) != 0) ? CYCLE_T8 : 0);
+		} else if ((idx >> 2) == 0x10) {
+			/* ALU operations */
+			e = 1 | CYCLE_T0 | CYCLE_T3;
+		} else if ((idx >> 2) == 0x11) {
+			/* High register ADD/CMP, MOV, BX */
+			e = 1 | CYCLE_TM | (((idx & 3) < 2) ? CYCLE_TD : 0);
+		} else if ((idx >> 3) == 0x09) {
+			/* LDR (pc relative) */
+			e = Load(1) | CYCLE_HIRD;
+		} else if ((idx >> 4) == 0x5) {
+			/* Register offset: STR, STRH, STRB, LDRSB, LDR, LDRH, LDRB, LDRSH */
+			u32 op = (idx >> 1) & 7;
+
+			e  = (op >= 3) ? Load((op == 4) ? 1 : 2) : 1 | CYCLE_T0;
+			e |= CYCLE_T3 | CYCLE_T6;
+		} else if ((idx >> 5) == 0x3) {
+			/* Immediate offset */
+			e  = (idx & 0x08) ? Load((idx & 0x10) ? 2 : 1) : 1 | CYCLE_T0;
+			e |= CYCLE_T3;
+		} else if ((idx >> 4) == 0x8) {
+			/* Halfword */
+			e  = (idx & 0x08) ? Load(2) : 1 | CYCLE_T0;
+			e |= CYCLE_T3;
+		} else if ((idx >> 4) == 0x9) {
+			/* SP relative */
+			e = (idx & 0x08) ? Load(1) | CYCLE_HIRD : 1 | CYCLE_T8;
+		} else if ((idx >> 4) == 0xC) {
+			/* STMIA/LDMIA (base register) */
+			e = 1 | CYCLE_T8;
+		}
+
+		Thumb[idx] = e;
+	}
+}
@@ -0,0 +1,110 @@
+/*
+ * ARM9 emulator - Instruction cycle table
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CYCLES_HPP__
+#define __CYCLES_HPP__
+
+#include "types.h"
+
+/* Constants */
+#define CYCLE_REFILL	2		// Taken branch (pipeline refill)
+#define CYCLE_WAIT_SHIFT	4
+
+/* Table entry */
+enum {
+	CYCLE_BASE = 0x0F,		// Issue cycles
+	CYCLE_WAIT = 0x30,		// Load-use interlock of a load
+	CYCLE_HIRD = 0x40,		// Thumb load into the r8-r10 field
+
+	/* Source registers (ARM) */
+	CYCLE_RN   = 0x0100,		// Bits 19-16
+	CYCLE_RD   = 0x0200,		// Bits 15-12 (stores, accumulators)
+	CYCLE_RS   = 0x0400,		// Bits 11-8
+	CYCLE_RM   = 0x0800,		// Bits 3-0
+
+	/* Source registers (Thumb) */
+	CYCLE_T0   = 0x0100,		// Bits 2-0
+	CYCLE_T3   = 0x0200,		// Bits 5-3
+	CYCLE_T6   = 0x0400,		// Bits 8-6
+	CYCLE_T8   = 0x0800,		// Bits 10-8
+	CYCLE_TM   = 0x1000,		// Bits 6-3 (high register operations)
+	CYCLE_TD   = 0x2000,		// Bits 7, 2-0 (high register operations)
+};
+
+
+/* Cycle table class (ARM9E-S) */
+class CycleTable {
+public:
+	/* Tables (ARM: opcode bits 27-20 and 7-4, Thumb: bits 15-8), read-only after Init */
+	static u16 Arm  [4096];
+	static u16 Thumb[256];
+
+	/* Build function */
+	static void Init(void);
+
+	static inline u32 ArmIndex(u32 opcode) {
+		return ((opcode >> 16) & 0xFF0) | ((opcode >> 4) & 0xF);
+	}
+
+	/* Registers read by an instruction (bit mask) */
+	static inline u32 ArmUses(u16 entry, u32 opcode) {
+		u32 uses = 0;
+
+		if (entry & CYCLE_RN) uses |= 1 << ((opcode >> 16) & 0xF);
+		if (entry & CYCLE_RD) uses |= 1 << ((opcode >> 12) & 0xF);
+		if (entry & CYCLE_RS) uses |= 1 << ((opcode >>  8) & 0xF);
+		if (entry & CYCLE_RM) uses |= 1 << ((opcode >>  0) & 0xF);
+
+		return uses;
+	}
+
+	static inline u32 ThumbUses(u16 entry, u16 opcode) {
+		u32 uses = 0;
+
+		if (entry & CYCLE_T0) uses |= 1 << ((opcode >> 0) & 7);
+		if (entry & CYCLE_T3) uses |= 1 << ((opcode >> 3) & 7);
+		if (entry & CYCLE_T6) uses |= 1 << ((opcode >> 6) & 7);
+		if (entry & CYCLE_T8) uses |= 1 << ((opcode >> 8) & 7);
+		if (entry & CYCLE_TM) uses |= 1 << ((opcode >> 3) & 0xF);
+		if (entry & CYCLE_TD) uses |= 1 << (((opcode >> 4) & 8) | (opcode & 7));
+
+		return uses;
+	}
+
+	/* Multiply with early termination (8 multiplier bits per cycle) */
+	static inline u32 Multiply(u32 rs) {
+		if (!(rs >> 8)  || (rs >> 8)  == 0xFFFFFF)
+			return 1;
+		if (!(rs >> 16) || (rs >> 16) == 0xFFFF)
+			return 2;
+		if (!(rs >> 24) || (rs >> 24) == 0xFF)
+			return 3;
+
+		return 4;
+	}
+
+	/* Extra cycles of a block transfer (one per register after the first) */
+	static inline u32 Transfer(u32 list) {
+		u32 count = __builtin_popcount(list);
+
+		return (count) ? count - 1 : 0;
+	}
+};
+
+#endif /* __CYCLES_HPP__ */
@@ -0,0 +1,558 @@
+/*
+ * ARM9 emulator - Disassembler
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * Copyright (C) 2010 - crediar, megazig
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "disasm.hpp"
+#include "memory.hpp"
+
+/* Rotate macro */
+#define ROR(x,y)	((x >> y) | (x << (32 - y)))
+
+
+/* Condition suffixes */
+static const char *Conds[16] = {
+	"eq", "ne", "cs", "cc", "mi", "pl", "vs", "vc",
+	"hi", "ls", "ge", "lt", "gt", "le", "",   ""
+};
+
+/* Data processing mnemonics */
+static const char *Ops[16] = {
+	"and", "eor", "sub", "rsb", "add", "adc", "sbc", "rsc",
+	"tst", "teq", "cmp", "cmn", "orr", "mov", "bic", "mvn"
+};
+
+/* Thumb ALU mnemonics */
+static const char *ThumbOps[16] = {
+	"and", "eor", "lsl", "lsr", "asr", "adc", "sbc", "ror",
+	"tst", "neg", "cmp", NULL,  "orr", "mul", "bic", NULL
+};
+
+
+DisasmRead Disasm::Read = Memory::Fetch32;
+
+
+void Disasm::CondPrint(FILE *fp, u32 cond)
+{
+	/* Print condition */
+	fprintf(fp, "%s", Conds[cond & 0xF]);
+}
+
+void Disasm::SuffPrint(FILE *fp, u32 opcode)
+{
+	if ((opcode >> 20) & 1)
+		fprintf(fp, "s");
+}
+
+void Disasm::ShiftPrint(FILE *fp, u32 opcode)
+{
+	static const char *names[4] = { "LSL", "LSR", "ASR", "ROR" };
+
+	u32 amt = (opcode >> 7) & 0x1F;
+
+	if (amt)
+		fprintf(fp, ",%s#%d", names[(opcode >> 5) & 3], amt);
+}
+
+void Disasm::Arm(FILE *fp, u32 pc, u32 opcode)
+{
+	/* Registers */
+	u32 Rn    = ((opcode >> 16) & 0xF);
+	u32 Rd    = ((opcode >> 12) & 0xF);
+	u32 Rm    = ((opcode >> 0) & 0xF);
+	u32 Rs    = ((opcode >> 8) & 0xF);
+	u32 Imm   = ((opcode >> 0) & 0xFF);
+	u32 amt   = Rs << 1;
+
+	/* Flags */
+	bool I = (opcode >> 25) & 1;
+	bool P = (opcode >> 24) & 1;
+	bool U = (opcode >> 23) & 1;
+	bool B = (opcode >> 22) & 1;
+	bool W = (opcode >> 21) & 1;
+	bool S = (opcode >> 20) & 1;
+	bool L = (opcode >> 20) & 1;
+
+	fprintf(fp, "%08X [A] ", pc);
+
+	if (((opcode >> 8) & 0xFFFFF) == 0x12FFF) {
+		bool link = (opcode >> 5) & 1;
+
+		fprintf(fp, "b%sx", (link) ? "l" : "");
+		CondPrint(fp, opcode >> 28);
+		fprintf(fp, " r%d\n", Rm);
+
+		return;
+	}
+
+	if ((opcode >> 24) == 0xEF) {
+		fprintf(fp, "swi 0x%X\n", opcode & 0xFFFFFF);
+		return;
+	}
+
+	if (((opcode >> 22) & 0x3F) == 0 &&
+	    ((opcode >>  4) & 0x0F) == 9) {
+		fprintf(fp, "%s", (W) ? "mla" : "mul");
+		CondPrint(fp, opcode >> 28);
+		SuffPrint(fp, opcode);
+
+		fprintf(fp, " r%d, r%d, r%d", Rn, Rm, Rs);
+		if (W)
+			fprintf(fp, ", r%d", Rd);
+		fprintf(fp, "\n");
+
+		return;
+	}
+
+	switch ((opcode >> 26) & 0x3) {
+	case 0: {
+		u32 op = (opcode >> 21) & 0xF;
+
+		switch (op) {
+		case 8:			// TST/MRS (CPSR)
+		case 9:			// TEQ/MSR (CPSR)
+		case 10:		// CMP/MRS (SPSR)
+		case 11: {		// CMN/MSR (SPSR)
+			if (!S) {
+				const char *psr = (B) ? "spsr" : "cpsr";
+
+				/* MRS */
+				if (!(op & 1)) {
+					fprintf(fp, "mrs");
+					CondPrint(fp, opcode >> 28);
+					fprintf(fp, " r%d, %s\n", Rd, psr);
+
+					return;
+				}
+
+				/* MSR (field mask) */
+				fprintf(fp, "msr");
+				CondPrint(fp, opcode >> 28);
+				fprintf(fp, " %s_%s%s%s%s", psr,
+					(Rn & 8) ? "f" : "",
+					(Rn & 4) ? "s" : "",
+					(Rn & 2) ? "x" : "",
+					(Rn & 1) ? "c" : "");
+
+				if (I)
+					fprintf(fp, ", #0x%X\n", ROR(Imm, amt));
+				else
+					fprintf(fp, ", r%d\n", Rm);
+
+				return;
+			}
+
+			fprintf(fp, "%s", Ops[op]);
+			CondPrint(fp, opcode >> 28);
+
+			if (op >= 10) {
+				if (I)
+					fprintf(fp, " r%d, 0x%08X\n", Rn, ROR(Imm, amt));
+				else
+					fprintf(fp, " r%d, r%d\n", Rn, Rm);
+			} else {
+				if (!I) {
+					fprintf(fp, " r%d, r%d\n", Rn, Rm);
+					ShiftPrint(fp, opcode);
+				} else
+					fprintf(fp, " r%d, #0x%X\n", Rn, ROR(Imm, amt));
+			}
+
+			return;
+		}
+
+		case 13:		// MOV
+		case 15: {		// MVN
+			fprintf(fp, "%s", Ops[op]);
+			CondPrint(fp, opcode >> 28);
+			SuffPrint(fp, opcode);
+
+			if (!I) {
+				fprintf(fp, " r%d, r%d", Rd, Rm);
+				ShiftPrint(fp, opcode);
+			} else
+				fprintf(fp, " r%d, #0x%X", Rd, ROR(Imm, amt));
+
+			fprintf(fp, "\n");
+			return;
+		}
+
+		default: {
+			fprintf(fp, "%s", Ops[op]);
+			CondPrint(fp, opcode >> 28);
+			SuffPrint(fp, opcode);
+
+			if (!I) {
+				fprintf(fp, " r%d, r%d, r%d", Rd, Rn, Rm);
+				ShiftPrint(fp, opcode);
+			} else
+				fprintf(fp, " r%d, r%d, #0x%X", Rd, Rn, ROR(Imm, amt));
+
+			fprintf(fp, "\n");
+			return;
+		}
+		}
+	}
+
+	case 1: {		// LDR/STR
+		fprintf(fp, "%s%s", (L) ? "ldr" : "str", (B) ? "b" : "");
+		CondPrint(fp, opcode >> 28);
+		fprintf(fp, " r%d,", Rd);
+
+		Imm = opcode & 0xFFF;
+
+		if (L && Rn == 15) {
+			fprintf(fp, " =0x%X\n", Read(pc + Imm + 8));
+			return;
+		}
+
+		fprintf(fp, " [r%d", Rn);
+
+		if (I) {
+			fprintf(fp, ", %sr%d", (U) ? "" : "-", Rm);
+			ShiftPrint(fp, opcode);
+		} else
+			fprintf(fp, ", #%s0x%X", (U) ? "" : "-", Imm);
+
+		fprintf(fp, "]%s\n", (W) ? "!" : "");
+		return;
+	}
+
+	default:
+		break;
+	}
+
+	switch ((opcode >> 25) & 7) {
+	case 4: {		// LDM/STM
+		bool pf = false;
+
+		if (L) {
+			fprintf(fp, "ldm");
+			if (Rn == 13)
+				fprintf(fp, "%c%c", (P) ? 'e' : 'f', (U) ? 'd' : 'a');
+			else
+				fprintf(fp, "%c%c", (U) ? 'i' : 'd', (P) ? 'b' : 'a');
+		} else {
+			fprintf(fp, "stm");
+			if (Rn == 13)
+				fprintf(fp, "%c%c", (P) ? 'f' : 'e', (U) ? 'a' : 'd');
+			else
+				fprintf(fp, "%c%c", (U) ? 'i' : 'd', (P) ? 'b' : 'a');
+		}
+
+		if (Rn == 13)
+			fprintf(fp, " sp");
+		else
+			fprintf(fp, " r%d", Rn);
+
+		if (W) fprintf(fp, "!");
+		fprintf(fp, ", {");
+
+		for (s32 i = 0; i < 16; i++) {
+			if ((opcode >> i) & 1) {
+				if (pf) fprintf(fp, ", ");
+				fprintf(fp, "r%d", i);
+
+				pf = true;
+			}
+		}
+
+		fprintf(fp, "}%s\n", (B) ? "^" : "");
+		return;
+	}
+
+	case 5: {		// B/BL
+		bool link = opcode & (1 << 24);
+
+		fprintf(fp, "b%s", (link) ? "l" : "");
+		CondPrint(fp, opcode >> 28);
+
+		Imm = (opcode & 0xFFFFFF) << 2;
+		if (Imm & (1 << 25)) Imm = ~(~Imm & 0xFFFFFF);
+		Imm += sizeof(opcode) + sizeof(opcode);
+
+		fprintf(fp, " 0x%08X\n", pc + Imm);
+		return;
+	}
+
+	case 7: {		// MRC
+		fprintf(fp, "mrc ...\n");
+		return;
+	}
+	}
+
+	fprintf(fp, "Unknown opcode! (0x%08X)\n", opcode);
+}
+
+void Disasm::Thumb(FILE *fp, u32 pc, u16 opcode, u16 next)
+{
+	fprintf(fp, "%08X [T] ", pc);
+
+	/* Next PC */
+	pc += sizeof(opcode);
+
+	if ((opcode >> 13) == 0) {
+		u32 Imm = (opcode >> 6) & 0x1F;
+		u32 Rn  = (opcode >> 6) & 7;
+		u32 Rm  = (opcode >> 3) & 7;
+		u32 Rd  = (opcode >> 0) & 7;
+
+		switch ((opcode >> 11) & 3) {
+		case 0:			// LSL
+			fprintf(fp, "lsl r%d, r%d, #0x%02X\n", Rd, Rm, Imm);
+			return;
+
+		case 1:			// LSR
+			fprintf(fp, "lsr r%d, r%d, #0x%02X\n", Rd, Rm, Imm);
+			return;
+
+		case 2:			// ASR
+			fprintf(fp, "asr r%d, r%d, #0x%02X\n", Rd, Rm, Imm);
+			return;
+
+		case 3: {		// ADD, SUB
+			const char *op = (opcode & 0x200) ? "sub" : "add";
+
+			if (opcode & 0x400)
+				fprintf(fp, "%s r%d, r%d, #0x%02X\n", op, Rd, Rm, Imm & 7);
+			else
+				fprintf(fp, "%s r%d, r%d, r%d\n", op, Rd, Rm, Rn);
+
+			return;
+		}
+		}
+	}
+
+	if ((opcode >> 13) == 1) {
+		static const char *ops[4] = { "mov", "cmp", "add", "sub" };
+
+		u32 Imm = (opcode & 0xFF);
+		u32 Rn  = (opcode >> 8) & 7;
+
+		fprintf(fp, "%s r%d, #0x%02X\n", ops[(opcode >> 11) & 3], Rn, Imm);
+		return;
+	}
+
+	if ((opcode >> 10) == 0x10) {
+		u32 Rd = opcode & 7;
+		u32 Rm = (opcode >> 3) & 7;
+		u32 op = (opcode >> 6) & 0xF;
+
+		if (op == 11) {
+			fprintf(fp, "%s r%d, r%d\n", (opcode & 0x100) ? "mvn" : "cmn", Rd, Rm);
+			return;
+		}
+
+		if (ThumbOps[op]) {
+			fprintf(fp, "%s r%d, r%d\n", ThumbOps[op], Rd, Rm);
+			return;
+		}
+	}
+
+	if ((opcode >> 7) == 0x8F) {
+		fprintf(fp, "blx r%d\n", (opcode >> 3) & 0xF);
+		return;
+	}
+
+	if ((opcode >> 10) == 0x11) {
+		u32 Rd = ((opcode >> 4) & 8) | (opcode & 7);
+		u32 Rm = ((opcode >> 3) & 0xF);
+
+		switch ((opcode >> 8) & 3) {
+		case 0:			// ADD
+			fprintf(fp, "add r%d, r%d\n", Rd, Rm);
+			return;
+
+		case 1:			// CMP
+			fprintf(fp, "cmp r%d, r%d\n", Rd, Rm);
+			return;
+
+		case 2:			// MOV (NOP)
+			if (Rd == 8 && Rm == 8)
+				fprintf(fp, "nop\n");
+			else
+				fprintf(fp, "mov r%d, r%d\n", Rd, Rm);
+			return;
+
+		case 3:			// BX
+			fprintf(fp, "bx r%d\n", Rm);
+			return;
+		}
+	}
+
+	if ((opcode >> 11) == 9) {
+		u32 Rd   = (opcode >> 8) & 7;
+		u32 Imm  = (opcode & 0xFF);
+		u32 addr = pc + (Imm << 2) + sizeof(opcode);
+
+		fprintf(fp, "ldr r%d, =0x%08X\n", Rd, Read(addr));
+		return;
+	}
+
+	if ((opcode >> 12) == 5) {
+		static const char *ops[8] = { "str", NULL, "strb", NULL, "ldr", NULL, "ldrb", NULL };
+
+		u32 Rd = (opcode >> 0) & 7;
+		u32 Rn = (opcode >> 3) & 7;
+		u32 Rm = (opcode >> 6) & 7;
+		u32 op = (opcode >> 9) & 7;
+
+		if (ops[op]) {
+			fprintf(fp, "%s r%d, [r%d, r%d]\n", ops[op], Rd, Rn, Rm);
+			return;
+		}
+	}
+
+	if ((opcode >> 13) == 3) {
+		u32 Rd  = (opcode >> 0) & 7;
+		u32 Rn  = (opcode >> 3) & 7;
+		u32 Imm = (opcode >> 6) & 7;
+
+		if (opcode & 0x1000)
+			fprintf(fp, "%s r%d, [r%d, 0x%02X]\n", (opcode & 0x800) ? "ldrb" : "strb", Rd, Rn, Imm);
+		else
+			fprintf(fp, "%s r%d, [r%d, 0x%02X]\n", (opcode & 0x800) ? "ldr" : "str", Rd, Rn, Imm << 2);
+
+		return;
+	}
+
+	if ((opcode >> 12) == 8) {
+		u32 Rd  = (opcode >> 0) & 7;
+		u32 Rn  = (opcode >> 3) & 7;
+		u32 Imm = (opcode >> 6) & 7;
+
+		fprintf(fp, "%s r%d, [r%d, 0x%02X]\n", (opcode & 0x800) ? "ldrh" : "strh", Rd, Rn, Imm << 1);
+		return;
+	}
+
+	if ((opcode >> 12) == 9) {
+		u32 Rd  = (opcode >> 8) & 7;
+		u32 Imm = (opcode & 0xFF);
+
+		fprintf(fp, "%s r%d, [sp, 0x%02X]\n", (opcode & 0x800) ? "ldr" : "str", Rd, Imm << 2);
+		return;
+	}
+
+	if ((opcode >> 12) == 10) {
+		u32 Rd  = (opcode >> 8) & 7;
+		u32 Imm = (opcode & 0xFF);
+
+		fprintf(fp, "add r%d, %s, #0x%02X\n", Rd, (opcode & 0x800) ? "sp" : "pc", Imm << 2);
+		return;
+	}
+
+	if ((opcode >> 12) == 11) {
+		switch ((opcode >> 9) & 7) {
+		case 0: {		// ADD/SUB
+			u32 Imm = (opcode & 0x7F);
+
+			fprintf(fp, "%s sp, #0x%02X\n", (opcode & 0x80) ? "sub" : "add", Imm << 2);
+			return;
+		}
+
+		case 2:			// PUSH
+		case 6: {		// POP
+			bool pop = (opcode >> 11) & 1;
+			bool pf  = false;
+
+			fprintf(fp, "%s {", (pop) ? "pop" : "push");
+
+			for (s32 i = 0; i < 8; i++) {
+				if ((opcode >> i) & 1) {
+					if (pf) fprintf(fp, ",");
+					fprintf(fp, "r%d", i);
+
+					pf = true;
+				}
+			}
+
+			if (opcode & 0x100) {
+				if (pf) fprintf(fp, ",");
+				fprintf(fp, "%s", (pop) ? "pc" : "lr");
+			}
+
+			fprintf(fp, "}\n");
+			return;
+		}
+		}
+	}
+
+	if ((opcode >> 12) == 12) {
+		u32 Rn = (opcode >> 8) & 7;
+
+		fprintf(fp, "%s r%d!, {", (opcode & 0x800) ? "ldmia" : "stmia", Rn);
+
+		for (u32 i = 0; i < 8; i++)
+			if ((opcode >> i) & 1)
+				fprintf(fp, "r%d,", i);
+
+		fprintf(fp, "}\n");
+		return;
+	}
+
+	if ((opcode >> 8) == 0xDF) {
+		fprintf(fp, "swi 0x%X\n", opcode & 0xFF);
+		return;
+	}
+
+	if ((opcode >> 12) == 13) {
+		u32 Imm = (opcode & 0xFF) << 1;
+
+		if (Imm & 0x100)
+			Imm = ~((~Imm) & 0xFF);
+
+		Imm += 2;
+
+		fprintf(fp, "b");
+		CondPrint(fp, opcode >> 8);
+		fprintf(fp, " 0x%08X\n", pc + Imm);
+
+		return;
+	}
+
+	if ((opcode >> 11) == 28) {
+		u32 Imm = (opcode & 0x7FF) << 1;
+		u32 dst;
+
+		if (Imm & (1 << 11)) {
+			Imm = (~Imm) & 0xFFE;
+			dst = pc - Imm;
+		} else
+			dst = pc + Imm + 2;
+
+		fprintf(fp, "b 0x%08X, 0x%X\n", dst, Imm);
+		return;
+	}
+
+	if ((opcode >> 11) == 0x1E) {
+		u32  Imm = ((opcode & 0x7FF) << 12) | ((next & 0x7FF) << 1);
+		bool blx = ((opcode >> 11) & 3) == 3;
+		u32  dst;
+
+		if (Imm & (1 << 22)) {
+			Imm = (~Imm) & 0x7FFFFE;
+			dst = pc - Imm;
+		} else
+			dst = pc + Imm + 2;
+
+		fprintf(fp, "%s 0x%08X\n", (blx) ? "blx" : "bl", dst);
+		return;
+	}
+
+	fprintf(fp, "Unknown opcode! (0x%04X)\n", opcode);
+}
@@ -0,0 +1,46 @@
+/*
+ * ARM9 emulator - Disassembler
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DISASM_HPP__
+#define __DISASM_HPP__
+
+#include <cstdio>
+#include "types.h"
+
+/* Literal reader */
+typedef u32 (*DisasmRead)(u32 address);
+
+
+/* Disassembler class */
+class Disasm {
+	/* Print functions */
+	static void CondPrint (FILE *fp, u32 cond);
+	static void SuffPrint (FILE *fp, u32 opcode);
+	static void ShiftPrint(FILE *fp, u32 opcode);
+
+public:
+	/* Literal reader */
+	static DisasmRead Read;
+
+	/* Disassemble functions */
+	static void Arm  (FILE *fp, u32 pc, u32 opcode);
+	static void Thumb(FILE *fp, u32 pc, u16 opcode, u16 next);
+};
+
+#endif /* __DISASM_HPP__ */
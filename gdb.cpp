@@ -0,0 +1,547 @@
+/*
+ * ARM9 emulator - GDB remote stub
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "endian.h"
+#include "gdb.hpp"
+#include "memory.hpp"
+
+/*
+ * Register layout (legacy ARM "g" packet, target byte order):
+ *
+ *   r0-r15          16 x 4 bytes
+ *   f0-f7           8 x 12 bytes (FPA, always zero)
+ *   fps             4 bytes (always zero)
+ *   cpsr            4 bytes (register 25)
+ *
+ * Continue runs the engine in GDB_CHUNK sized bursts and only polls
+ * the socket for a break (0x03) in between, breakpoints and
+ * watchpoints are caught by the engine through the page flags.
+ */
+
+/* Register numbers */
+#define REG_FPA		16
+#define REG_CPSR	25
+#define REG_BYTES	(16 * 4 + 8 * 12 + 4 + 4)
+
+
+static const char *Hex = "0123456789abcdef";
+
+
+static string HexWord(u32 value)
+{
+	u32    word = Swap32(value);
+	u8    *buf  = (u8 *)&word;
+	string ret;
+
+	/* Target byte order */
+	for (u32 i = 0; i < sizeof(word); i++) {
+		ret += Hex[buf[i] >> 4];
+		ret += Hex[buf[i] & 0xF];
+	}
+
+	return ret;
+}
+
+static u32 ParseWord(const char *data)
+{
+	u32 word;
+	u8 *buf = (u8 *)&word;
+
+	/* Target byte order */
+	for (u32 i = 0; i < sizeof(word); i++) {
+		char byte[3] = { data[i * 2], data[i * 2 + 1], 0 };
+
+		buf[i] = strtoul(byte, NULL, 16);
+	}
+
+	return Swap32(word);
+}
+
+
+GDB::GDB(ARM *cpu, Replay *replay)
+{
+	/* Set parameters */
+	this->cpu    = cpu;
+	this->replay = replay;
+
+	/* Clear state */
+	server = client = -1;
+	pos    = len    = 0;
+}
+
+GDB::~GDB(void)
+{
+	/* Close sockets */
+	if (client >= 0)
+		close(client);
+	if (server >= 0)
+		close(server);
+}
+
+s32 GDB::Getc(void)
+{
+	/* Refill buffer */
+	if (pos == len) {
+		s32 ret = recv(client, buffer, sizeof(buffer), 0);
+
+		if (ret <= 0)
+			return -1;
+
+		pos = 0;
+		len = ret;
+	}
+
+	return buffer[pos++];
+}
+
+bool GDB::Interrupt(void)
+{
+	/* Check for pending data */
+	if (pos == len) {
+		struct pollfd pfd;
+
+		pfd.fd     = client;
+		pfd.events = POLLIN;
+
+		if (poll(&pfd, 1, 0) <= 0)
+			return false;
+	}
+
+	/* Break request (or lost connection) */
+	s32 c = Getc();
+
+	return (c == 0x03 || c < 0);
+}
+
+bool GDB::Receive(string &packet)
+{
+	for (;;) {
+		u8  sum = 0;
+		s32 c;
+
+		/* Packet start */
+		do {
+			c = Getc();
+			if (c < 0)
+				return false;
+		} while (c != '$');
+
+		packet.clear();
+
+		/* Packet data */
+		for (;;) {
+			c = Getc();
+			if (c < 0)
+				return false;
+			if (c == '#')
+				break;
+
+			packet += c;
+			sum    += c;
+		}
+
+		/* Checksum */
+		char csum[3] = { 0, 0, 0 };
+
+		for (u32 i = 0; i < 2; i++) {
+			c = Getc();
+			if (c < 0)
+				return false;
+
+			csum[i] = c;
+		}
+
+		/* Acknowledge */
+		if (strtoul(csum, NULL, 16) == sum) {
+			send(client, "+", 1, 0);
+			return true;
+		}
+
+		send(client, "-", 1, 0);
+	}
+}
+
+void GDB::Send(const string &packet)
+{
+	string buf;
+	u8     sum = 0;
+
+	/* Build packet */
+	for (u32 i = 0; i < packet.size(); i++)
+		sum += packet[i];
+
+	buf  = "$" + packet + "#";
+	buf += Hex[sum >> 4];
+	buf += Hex[sum & 0xF];
+
+	for (;;) {
+		s32 c;
+
+		/* Send packet */
+		send(client, buf.c_str(), buf.size(), 0);
+
+		/* Wait for acknowledge */
+		c = Getc();
+		if (c != '-')
+			break;
+	}
+}
+
+string GDB::Stop(u32 reason)
+{
+	char buf[64];
+
+	switch (reason) {
+	case STOP_FINISH:
+		/* Exited */
+		sprintf(buf, "W%02x", cpu->PeekReg(0) & 0xFF);
+		break;
+
+	case STOP_WATCH: {
+		const Watchpoint &watch = cpu->WatchHit();
+		const char *kind;
+
+		/* Watchpoint kind */
+		if (watch.type == WATCH_WRITE)
+			kind = "watch";
+		else if (watch.type == WATCH_READ)
+			kind = "rwatch";
+		else
+			kind = "awatch";
+
+		sprintf(buf, "T05%s:%08x;", kind, watch.address);
+		break;
+	}
+
+	default:
+		/* Trap */
+		sprintf(buf, "S05");
+	}
+
+	return buf;
+}
+
+string GDB::ReadRegs(void)
+{
+	string ret;
+
+	/* GPRs */
+	for (u32 i = 0; i < 16; i++)
+		ret += HexWord(cpu->PeekReg(i));
+
+	/* FPA registers and status */
+	ret.append(8 * 12 * 2 + 4 * 2, '0');
+
+	/* CPSR */
+	ret += HexWord(cpu->PeekCPSR());
+
+	return ret;
+}
+
+void GDB::WriteRegs(const char *data)
+{
+	/* CPSR first (a mode change swaps the banked registers) */
+	cpu->PokeCPSR(ParseWord(data + (REG_BYTES - 4) * 2));
+
+	/* GPRs (into the new mode's bank) */
+	for (u32 i = 0; i < 16; i++)
+		cpu->PokeReg(i, ParseWord(data + i * 8));
+}
+
+string GDB::ReadMem(u32 address, u32 size)
+{
+	string ret;
+
+	/* Read bytes (stop at unmapped or device memory) */
+	for (u32 i = 0; i < size; i++) {
+		u8 value;
+
+		if (!Memory::Peek8(address + i, value))
+			return (i) ? ret : "E01";
+
+		ret += Hex[value >> 4];
+		ret += Hex[value & 0xF];
+	}
+
+	return ret;
+}
+
+bool GDB::WriteMem(u32 address, u32 size, const char *data)
+{
+	/* Check length */
+	if (strlen(data) < size * 2)
+		return false;
+
+	/* Write bytes */
+	for (u32 i = 0; i < size; i++) {
+		char byte[3] = { data[i * 2], data[i * 2 + 1], 0 };
+
+		if (!Memory::Poke8(address + i, strtoul(byte, NULL, 16)))
+			return false;
+	}
+
+	return true;
+}
+
+string GDB::Point(char op, const char *args)
+{
+	char *end;
+	u32   type, address, size;
+
+	/* Parse arguments */
+	type    = strtoul(args,    &end, 16);
+	address = strtoul(end + 1, &end, 16);
+	size    = strtoul(end + 1, &end, 16);
+
+	switch (type) {
+	case 0:		// Software breakpoint
+	case 1:		// Hardware breakpoint
+		if (op == 'Z')
+			cpu->BreakAdd(address);
+		else
+			cpu->BreakDel(address);
+
+		break;
+
+	case 2:		// Write watchpoint
+	case 3:		// Read watchpoint
+	case 4: {	// Access watchpoint
+		u8 kind = (type == 2) ? WATCH_WRITE : (type == 3) ? WATCH_READ : (WATCH_READ | WATCH_WRITE);
+
+		if (op == 'Z')
+			cpu->WatchAdd(address, size, kind);
+		else
+			cpu->WatchDel(address, size, kind);
+
+		break;
+	}
+
+	default:
+		/* Not supported */
+		return "";
+	}
+
+	return "OK";
+}
+
+string GDB::Continue(bool step)
+{
+	bool resume = true;
+
+	/* Single step */
+	if (step)
+		return Stop(cpu->Run(1, true));
+
+	for (;;) {
+		u32 reason;
+
+		/* Run a chunk at full speed */
+		reason = cpu->Run(GDB_CHUNK, resume);
+		resume = false;
+
+		if (reason != STOP_NONE)
+			return Stop(reason);
+
+		/* Break request */
+		if (Interrupt())
+			return "S02";
+	}
+}
+
+bool GDB::Listen(const char *address)
+{
+	struct sockaddr_in addr;
+
+	const char *port;
+	s32 opt = 1;
+
+	/* Parse address */
+	port = strrchr(address, ':');
+	port = (port) ? port + 1 : address;
+
+	memset(&addr, 0, sizeof(addr));
+
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons(atoi(port));
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (port != address + 1 && port != address) {
+		string host(address, port - address - 1);
+
+		if (!inet_aton(host.c_str(), &addr.sin_addr))
+			return false;
+	}
+
+	/* Create socket */
+	server = socket(AF_INET, SOCK_STREAM, 0);
+	if (server < 0)
+		return false;
+
+	setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+	/* Bind and listen */
+	if (bind(server, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(server, 1) < 0)
+		return false;
+
+	cout << "GDB: waiting for connection on port " << dec << ntohs(addr.sin_port) << endl;
+
+	/* Accept client */
+	client = accept(server, NULL, NULL);
+	if (client < 0)
+		return false;
+
+	setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+	return true;
+}
+
+void GDB::Serve(void)
+{
+	string packet;
+
+	while (Receive(packet)) {
+		const char *args = packet.c_str() + 1;
+		string      reply;
+
+		char *end;
+		u32   address, size;
+
+		switch (packet[0]) {
+		case '?':		// Stop reason
+			reply = "S05";
+			break;
+
+		case 'g':		// Read registers
+			reply = ReadRegs();
+			break;
+
+		case 'G':		// Write registers
+			if (strlen(args) < REG_BYTES * 2) {
+				reply = "E01";
+				break;
+			}
+
+			WriteRegs(args);
+			reply = "OK";
+			break;
+
+		case 'p': {		// Read register
+			u32 idx = strtoul(args, NULL, 16);
+
+			if (idx < 16)
+				reply = HexWord(cpu->PeekReg(idx));
+			else if (idx == REG_CPSR)
+				reply = HexWord(cpu->PeekCPSR());
+			else
+				reply = (idx < REG_CPSR - 1) ? string(24, '0') : string(8, '0');
+
+			break;
+		}
+
+		case 'P': {		// Write register
+			u32 idx   = strtoul(args, &end, 16);
+			u32 value = ParseWord(end + 1);
+
+			if (idx < 16)
+				cpu->PokeReg(idx, value);
+			else if (idx == REG_CPSR)
+				cpu->PokeCPSR(value);
+
+			reply = "OK";
+			break;
+		}
+
+		case 'm':		// Read memory
+			address = strtoul(args,    &end, 16);
+			size    = strtoul(end + 1, &end, 16);
+
+			reply = ReadMem(address, size);
+			break;
+
+		case 'M':		// Write memory
+			address = strtoul(args,    &end, 16);
+			size    = strtoul(end + 1, &end, 16);
+
+			reply = WriteMem(address, size, end + 1) ? "OK" : "E01";
+			break;
+
+		case 'c':		// Continue
+		case 's':		// Step
+			if (*args)
+				cpu->SetPC(strtoul(args, NULL, 16));
+
+			reply = Continue(packet[0] == 's');
+			break;
+
+		case 'b':		// Reverse step/continue
+			if (!replay || (packet != "bs" && packet != "bc"))
+				break;
+
+			if (packet == "bs" ? replay->StepBack() : replay->ContinueBack())
+				reply = "S05";
+			else
+				reply = "T05replaylog:begin;";
+
+			break;
+
+		case 'Z':		// Insert breakpoint/watchpoint
+		case 'z':		// Remove breakpoint/watchpoint
+			reply = Point(packet[0], args);
+			break;
+
+		case 'H':		// Set thread
+			reply = "OK";
+			break;
+
+		case 'q':		// Queries
+			if (!packet.compare(0, 10, "qSupported")) {
+				reply = "PacketSize=1000";
+
+				if (replay)
+					reply += ";ReverseStep+;ReverseContinue+";
+			} else if (packet == "qAttached")
+				reply = "1";
+			else if (packet == "qC")
+				reply = "QC1";
+
+			break;
+
+		case 'D':		// Detach
+			Send("OK");
+			return;
+
+		case 'k':		// Kill
+			return;
+		}
+
+		/* Send reply */
+		Send(reply);
+	}
+}
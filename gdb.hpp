@@ -0,0 +1,78 @@
+/*
+ * ARM9 emulator - GDB remote stub
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GDB_HPP__
+#define __GDB_HPP__
+
+#include <string>
+#include "arm.hpp"
+#include "replay.hpp"
+#include "types.h"
+
+using namespace std;
+
+/* Constants */
+#define GDB_PACKET	4096		// Max packet size
+#define GDB_CHUNK	65536		// Instructions between interrupt polls
+
+
+/* GDB stub class */
+class GDB {
+	ARM    *cpu;
+	Replay *replay;
+
+	/* Sockets */
+	s32 server;
+	s32 client;
+
+	/* Receive buffer */
+	u8  buffer[GDB_PACKET];
+	u32 pos;
+	u32 len;
+
+private:
+	/* Socket functions */
+	s32  Getc     (void);
+	bool Interrupt(void);
+
+	/* Packet functions */
+	bool Receive(string &packet);
+	void Send   (const string &packet);
+
+	/* Command functions */
+	string Stop    (u32 reason);
+	string ReadRegs(void);
+	void   WriteRegs(const char *data);
+	string ReadMem (u32 address, u32 size);
+	bool   WriteMem(u32 address, u32 size, const char *data);
+	string Point   (char op, const char *args);
+	string Continue(bool step);
+
+public:
+	 GDB(ARM *cpu, Replay *replay);
+	~GDB(void);
+
+	/* Listen function */
+	bool Listen(const char *address);
+
+	/* Serve function */
+	void Serve(void);
+};
+
+#endif /* __GDB_HPP__ */
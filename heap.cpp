@@ -0,0 +1,370 @@
+/*
+ * ARM9 emulator - Guest heap
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "heap.hpp"
+#include "memory.hpp"
+
+/*
+ * The whole heap range is a single anonymous VSpace, so allocations
+ * never add spaces for Memory::Find to walk. Pages are tracked in a
+ * bitmap and handed out top-down, leaving the bottom of the range for
+ * the program break to grow into. Region records come from a fixed
+ * arena, kept sorted by address and merged with their neighbours.
+ * Freed pages are released to the host and read back as zero.
+ */
+
+
+static inline u32 Pages(u32 size)
+{
+	return (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+}
+
+
+Heap::Heap(void)
+{
+	/* Clear state */
+	base  = size = pages = 0;
+
+	bitmap  = NULL;
+	arena   = NULL;
+	regions = HEAP_NONE;
+	slots   = HEAP_NONE;
+}
+
+Heap::~Heap(void)
+{
+	/* Free metadata */
+	delete[] bitmap;
+	delete[] arena;
+}
+
+bool Heap::Used(u32 page)
+{
+	return bitmap[page >> 5] & (1U << (page & 31));
+}
+
+void Heap::Mark(u32 page, u32 count, bool used)
+{
+	/* Update bits */
+	for (u32 i = page; i < page + count; i++) {
+		u32 bit = 1U << (i & 31);
+
+		/* Whole words */
+		if (!(i & 31) && i + 32 <= page + count) {
+			bitmap[i >> 5] = (used) ? ~0U : 0;
+			i += 31;
+
+			continue;
+		}
+
+		if (used)
+			bitmap[i >> 5] |=  bit;
+		else
+			bitmap[i >> 5] &= ~bit;
+	}
+}
+
+bool Heap::Find(u32 count, u32 &page)
+{
+	u32 run = 0;
+
+	/* Search top-down for a free run */
+	for (u32 i = (pages + 31) & ~31; i-- > 0; ) {
+		u32 word = bitmap[i >> 5];
+
+		/* Skip full and empty words */
+		if ((i & 31) == 31 && (word == ~0U || !word)) {
+			i  -= 31;
+			run = (word) ? 0 : run + 32;
+		} else
+			run = (word & (1U << (i & 31))) ? 0 : run + 1;
+
+		/* Highest pages of the run */
+		if (run >= count) {
+			page = i + run - count;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+u32 Heap::Slot(void)
+{
+	u32 idx = slots;
+
+	/* Pop free slot */
+	if (idx != HEAP_NONE)
+		slots = arena[idx].next;
+
+	return idx;
+}
+
+bool Heap::Insert(u32 address, u32 count, u32 type)
+{
+	u32 prev = HEAP_NONE, next = regions;
+	u32 idx;
+
+	/* Find position */
+	while (next != HEAP_NONE && arena[next].address < address) {
+		prev = next;
+		next = arena[next].next;
+	}
+
+	/* Extend previous region */
+	if (prev != HEAP_NONE && arena[prev].type == type &&
+	    arena[prev].address + (arena[prev].pages << PAGE_SHIFT) == address) {
+		arena[prev].pages += count;
+
+		/* Swallow next region */
+		if (next != HEAP_NONE && arena[next].type == type &&
+		    address + (count << PAGE_SHIFT) == arena[next].address) {
+			arena[prev].pages += arena[next].pages;
+			arena[prev].next   = arena[next].next;
+
+			arena[next].next = slots;
+			slots            = next;
+		}
+
+		return true;
+	}
+
+	/* Extend next region */
+	if (next != HEAP_NONE && arena[next].type == type &&
+	    address + (count << PAGE_SHIFT) == arena[next].address) {
+		arena[next].address  = address;
+		arena[next].pages   += count;
+
+		return true;
+	}
+
+	/* New region */
+	idx = Slot();
+	if (idx == HEAP_NONE)
+		return false;
+
+	arena[idx].address = address;
+	arena[idx].pages   = count;
+	arena[idx].type    = type;
+	arena[idx].next    = next;
+
+	if (prev != HEAP_NONE)
+		arena[prev].next = idx;
+	else
+		regions = idx;
+
+	return true;
+}
+
+bool Heap::Remove(u32 address, u32 count)
+{
+	u32 end  = address + (count << PAGE_SHIFT);
+	u32 prev = HEAP_NONE, idx = regions;
+
+	while (idx != HEAP_NONE && arena[idx].address < end) {
+		HeapRegion *region = &arena[idx];
+
+		u32 rstart = region->address;
+		u32 rend   = rstart + (region->pages << PAGE_SHIFT);
+		u32 next   = region->next;
+
+		/* No overlap */
+		if (rend <= address) {
+			prev = idx;
+			idx  = next;
+
+			continue;
+		}
+
+		/* Hole in the middle: split */
+		if (rstart < address && rend > end) {
+			u32 tail = Slot();
+			if (tail == HEAP_NONE)
+				return false;
+
+			arena[tail].address = end;
+			arena[tail].pages   = (rend - end) >> PAGE_SHIFT;
+			arena[tail].type    = region->type;
+			arena[tail].next    = next;
+
+			region->pages = (address - rstart) >> PAGE_SHIFT;
+			region->next  = tail;
+
+			return true;
+		}
+
+		/* Trim tail */
+		if (rstart < address) {
+			region->pages = (address - rstart) >> PAGE_SHIFT;
+
+			prev = idx;
+			idx  = next;
+
+			continue;
+		}
+
+		/* Trim head */
+		if (rend > end) {
+			region->address = end;
+			region->pages   = (rend - end) >> PAGE_SHIFT;
+
+			return true;
+		}
+
+		/* Whole region */
+		if (prev != HEAP_NONE)
+			arena[prev].next = next;
+		else
+			regions = next;
+
+		region->next = slots;
+		slots        = idx;
+
+		idx = next;
+	}
+
+	return true;
+}
+
+bool Heap::Create(u32 base, u32 size)
+{
+	u32  words;
+	bool ret;
+
+	/* Check range */
+	if ((base | size) & (PAGE_SIZE - 1) || !size || base + size - 1 < base)
+		return false;
+
+	/* Reserve guest range */
+	ret = Memory::Create(base, size, true);
+	if (!ret)
+		return false;
+
+	/* Set parameters */
+	this->base  = base;
+	this->size  = size;
+	this->pages = size >> PAGE_SHIFT;
+
+	/* Allocate bitmap */
+	words  = (pages + 31) >> 5;
+	bitmap = new u32[words];
+
+	memset(bitmap, 0, words * sizeof(u32));
+
+	/* Pad bits past the range are never free */
+	Mark(pages, (words << 5) - pages, true);
+
+	/* Allocate arena */
+	arena = new HeapRegion[HEAP_REGIONS];
+
+	for (u32 i = 0; i < HEAP_REGIONS; i++)
+		arena[i].next = (i + 1 < HEAP_REGIONS) ? i + 1 : HEAP_NONE;
+
+	regions = HEAP_NONE;
+	slots   = 0;
+
+	return true;
+}
+
+u32 Heap::Alloc(u32 size, u32 type)
+{
+	u32  count = Pages(size);
+	u32  page, address;
+	bool ret;
+
+	if (!count || !bitmap)
+		return 0;
+
+	/* Find free pages */
+	ret = Find(count, page);
+	if (!ret)
+		return 0;
+
+	address = base + (page << PAGE_SHIFT);
+
+	/* Record region */
+	ret = Insert(address, count, type);
+	if (!ret)
+		return 0;
+
+	/* Mark pages */
+	Mark(page, count, true);
+
+	return address;
+}
+
+bool Heap::AllocAt(u32 address, u32 size, u32 type)
+{
+	u32  count = Pages(size);
+	u32  page  = (address - base) >> PAGE_SHIFT;
+	bool ret;
+
+	if (!count || !bitmap)
+		return false;
+
+	/* Check range */
+	if ((address & (PAGE_SIZE - 1)) || !Contains(address) || count > pages - page)
+		return false;
+
+	/* Check pages */
+	for (u32 i = page; i < page + count; i++)
+		if (Used(i))
+			return false;
+
+	/* Record region */
+	ret = Insert(address, count, type);
+	if (!ret)
+		return false;
+
+	/* Mark pages */
+	Mark(page, count, true);
+
+	return true;
+}
+
+bool Heap::Free(u32 address, u32 size)
+{
+	u32  count = Pages(size);
+	u32  page  = (address - base) >> PAGE_SHIFT;
+	bool ret;
+
+	if (!count || !bitmap)
+		return true;
+
+	/* Check range */
+	if ((address & (PAGE_SIZE - 1)) || !Contains(address))
+		return false;
+
+	/* Clamp to the heap */
+	if (count > pages - page)
+		count = pages - page;
+
+	/* Drop region records */
+	ret = Remove(address, count);
+	if (!ret)
+		return false;
+
+	/* Release pages */
+	Mark(page, count, false);
+	Memory::Discard(address, count << PAGE_SHIFT);
+
+	return true;
+}
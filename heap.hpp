@@ -0,0 +1,88 @@
+/*
+ * ARM9 emulator - Guest heap
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HEAP_HPP__
+#define __HEAP_HPP__
+
+#include "types.h"
+
+/* Constants */
+#define HEAP_REGIONS	4096		// Region metadata slots
+#define HEAP_NONE	0xFFFFFFFF	// Invalid slot
+
+/* Region types */
+enum {
+	HEAP_BRK  = 1,
+	HEAP_MMAP = 2,
+};
+
+/* Region metadata */
+struct HeapRegion {
+	u32 address;
+	u32 pages;
+	u32 type;
+	u32 next;			// Next slot (by address or free)
+};
+
+
+/* Heap class */
+class Heap {
+	/* Reserved range */
+	u32 base;
+	u32 size;
+	u32 pages;
+
+	/* Page bitmap (1 = used) */
+	u32 *bitmap;
+
+	/* Region arena */
+	HeapRegion *arena;
+	u32 regions;			// First region by address
+	u32 slots;			// First free slot
+
+private:
+	/* Bitmap functions */
+	bool Used(u32 page);
+	void Mark(u32 page, u32 count, bool used);
+	bool Find(u32 count, u32 &page);
+
+	/* Region functions */
+	u32  Slot  (void);
+	bool Insert(u32 address, u32 count, u32 type);
+	bool Remove(u32 address, u32 count);
+
+public:
+	 Heap(void);
+	~Heap(void);
+
+	/* Create function */
+	bool Create(u32 base, u32 size);
+
+	/* Allocation functions */
+	u32  Alloc  (u32 size, u32 type);
+	bool AllocAt(u32 address, u32 size, u32 type);
+	bool Free   (u32 address, u32 size);
+
+	/* Range check */
+	inline bool Contains(u32 address) {
+		return (address - base) < size;
+	}
+};
+
+#endif /* __HEAP_HPP__ */
@@ -0,0 +1,175 @@
+/*
+ * ARM9 emulator - Host performance counters
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "hostperf.hpp"
+
+/*
+ * Each counter is opened on its own (user space only, this thread), so
+ * a PMU without an L1d event or a kernel that refuses some of them still
+ * reports the rest. When none can be opened only wall time is measured
+ * with clock_gettime, which is always there.
+ */
+
+
+/* Counter events */
+static const struct {
+	u32         type;
+	u64         config;
+	const char *name;
+} Events[HOST_COUNT] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,   "cycles"        },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions"  },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "branch misses" },
+	{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+			      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), "L1d misses" },
+};
+
+
+HostPerf::HostPerf(void)
+{
+	/* Clear state */
+	for (u32 i = 0; i < HOST_COUNT; i++) {
+		fd   [i] = -1;
+		value[i] = 0;
+	}
+
+	start   = 0;
+	elapsed = 0;
+	first   = 0;
+	count   = 0;
+}
+
+HostPerf::~HostPerf(void)
+{
+	/* Close counters */
+	Close();
+}
+
+u64 HostPerf::Now(void)
+{
+	struct timespec ts;
+
+	/* Monotonic time */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+bool HostPerf::Open(void)
+{
+	bool ret = false;
+
+	for (u32 i = 0; i < HOST_COUNT; i++) {
+		struct perf_event_attr attr;
+
+		/* Counter attributes */
+		memset(&attr, 0, sizeof(attr));
+
+		attr.size           = sizeof(attr);
+		attr.type           = Events[i].type;
+		attr.config         = Events[i].config;
+		attr.disabled       = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv     = 1;
+
+		/* Open counter (calling thread, any CPU) */
+		fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+
+		if (fd[i] >= 0)
+			ret = true;
+	}
+
+	return ret;
+}
+
+void HostPerf::Close(void)
+{
+	/* Close counters */
+	for (u32 i = 0; i < HOST_COUNT; i++) {
+		if (fd[i] >= 0)
+			close(fd[i]);
+
+		fd[i] = -1;
+	}
+}
+
+void HostPerf::Start(u64 icount)
+{
+	/* Reset and enable counters */
+	for (u32 i = 0; i < HOST_COUNT; i++) {
+		if (fd[i] < 0)
+			continue;
+
+		ioctl(fd[i], PERF_EVENT_IOC_RESET,  0);
+		ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	first = icount;
+	start = Now();
+}
+
+void HostPerf::Stop(u64 icount)
+{
+	/* Wall time */
+	elapsed = Now() - start;
+	count   = icount - first;
+
+	/* Disable and read counters */
+	for (u32 i = 0; i < HOST_COUNT; i++) {
+		if (fd[i] < 0)
+			continue;
+
+		ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+		if (read(fd[i], &value[i], sizeof(value[i])) != sizeof(value[i]))
+			value[i] = 0;
+	}
+}
+
+void HostPerf::Report(void)
+{
+	double secs = elapsed / 1e9;
+
+	printf("HOST PERFORMANCE:\n");
+	printf("=================\n");
+
+	/* Guest rate */
+	printf("%-14s %.3f s\n", "wall time", secs);
+	printf("%-14s %.2f MIPS (%llu instructions)\n", "guest", (secs > 0) ? count / secs / 1e6 : 0.0, count);
+
+	/* Host counters (per guest instruction) */
+	for (u32 i = 0; i < HOST_COUNT; i++) {
+		if (fd[i] < 0) {
+			printf("%-14s n/a\n", Events[i].name);
+			continue;
+		}
+
+		printf("%-14s %llu (%.2f per guest instruction)\n", Events[i].name,
+		       value[i], (count) ? (double)value[i] / count : 0.0);
+	}
+}
@@ -0,0 +1,70 @@
+/*
+ * ARM9 emulator - Host performance counters
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOSTPERF_HPP__
+#define __HOSTPERF_HPP__
+
+#include "types.h"
+
+/* Host counters */
+enum {
+	HOST_CYCLES   = 0,
+	HOST_INSTR    = 1,
+	HOST_BRMISSES = 2,
+	HOST_L1DMISS  = 3,
+	HOST_COUNT    = 4,
+};
+
+
+/* Host performance counters class */
+class HostPerf {
+	/* Counter descriptors (-1 if unavailable) */
+	s32 fd[HOST_COUNT];
+
+	/* Counter values */
+	u64 value[HOST_COUNT];
+
+	/* Wall time (nanoseconds) */
+	u64 start;
+	u64 elapsed;
+
+	/* Guest instructions at the start */
+	u64 first;
+	u64 count;
+
+private:
+	static u64 Now(void);
+
+public:
+	 HostPerf(void);
+	~HostPerf(void);
+
+	/* Open/Close functions */
+	bool Open (void);
+	void Close(void);
+
+	/* Measure functions (guest instruction counter) */
+	void Start(u64 icount);
+	void Stop (u64 icount);
+
+	/* Report function */
+	void Report(void);
+};
+
+#endif /* __HOSTPERF_HPP__ */
@@ -0,0 +1,129 @@
+/*
+ * ARM9 emulator - Interrupt controller
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "arm.hpp"
+#include "intc.hpp"
+#include "memory.hpp"
+
+/*
+ * The controller never interrupts the CPU directly: whenever its
+ * outputs change it raises or drops the IRQ/FIQ bits of the CPU
+ * attention word, which the engine looks at on block exits.
+ */
+
+
+Intc::Intc(ARM *cpu)
+{
+	/* Set parameters */
+	this->cpu = cpu;
+
+	/* Reset registers */
+	raw    = 0;
+	soft   = 0;
+	select = 0;
+	enable = 0;
+}
+
+void Intc::Update(void)
+{
+	u32 active = (raw | soft) & enable;
+
+	/* Drive CPU inputs */
+	cpu->Attention(ATTN_IRQ, (active & ~select) != 0);
+	cpu->Attention(ATTN_FIQ, (active &  select) != 0);
+}
+
+u32 Intc::Read(void *priv, u32 offset, u8 size)
+{
+	Intc *Dev = (Intc *)priv;
+
+	switch (offset) {
+	case INTC_IRQSTATUS:
+		return (Dev->raw | Dev->soft) & Dev->enable & ~Dev->select;
+
+	case INTC_FIQSTATUS:
+		return (Dev->raw | Dev->soft) & Dev->enable &  Dev->select;
+
+	case INTC_RAWINTR:
+		return Dev->raw | Dev->soft;
+
+	case INTC_INTSELECT:
+		return Dev->select;
+
+	case INTC_INTENABLE:
+		return Dev->enable;
+
+	case INTC_SOFTINT:
+		return Dev->soft;
+
+	default:
+		return 0;
+	}
+}
+
+void Intc::Write(void *priv, u32 offset, u32 value, u8 size)
+{
+	Intc *Dev = (Intc *)priv;
+
+	switch (offset) {
+	case INTC_INTSELECT:
+		Dev->select = value;
+		break;
+
+	case INTC_INTENABLE:
+		Dev->enable |= value;
+		break;
+
+	case INTC_INTENCLEAR:
+		Dev->enable &= ~value;
+		break;
+
+	case INTC_SOFTINT:
+		Dev->soft |= value;
+		break;
+
+	case INTC_SOFTINTCLEAR:
+		Dev->soft &= ~value;
+		break;
+
+	default:
+		return;
+	}
+
+	Dev->Update();
+}
+
+bool Intc::Attach(u32 base)
+{
+	/* Register device */
+	return Memory::Register(base, INTC_SIZE, Read, Write, this);
+}
+
+void Intc::Set(u32 line, bool level)
+{
+	u32 mask = 1U << (line % INTC_LINES);
+
+	/* Latch line level */
+	if (level)
+		raw |=  mask;
+	else
+		raw &= ~mask;
+
+	Update();
+}
@@ -0,0 +1,71 @@
+/*
+ * ARM9 emulator - Interrupt controller
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INTC_HPP__
+#define __INTC_HPP__
+
+#include "types.h"
+
+/* Constants */
+#define INTC_SIZE	0x1000		// Register window
+#define INTC_LINES	32
+
+/* Registers (PL190 subset) */
+enum {
+	INTC_IRQSTATUS    = 0x00,
+	INTC_FIQSTATUS    = 0x04,
+	INTC_RAWINTR      = 0x08,
+	INTC_INTSELECT    = 0x0C,
+	INTC_INTENABLE    = 0x10,
+	INTC_INTENCLEAR   = 0x14,
+	INTC_SOFTINT      = 0x18,
+	INTC_SOFTINTCLEAR = 0x1C,
+};
+
+/* Forward declarations */
+class ARM;
+
+
+/* Interrupt controller class */
+class Intc {
+	ARM *cpu;
+
+	/* Registers */
+	u32 raw;			// Device lines
+	u32 soft;			// Software interrupts
+	u32 select;			// 1 = FIQ
+	u32 enable;
+
+private:
+	static u32  Read (void *priv, u32 offset, u8 size);
+	static void Write(void *priv, u32 offset, u32 value, u8 size);
+
+	void Update(void);
+
+public:
+	Intc(ARM *cpu);
+
+	/* Attach function */
+	bool Attach(u32 base);
+
+	/* Line input (level sensitive) */
+	void Set(u32 line, bool level);
+};
+
+#endif /* __INTC_HPP__ */
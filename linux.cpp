@@ -0,0 +1,452 @@
+/*
+ * ARM9 emulator - Linux user-mode syscalls
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "arm.hpp"
+#include "endian.h"
+#include "linux.hpp"
+#include "memory.hpp"
+
+/*
+ * Guest buffers are resolved to host spans with Memory::Translate and
+ * handed to readv()/writev() directly, only path names are copied.
+ * Guest descriptors are host descriptors, except 1 and 2 which go
+ * through the CPU output writers and are never closed.
+ */
+
+/* Stack */
+#define STACK_SIZE	(1024 * 1024)
+#define STACK_TOP	0xFFFFFFF0
+
+/* Auxiliary vector */
+#define AT_NULL		0
+#define AT_PAGESZ	6
+
+/* ARM open() flags that differ from the host ones */
+#define ARM_O_DIRECTORY	0040000
+#define ARM_O_NOFOLLOW	0100000
+#define ARM_O_DIRECT	0200000
+#define ARM_O_LARGEFILE	0400000
+
+/* mmap() flags */
+#define ARM_MAP_FIXED	0x10
+#define ARM_MAP_ANON	0x20
+
+
+static inline u32 PageAlign(u32 value)
+{
+	return (value + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+}
+
+
+Linux::Linux(ARM *cpu)
+{
+	/* Set parameters */
+	this->cpu = cpu;
+
+	/* Clear state */
+	brkbase = brkcur = brktop = 0;
+}
+
+bool Linux::String(u32 address, char *buf, u32 size)
+{
+	/* Copy string */
+	for (u32 i = 0; i < size; i++) {
+		u32 len;
+		u8 *ptr;
+
+		ptr = Memory::Translate(address + i, 1, len, false);
+		if (!ptr)
+			return false;
+
+		buf[i] = *ptr;
+
+		if (!buf[i])
+			return true;
+	}
+
+	return false;
+}
+
+void Linux::Zero(u32 address, u32 size)
+{
+	struct iovec iov[LINUX_IOVS];
+	u32 cnt;
+
+	/* Clear guest range */
+	cnt = Memory::Spans(address, size, iov, LINUX_IOVS, true);
+
+	for (u32 i = 0; i < cnt; i++)
+		memset(iov[i].iov_base, 0, iov[i].iov_len);
+}
+
+s32 Linux::Read(u32 fd, u32 address, u32 size)
+{
+	struct iovec iov[LINUX_IOVS];
+
+	u32 cnt;
+	s32 ret;
+
+	/* Resolve guest buffer */
+	cnt = Memory::Spans(address, size, iov, LINUX_IOVS, true);
+	if (!cnt && size)
+		return -EFAULT;
+
+	/* Read into guest memory */
+	ret = readv(fd, iov, cnt);
+	if (ret < 0)
+		return -errno;
+
+	/* Log for replay */
+	cpu->SvcLog(address, iov, cnt, ret);
+
+	return ret;
+}
+
+s32 Linux::Write(u32 fd, u32 address, u32 size)
+{
+	struct iovec iov[LINUX_IOVS];
+
+	u32 cnt, total = 0;
+	s32 ret;
+
+	/* Resolve guest buffer */
+	cnt = Memory::Spans(address, size, iov, LINUX_IOVS, false);
+	if (!cnt && size)
+		return -EFAULT;
+
+	for (u32 i = 0; i < cnt; i++)
+		total += iov[i].iov_len;
+
+	/* Standard output/error */
+	if (fd == 1 || fd == 2) {
+		cpu->output[fd - 1]->Write(iov, cnt);
+		return total;
+	}
+
+	/* Write from guest memory */
+	ret = writev(fd, iov, cnt);
+	if (ret < 0)
+		return -errno;
+
+	return ret;
+}
+
+s32 Linux::Open(u32 path, u32 flags, u32 mode)
+{
+	char name[1024];
+	u32  hflags;
+	s32  ret;
+
+	/* Copy path */
+	if (!String(path, name, sizeof(name)))
+		return -EFAULT;
+
+	/* Translate flags */
+	hflags = flags & ~(ARM_O_DIRECTORY | ARM_O_NOFOLLOW | ARM_O_DIRECT | ARM_O_LARGEFILE);
+
+	if (flags & ARM_O_DIRECTORY)
+		hflags |= O_DIRECTORY;
+	if (flags & ARM_O_NOFOLLOW)
+		hflags |= O_NOFOLLOW;
+
+	/* Open file */
+	ret = open(name, hflags, mode);
+	if (ret < 0)
+		return -errno;
+
+	return ret;
+}
+
+s32 Linux::Close(u32 fd)
+{
+	/* Keep standard descriptors */
+	if (fd <= 2)
+		return 0;
+
+	/* Close file */
+	if (close(fd) < 0)
+		return -errno;
+
+	return 0;
+}
+
+s32 Linux::Lseek(u32 fd, s32 offset, u32 whence)
+{
+	off_t ret;
+
+	/* Seek file */
+	ret = lseek(fd, offset, whence);
+	if (ret < 0)
+		return -errno;
+
+	return ret;
+}
+
+u32 Linux::Brk(u32 address)
+{
+	/* Query */
+	if (address < brkbase)
+		return brkcur;
+
+	/* Grow mapping */
+	if (address > brktop) {
+		u32  size = PageAlign(address) - brktop;
+		bool ret;
+
+		ret = heap.AllocAt(brktop, size, HEAP_BRK);
+		if (!ret)
+			return brkcur;
+
+		brktop += size;
+	}
+
+	/* Shrink mapping */
+	if (PageAlign(address) < brktop) {
+		u32  top = PageAlign(address);
+		bool ret;
+
+		ret = heap.Free(top, brktop - top);
+		if (!ret)
+			return brkcur;
+
+		brktop = top;
+	}
+
+	/* Set break */
+	brkcur = address;
+
+	return brkcur;
+}
+
+s32 Linux::Mmap2(u32 address, u32 size, u32 prot, u32 flags, u32 fd, u32 pgoff)
+{
+	u32  len = PageAlign(size);
+	u32  vaddr;
+	bool ret;
+
+	if (!len)
+		return -EINVAL;
+
+	/* Create mapping */
+	if (!(flags & ARM_MAP_FIXED)) {
+		vaddr = heap.Alloc(len, HEAP_MMAP);
+		if (!vaddr)
+			return -ENOMEM;
+	} else if (heap.Contains(address)) {
+		vaddr = address;
+
+		/* Replace existing pages */
+		ret = heap.Free(vaddr, len) && heap.AllocAt(vaddr, len, HEAP_MMAP);
+		if (!ret)
+			return -ENOMEM;
+	} else {
+		vaddr = address;
+
+		if (vaddr & (PAGE_SIZE - 1))
+			return -EINVAL;
+
+		/* Replace the contents of a mapped range (spaces cannot be split) */
+		if (Memory::Overlaps(vaddr, len)) {
+			if (!Memory::Inside(vaddr, len))
+				return -EINVAL;
+		} else {
+			ret = Memory::Create(vaddr, len);
+			if (!ret)
+				return -ENOMEM;
+
+			maps[vaddr] = len;
+		}
+
+		Zero(vaddr, len);
+	}
+
+	/* Read file contents */
+	if (!(flags & ARM_MAP_ANON)) {
+		struct iovec iov[LINUX_IOVS];
+		u32 cnt;
+
+		cnt = Memory::Spans(vaddr, size, iov, LINUX_IOVS, true);
+
+		if (preadv(fd, iov, cnt, (off_t)pgoff * PAGE_SIZE) < 0) {
+			s32 err = -errno;
+
+			/* Undo the mapping */
+			if (heap.Contains(vaddr))
+				heap.Free(vaddr, len);
+			else if (maps.count(vaddr) && maps[vaddr] == len) {
+				Memory::Destroy(vaddr);
+				maps.erase(vaddr);
+			}
+
+			return err;
+		}
+	}
+
+	return vaddr;
+}
+
+s32 Linux::Munmap(u32 address, u32 size)
+{
+	map<u32, u32>::iterator it;
+
+	if (address & (PAGE_SIZE - 1))
+		return -EINVAL;
+
+	/* Release heap pages */
+	if (heap.Contains(address))
+		return (heap.Free(address, size)) ? 0 : -ENOMEM;
+
+	/* Whole fixed mappings only (not ELF segments or parts) */
+	it = maps.find(address);
+	if (it == maps.end() || it->second != PageAlign(size))
+		return -EINVAL;
+
+	/* Destroy mapping */
+	Memory::Destroy(address);
+	maps.erase(it);
+
+	return 0;
+}
+
+s32 Linux::Gettimeofday(u32 tv, u32 tz)
+{
+	struct timeval now;
+	u32 buf[2];
+
+	/* Get time */
+	gettimeofday(&now, NULL);
+
+	/* Time value */
+	if (tv) {
+		buf[0] = Swap32(now.tv_sec);
+		buf[1] = Swap32(now.tv_usec);
+
+		cpu->SvcStore(tv, buf, sizeof(buf));
+	}
+
+	/* Timezone (always UTC) */
+	if (tz) {
+		buf[0] = buf[1] = 0;
+
+		cpu->SvcStore(tz, buf, sizeof(buf));
+	}
+
+	return 0;
+}
+
+void Linux::Start(const char *name)
+{
+	u32 len = strlen(name) + 1;
+	u32 str, sp;
+
+	/* Initial frame: argc, argv, envp and auxv */
+	u32 frame[] = {
+		1, 0, 0,
+		0,
+		AT_PAGESZ, PAGE_SIZE,
+		AT_NULL,   0,
+	};
+
+	/* Reserve heap range, the program break grows from its bottom */
+	heap.Create(LINUX_HEAP, LINUX_HEAP_SIZE);
+
+	brkbase = brkcur = brktop = LINUX_HEAP;
+
+	/* Create stack (page aligned, so the page table covers it) */
+	Memory::Create(0x100000000ULL - STACK_SIZE, STACK_SIZE);
+
+	/* Program name */
+	str = (STACK_TOP - len) & ~3;
+	sp  = (str - sizeof(frame)) & ~7;
+
+	Memory::Memcpy(str, (void *)name, len);
+
+	/* Frame */
+	frame[1] = str;
+
+	for (u32 i = 0; i < sizeof(frame) / sizeof(*frame); i++)
+		Memory::Write32(sp + (i << 2), frame[i]);
+
+	/* Set stack pointer */
+	cpu->r[13] = sp;
+}
+
+void Linux::Call(u32 num)
+{
+	u32 *r = cpu->r;
+
+	/* Syscall number (EABI in r7, OABI in the immediate) */
+	u32 sys = (num) ? num - LINUX_OABI : r[7];
+
+	switch (sys) {
+	case SYS_EXIT:
+	case SYS_EXIT_GROUP:
+		/* Set finish flag */
+		cpu->finished = true;
+		break;
+
+	case SYS_READ:
+		r[0] = Read(r[0], r[1], r[2]);
+		break;
+
+	case SYS_WRITE:
+		r[0] = Write(r[0], r[1], r[2]);
+		break;
+
+	case SYS_OPEN:
+		r[0] = Open(r[0], r[1], r[2]);
+		break;
+
+	case SYS_CLOSE:
+		r[0] = Close(r[0]);
+		break;
+
+	case SYS_LSEEK:
+		r[0] = Lseek(r[0], r[1], r[2]);
+		break;
+
+	case SYS_BRK:
+		r[0] = Brk(r[0]);
+		break;
+
+	case SYS_GETTIMEOFDAY:
+		r[0] = Gettimeofday(r[0], r[1]);
+		break;
+
+	case SYS_MUNMAP:
+		r[0] = Munmap(r[0], r[1]);
+		break;
+
+	case SYS_MMAP2:
+		r[0] = Mmap2(r[0], r[1], r[2], r[3], r[4], r[5]);
+		break;
+
+	default:
+		printf("         [S] Unhandled syscall! (%02X)\n", sys);
+
+		r[0] = -ENOSYS;
+	}
+}
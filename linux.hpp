@@ -0,0 +1,96 @@
+/*
+ * ARM9 emulator - Linux user-mode syscalls
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LINUX_HPP__
+#define __LINUX_HPP__
+
+#include <map>
+
+#include "heap.hpp"
+#include "types.h"
+
+using namespace std;
+
+/* Constants */
+#define LINUX_OABI	0x900000	// OABI syscall base
+#define LINUX_HEAP	0x40000000	// Heap range (brk and mmap)
+#define LINUX_HEAP_SIZE	0x20000000
+#define LINUX_IOVS	16		// Max spans per transfer
+
+/* Syscall numbers */
+enum {
+	SYS_EXIT         = 1,
+	SYS_READ         = 3,
+	SYS_WRITE        = 4,
+	SYS_OPEN         = 5,
+	SYS_CLOSE        = 6,
+	SYS_LSEEK        = 19,
+	SYS_BRK          = 45,
+	SYS_GETTIMEOFDAY = 78,
+	SYS_MUNMAP       = 91,
+	SYS_MMAP2        = 192,
+	SYS_EXIT_GROUP   = 248,
+};
+
+/* Forward declarations */
+class ARM;
+
+
+/* Linux class */
+class Linux {
+	ARM *cpu;
+
+	/* Program break */
+	u32 brkbase;
+	u32 brkcur;
+	u32 brktop;
+
+	/* Guest heap */
+	Heap heap;
+
+	/* Fixed mappings outside the heap (address, length) */
+	map<u32, u32> maps;
+
+private:
+	/* Guest memory functions */
+	bool String(u32 address, char *buf, u32 size);
+	void Zero  (u32 address, u32 size);
+
+	/* Syscall functions */
+	s32 Read        (u32 fd, u32 address, u32 size);
+	s32 Write       (u32 fd, u32 address, u32 size);
+	s32 Open        (u32 path, u32 flags, u32 mode);
+	s32 Close       (u32 fd);
+	s32 Lseek       (u32 fd, s32 offset, u32 whence);
+	u32 Brk         (u32 address);
+	s32 Mmap2       (u32 address, u32 size, u32 prot, u32 flags, u32 fd, u32 pgoff);
+	s32 Munmap      (u32 address, u32 size);
+	s32 Gettimeofday(u32 tv, u32 tz);
+
+public:
+	Linux(ARM *cpu);
+
+	/* Setup function */
+	void Start(const char *name);
+
+	/* Syscall function */
+	void Call(u32 num);
+};
+
+#endif /* __LINUX_HPP__ */
@@ -0,0 +1,453 @@
+/*
+ * ARM9 emulator - Lockstep engine checker
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "arm.hpp"
+#include "cache.hpp"
+#include "callgraph.hpp"
+#include "disasm.hpp"
+#include "lockstep.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+/*
+ * Memory is global, so the checked engine runs in a forked copy of the
+ * process, started from the same loaded image. Both sides execute the
+ * same instructions and meet at every block exit (a non-sequential PC):
+ * the child sends its registers, cpsr and the writes of the block down
+ * a pipe and this side compares them with its own. Cycles are not
+ * compared, timing models may legitimately disagree.
+ */
+
+
+/* Engine names */
+static const char *Names[ENGINE_COUNT] = {
+	"interp", "trace", "stats", "calls", "cache"
+};
+
+/* CPSR Thumb bit */
+#define CPSR_T		(1 << 5)
+
+
+Lockstep::Lockstep(ARM *cpu)
+{
+	/* Set CPU */
+	this->cpu = cpu;
+
+	/* Clear state */
+	engine   = ENGINE_INTERP;
+	child    = -1;
+	master   = true;
+	fd       = -1;
+	start    = 0;
+	last     = 0;
+	blocks   = 0;
+	diverged = false;
+	prev     = NULL;
+	prevpriv = NULL;
+
+	/* No engine objects */
+	tracer = NULL;
+	mix    = NULL;
+	graph  = NULL;
+	model  = NULL;
+}
+
+Lockstep::~Lockstep(void)
+{
+	/* Close pipe */
+	if (fd >= 0)
+		close(fd);
+}
+
+s32 Lockstep::Engine(const char *name)
+{
+	/* Search engine */
+	for (u32 i = 0; i < ENGINE_COUNT; i++) {
+#ifndef __CACHE_MODEL__
+		if (i == ENGINE_CACHE)
+			continue;
+#endif
+		if (!strcmp(name, Names[i]))
+			return i;
+	}
+
+	return -1;
+}
+
+void Lockstep::Hook(void *priv, u32 address, u32 value, u8 flags)
+{
+	Lockstep *lock = (Lockstep *)priv;
+
+	/* Chained hook */
+	if (lock->prev)
+		lock->prev(lock->prevpriv, address, value, flags);
+
+	/* Log write */
+	if (flags & ACCESS_WRITE) {
+		LockWrite write;
+
+		write.address = address;
+		write.value   = value;
+		write.flags   = flags;
+
+		lock->Writes.push_back(write);
+	}
+}
+
+bool Lockstep::Send(s32 fd, const void *buf, u32 len)
+{
+	const u8 *ptr = (const u8 *)buf;
+
+	/* Write all */
+	while (len) {
+		ssize_t ret = write(fd, ptr, len);
+
+		if (ret <= 0)
+			return false;
+
+		ptr += ret;
+		len -= ret;
+	}
+
+	return true;
+}
+
+bool Lockstep::Receive(s32 fd, void *buf, u32 len)
+{
+	u8 *ptr = (u8 *)buf;
+
+	/* Read all */
+	while (len) {
+		ssize_t ret = read(fd, ptr, len);
+
+		if (ret <= 0)
+			return false;
+
+		ptr += ret;
+		len -= ret;
+	}
+
+	return true;
+}
+
+bool Lockstep::Setup(void)
+{
+	/* Drop the parent's instrumentation (its threads are gone) */
+	cpu->SetTrace(NULL);
+	cpu->SetMix(NULL);
+	cpu->SetCallGraph(NULL);
+	cpu->SetReplay(NULL);
+
+	Memory::SetHook(NULL, NULL);
+	Memory::SetDirtyHook(NULL, NULL);
+
+#ifdef __CACHE_MODEL__
+	cpu->SetModel(NULL);
+	Memory::SetModelHook(NULL, NULL);
+#endif
+
+	/* Nothing to print */
+	cpu->SetVerbose(false);
+
+	/* Start engine */
+	switch (engine) {
+	case ENGINE_TRACE:
+		tracer = new Trace;
+
+		if (!tracer->Open("/dev/null"))
+			return false;
+
+		cpu->SetTrace(tracer);
+		break;
+
+	case ENGINE_STATS:
+		mix = new InstrMix;
+		cpu->SetMix(mix);
+		break;
+
+	case ENGINE_CALLS:
+		graph = new CallGraph(cpu);
+		graph->Start();
+
+		cpu->SetCallGraph(graph);
+		break;
+
+#ifdef __CACHE_MODEL__
+	case ENGINE_CACHE:
+		model = new CacheModel(cpu);
+		model->Attach();
+		break;
+#endif
+	}
+
+	return true;
+}
+
+bool Lockstep::Start(const char *name)
+{
+	s32 fds[2];
+	s32 ret;
+
+	/* Find engine */
+	ret = Engine(name);
+	if (ret < 0)
+		return false;
+
+	engine = ret;
+
+	/* Create pipe */
+	ret = pipe(fds);
+	if (ret)
+		return false;
+
+	/* Flush output (or the child repeats it) */
+	cpu->Flush();
+	cout.flush();
+	fflush(NULL);
+
+	/* Fork checked engine */
+	child = fork();
+	if (child < 0) {
+		close(fds[0]);
+		close(fds[1]);
+
+		return false;
+	}
+
+	if (!child) {
+		s32 null;
+
+		/* Checked side */
+		master = false;
+		fd     = fds[1];
+
+		close(fds[0]);
+
+		/* Silence guest and host output */
+		null = open("/dev/null", O_WRONLY);
+		if (null >= 0) {
+			dup2(null, 1);
+			dup2(null, 2);
+			close(null);
+		}
+
+		/* Start engine */
+		if (!Setup())
+			_exit(1);
+	} else {
+		/* Comparing side */
+		fd = fds[0];
+
+		close(fds[1]);
+	}
+
+	/* Log writes (after the engine's own hook) */
+	Memory::GetHook(prev, prevpriv);
+	Memory::SetHook(Hook, this);
+
+	/* First block */
+	start = cpu->PeekReg(15) | ((cpu->PeekCPSR() & CPSR_T) ? 1 : 0);
+
+	return true;
+}
+
+void Lockstep::State(LockState &state, bool done)
+{
+	/* Clear (padding is compared) */
+	memset(&state, 0, sizeof(state));
+
+	state.icount  = cpu->Count();
+	state.start   = start;
+	state.last    = last;
+	state.cpsr    = cpu->PeekCPSR();
+	state.done    = done;
+	state.nwrites = Writes.size();
+
+	for (u32 i = 0; i < 16; i++)
+		state.regs[i] = cpu->PeekReg(i);
+}
+
+bool Lockstep::Sync(bool done)
+{
+	LockState state, other;
+	bool      ret;
+
+	/* Own state */
+	State(state, done);
+
+	if (!master) {
+		/* Send state and writes */
+		ret  = Send(fd, &state, sizeof(state));
+		ret &= Writes.empty() || Send(fd, &Writes[0], Writes.size() * sizeof(LockWrite));
+	} else {
+		/* Receive state and writes */
+		ret = Receive(fd, &other, sizeof(other));
+
+		if (ret) {
+			Other.resize(other.nwrites);
+
+			if (other.nwrites)
+				ret = Receive(fd, &Other[0], other.nwrites * sizeof(LockWrite));
+		}
+
+		if (!ret) {
+			cpu->Flush();
+
+			printf("LOCKSTEP: %s stopped responding after %llu instructions\n", Names[engine], state.icount);
+			diverged = true;
+
+			return false;
+		}
+
+		/* Compare */
+		if (memcmp(&state, &other, sizeof(state)) ||
+		    (state.nwrites && memcmp(&Writes[0], &Other[0], state.nwrites * sizeof(LockWrite)))) {
+			Report(state, other);
+			diverged = true;
+
+			return false;
+		}
+	}
+
+	/* Next block */
+	Writes.clear();
+	blocks++;
+
+	start = cpu->PeekReg(15) | ((cpu->PeekCPSR() & CPSR_T) ? 1 : 0);
+
+	return ret;
+}
+
+void Lockstep::Report(const LockState &mine, const LockState &other)
+{
+	u32 pc = mine.last & ~1;
+	u32 count;
+
+	/* Flush guest output */
+	cpu->Flush();
+	cout.flush();
+
+	printf("LOCKSTEP DIVERGENCE:\n");
+	printf("====================\n");
+	printf("%-14s %s, block %llu (0x%08X-0x%08X)\n", "engine", Names[engine], blocks, mine.start & ~1, pc);
+	printf("%-14s ", "instruction");
+
+	/* Last instruction of the block */
+	if (mine.last & 1)
+		Disasm::Thumb(stdout, pc, Memory::Fetch16(pc), Memory::Fetch16(pc + 2));
+	else
+		Disasm::Arm(stdout, pc, Memory::Fetch32(pc));
+
+	printf("\n%-14s %-12s %s\n", "", "this run", Names[engine]);
+
+	/* Differing state */
+	if (mine.icount != other.icount)
+		printf("%-14s %-12llu %llu\n", "instructions", mine.icount, other.icount);
+
+	if (mine.start != other.start)
+		printf("%-14s 0x%08X   0x%08X\n", "block start", mine.start, other.start);
+
+	if (mine.last != other.last)
+		printf("%-14s 0x%08X   0x%08X\n", "block end", mine.last, other.last);
+
+	for (u32 i = 0; i < 16; i++) {
+		if (mine.regs[i] != other.regs[i])
+			printf("r%-13u 0x%08X   0x%08X\n", i, mine.regs[i], other.regs[i]);
+	}
+
+	if (mine.cpsr != other.cpsr)
+		printf("%-14s 0x%08X   0x%08X\n", "cpsr", mine.cpsr, other.cpsr);
+
+	if (mine.done != other.done)
+		printf("%-14s %-12s %s\n", "stopped", mine.done ? "yes" : "no", other.done ? "yes" : "no");
+
+	if (mine.nwrites != other.nwrites)
+		printf("%-14s %-12u %u\n", "writes", mine.nwrites, other.nwrites);
+
+	/* First differing write */
+	count = (mine.nwrites < other.nwrites) ? mine.nwrites : other.nwrites;
+
+	for (u32 i = 0; i < count; i++) {
+		const LockWrite *a = &Writes[i];
+		const LockWrite *b = &Other[i];
+
+		if (memcmp(a, b, sizeof(*a))) {
+			printf("write %-8u [0x%08X]  [0x%08X]\n", i, a->address, b->address);
+			printf("%-14s 0x%08X   0x%08X (flags %02X/%02X)\n", "", a->value, b->value, a->flags, b->flags);
+			break;
+		}
+	}
+}
+
+bool Lockstep::Step(void)
+{
+	u32  pc    = cpu->PeekReg(15) & ~1;
+	u32  thumb = (cpu->PeekCPSR() & CPSR_T) ? 1 : 0;
+	bool ret;
+
+	/* Execute instruction */
+	ret = cpu->Step();
+	if (!ret)
+		return false;
+
+	last = pc | thumb;
+
+	/* Block exit */
+	if (cpu->Taken())
+		return Sync(false);
+
+	return true;
+}
+
+void Lockstep::Finish(void)
+{
+	/* Checked side: final state and exit */
+	if (!master) {
+		Sync(true);
+
+		if (tracer)
+			tracer->Close();
+
+		close(fd);
+		_exit(0);
+	}
+
+	/* Final state */
+	if (!diverged && Sync(true)) {
+		cpu->Flush();
+		printf("LOCKSTEP: %s matched over %llu blocks (%llu instructions)\n", Names[engine], blocks, cpu->Count());
+	}
+
+	/* Stop checked engine */
+	if (diverged)
+		kill(child, SIGKILL);
+
+	waitpid(child, NULL, 0);
+
+	close(fd);
+	fd = -1;
+}
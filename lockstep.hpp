@@ -0,0 +1,127 @@
+/*
+ * ARM9 emulator - Lockstep engine checker
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LOCKSTEP_HPP__
+#define __LOCKSTEP_HPP__
+
+#include <vector>
+#include <sys/types.h>
+#include "memory.hpp"
+#include "types.h"
+
+using namespace std;
+
+/* Engines */
+enum {
+	ENGINE_INTERP = 0,		// Plain interpreter
+	ENGINE_TRACE  = 1,		// Trace recording path
+	ENGINE_STATS  = 2,		// Instruction mix counting
+	ENGINE_CALLS  = 3,		// Call graph profiling
+	ENGINE_CACHE  = 4,		// Cache timing model
+	ENGINE_COUNT  = 5,
+};
+
+/* Block state (sent by the checked engine) */
+struct LockState {
+	u64 icount;
+	u32 start;			// First instruction (bit 0: Thumb)
+	u32 last;			// Last instruction  (bit 0: Thumb)
+	u32 regs[16];
+	u32 cpsr;
+	u32 done;			// Stopped
+	u32 nwrites;			// LockWrite entries that follow
+};
+
+/* Memory write */
+struct LockWrite {
+	u32 address;
+	u32 value;			// Size for block writes
+	u32 flags;			// ACCESS_* flags
+};
+
+/* Forward declarations */
+class ARM;
+class CacheModel;
+class CallGraph;
+class InstrMix;
+class Trace;
+
+
+/* Lockstep checker class */
+class Lockstep {
+	ARM *cpu;
+
+	/* Checked engine */
+	u32   engine;
+	pid_t child;
+	bool  master;			// Comparing (false in the child)
+	s32   fd;
+
+	/* Current block */
+	u32 start;
+	u32 last;
+	u64 blocks;
+	bool diverged;
+
+	/* Write log */
+	vector<LockWrite> Writes;
+	vector<LockWrite> Other;
+
+	/* Chained access hook */
+	MemHook prev;
+	void   *prevpriv;
+
+	/* Engine objects (child only) */
+	Trace      *tracer;
+	InstrMix   *mix;
+	CallGraph  *graph;
+	CacheModel *model;
+
+private:
+	static void Hook(void *priv, u32 address, u32 value, u8 flags);
+
+	static bool Send   (s32 fd, const void *buf, u32 len);
+	static bool Receive(s32 fd, void *buf, u32 len);
+
+	bool Setup  (void);
+	void State  (LockState &state, bool done);
+	bool Sync   (bool done);
+	void Report (const LockState &mine, const LockState &other);
+
+public:
+	 Lockstep(ARM *cpu);
+	~Lockstep(void);
+
+	/* Start function (forks the checked engine) */
+	bool Start(const char *name);
+
+	/* Execute functions */
+	bool Step  (void);
+	void Finish(void);
+
+	/* Divergence found */
+	inline bool Diverged(void) {
+		return diverged;
+	}
+
+	/* Engine name */
+	static s32 Engine(const char *name);
+};
+
+#endif /* __LOCKSTEP_HPP__ */
@@ -0,0 +1,199 @@
+/*
+ * ARM9 emulator - LZ block codec
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "lz.hpp"
+
+/*
+ * Sequences follow the LZ4 block layout: a token byte holding the
+ * literal count (high nibble) and match length minus LZ_MIN_MATCH
+ * (low nibble), extended with 255-runs when a nibble is saturated,
+ * followed by the literals and a little-endian 16-bit match offset.
+ * The last sequence carries literals only.
+ */
+
+
+static inline u32 Load32(const u8 *p)
+{
+	u32 value;
+
+	/* Unaligned load */
+	memcpy(&value, p, sizeof(value));
+
+	return value;
+}
+
+static inline u32 Hash(u32 value)
+{
+	return (value * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+
+u32 LZ::Emit(u8 *dst, u32 op, const u8 *lit, u32 nlit, u32 offset, u32 mlen)
+{
+	u32 mext = (mlen) ? (mlen - LZ_MIN_MATCH) : 0;
+	u8 *token = dst + op++;
+
+	/* Token */
+	*token  = ((nlit < 15) ? nlit : 15) << 4;
+	*token |=  (mext < 15) ? mext : 15;
+
+	/* Literal length */
+	if (nlit >= 15) {
+		u32 len = nlit - 15;
+
+		for (; len >= 255; len -= 255)
+			dst[op++] = 255;
+		dst[op++] = len;
+	}
+
+	/* Literals */
+	memcpy(dst + op, lit, nlit);
+	op += nlit;
+
+	/* Last sequence */
+	if (!mlen)
+		return op;
+
+	/* Match offset */
+	dst[op++] = offset & 0xFF;
+	dst[op++] = offset >> 8;
+
+	/* Match length */
+	if (mext >= 15) {
+		u32 len = mext - 15;
+
+		for (; len >= 255; len -= 255)
+			dst[op++] = 255;
+		dst[op++] = len;
+	}
+
+	return op;
+}
+
+u32 LZ::Compress(const u8 *src, u32 len, u8 *dst)
+{
+	u32 table[1 << LZ_HASH_BITS];
+	u32 ip = 0, anchor = 0, op = 0;
+
+	/* Clear hash table */
+	memset(table, 0, sizeof(table));
+
+	while (ip + LZ_MIN_MATCH <= len) {
+		u32 seq = Load32(src + ip);
+		u32 h   = Hash(seq);
+		u32 ref = table[h];
+
+		/* Update hash table (0 means empty) */
+		table[h] = ip + 1;
+
+		/* Check match */
+		if (ref && (ip - (ref - 1)) <= LZ_MAX_OFFSET && Load32(src + ref - 1) == seq) {
+			u32 mlen = LZ_MIN_MATCH;
+
+			ref--;
+
+			/* Extend match */
+			while (ip + mlen < len && src[ref + mlen] == src[ip + mlen])
+				mlen++;
+
+			/* Emit sequence */
+			op = Emit(dst, op, src + anchor, ip - anchor, ip - ref, mlen);
+
+			ip    += mlen;
+			anchor = ip;
+		} else
+			ip++;
+	}
+
+	/* Emit last literals */
+	return Emit(dst, op, src + anchor, len - anchor, 0, 0);
+}
+
+bool LZ::Decompress(const u8 *src, u32 len, u8 *dst, u32 size)
+{
+	u32 ip = 0, op = 0;
+
+	while (ip < len) {
+		u8  token = src[ip++];
+		u32 nlit  = token >> 4;
+		u32 mlen  = token & 0xF;
+		u32 offset;
+
+		/* Literal length */
+		if (nlit == 15) {
+			u8 b;
+
+			do {
+				if (ip >= len)
+					return false;
+
+				b     = src[ip++];
+				nlit += b;
+			} while (b == 255);
+		}
+
+		/* Literals */
+		if (ip + nlit > len || op + nlit > size)
+			return false;
+
+		memcpy(dst + op, src + ip, nlit);
+		ip += nlit;
+		op += nlit;
+
+		/* Last sequence */
+		if (ip == len)
+			break;
+
+		/* Match offset */
+		if (ip + 2 > len)
+			return false;
+
+		offset = src[ip] | (src[ip + 1] << 8);
+		ip    += 2;
+
+		if (!offset || offset > op)
+			return false;
+
+		/* Match length */
+		if (mlen == 15) {
+			u8 b;
+
+			do {
+				if (ip >= len)
+					return false;
+
+				b     = src[ip++];
+				mlen += b;
+			} while (b == 255);
+		}
+
+		mlen += LZ_MIN_MATCH;
+
+		if (op + mlen > size)
+			return false;
+
+		/* Copy match (may overlap) */
+		for (u32 i = 0; i < mlen; i++, op++)
+			dst[op] = dst[op - offset];
+	}
+
+	return (op == size);
+}
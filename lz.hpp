@@ -0,0 +1,44 @@
+/*
+ * ARM9 emulator - LZ block codec
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LZ_HPP__
+#define __LZ_HPP__
+
+#include "types.h"
+
+/* Constants */
+#define LZ_HASH_BITS	12
+#define LZ_MIN_MATCH	4
+#define LZ_MAX_OFFSET	0xFFFF
+
+/* Worst case compressed size */
+#define LZ_BOUND(x)	((x) + ((x) / 255) + 16)
+
+
+/* LZ class */
+class LZ {
+	static u32 Emit(u8 *dst, u32 op, const u8 *lit, u32 nlit, u32 offset, u32 mlen);
+
+public:
+	/* Block functions */
+	static u32  Compress  (const u8 *src, u32 len, u8 *dst);
+	static bool Decompress(const u8 *src, u32 len, u8 *dst, u32 size);
+};
+
+#endif /* __LZ_HPP__ */
@@ -18,37 +18,260 @@
  */
 
 #include <iostream>
+#include <cstring>
+#include <getopt.h>
 
 #include "arm.hpp"
+#include "cache.hpp"
+#include "callgraph.hpp"
+#include "gdb.hpp"
+#include "hostperf.hpp"
+#include "intc.hpp"
+#include "linux.hpp"
+#include "lockstep.hpp"
+#include "memmap.hpp"
 #include "memory.hpp"
+#include "perf.hpp"
+#include "profile.hpp"
+#include "replay.hpp"
+#include "stats.hpp"
+#include "symbols.hpp"
+#include "timer.hpp"
+#include "trace.hpp"
+#include "uart.hpp"
 #include "utils.hpp"
 
 /* Constants */
 #define STACK_SIZE	(8 * 1024)	// 8KB stack
 
 
+/* Command line options */
+static struct option Options[] = {
+	{ "abi",     required_argument, NULL, 'a' },
+	{ "cache",   no_argument,       NULL, 'c' },
+	{ "flush",   required_argument, NULL, 'f' },
+	{ "gdb",     required_argument, NULL, 'g' },
+	{ "hostperf", no_argument,       NULL, 'H' },
+	{ "calls",   required_argument, NULL, 'k' },
+	{ "lockstep", required_argument, NULL, 'l' },
+	{ "map",     required_argument, NULL, 'm' },
+	{ "profile", required_argument, NULL, 'p' },
+	{ "quiet",   no_argument,       NULL, 'q' },
+	{ "reverse", required_argument, NULL, 'r' },
+	{ "stats",   required_argument, NULL, 's' },
+	{ "trace",   required_argument, NULL, 't' },
+	{ NULL,      0,                 NULL,  0  }
+};
+
+
+static void Usage(const char *name)
+{
+	cerr << "[USAGE]: " << name << " [options] [b <binary file> | e <elf file>] <# of steps> (breakpoint)" << endl;
+	cerr << endl;
+	cerr << "Options:" << endl;
+	cerr << "  -a, --abi <abi>         Syscall interface: stub (default), linux (EABI/OABI)" << endl;
+	cerr << "                          or none (SWIs enter the guest SVC vector)" << endl;
+	cerr << "  -c, --cache             Simulate caches and TCMs, report hits and stalls (make CACHE=1)" << endl;
+	cerr << "  -f, --flush <policy>    Guest output flushing: full, line (default) or always" << endl;
+	cerr << "  -g, --gdb [host]:port   Serve the GDB remote protocol (no steps needed)" << endl;
+	cerr << "  -H, --hostperf          Measure host cycles per guest instruction and guest MIPS" << endl;
+	cerr << "  -k, --calls <file>      Profile guest calls and save callgrind output" << endl;
+	cerr << "  -l, --lockstep <engine> Run <engine> in a child and compare it after every block:" << endl;
+	cerr << "                          interp, trace, stats, calls or cache (make CACHE=1)" << endl;
+	cerr << "  -m, --map <file>        Load the memory map (RAM, ROM and MMIO regions)" << endl;
+	cerr << "  -p, --profile <file>    Sample the guest PC and save folded stacks (flamegraph)" << endl;
+	cerr << "  -q, --quiet             Do not print executed instructions" << endl;
+	cerr << "  -r, --reverse <n>       Step back <n> instructions after the run" << endl;
+	cerr << "  -s, --stats <file>      Count the instruction mix and save it as JSON" << endl;
+	cerr << "  -t, --trace <file>      Record a binary execution trace (implies --quiet)" << endl;
+}
+
 int main(int argc, char **argv)
 {
-	ARM Cpu;
+	ARM    Cpu;
+	Trace  Tracer;
+	Replay Checkpoints(&Cpu);
+	GDB    Stub(&Cpu, &Checkpoints);
+	Linux  Kernel(&Cpu);
+	MemoryMap Map;
+	Uart   Serial(Cpu.Output(0));
+	Timer  Ticker(&Cpu);
+	Intc   Vic(&Cpu);
+	Profiler Sampler(&Cpu);
+	CallGraph Graph(&Cpu);
+	InstrMix Mix;
+	HostPerf Host;
+	Lockstep Checker(&Cpu);
+#ifdef __CACHE_MODEL__
+	CacheModel Model(&Cpu);
+#endif
+
+	const char *tracefile = NULL;
+	const char *profile   = NULL;
+	const char *callfile  = NULL;
+	const char *statsfile = NULL;
+	const char *gdbaddr   = NULL;
+	const char *mapfile   = NULL;
+	const char *engine    = NULL;
+	bool        linux_abi = false;
+	bool        hostperf  = false;
+#ifdef __CACHE_MODEL__
+	bool        cache     = false;
+#endif
 
 	u32  entry;
 	s32  steps;
+	s32  reverse = -1;
 	bool ret;
 
+	/* Parse options */
+	for (;;) {
+		s32 opt = getopt_long(argc, argv, "a:cf:g:Hk:l:m:p:qr:s:t:", Options, NULL);
+
+		if (opt < 0)
+			break;
+
+		switch (opt) {
+		case 'a':
+			if (!strcmp(optarg, "linux"))
+				linux_abi = true;
+			else if (!strcmp(optarg, "none"))
+				Cpu.SetTrapSwi(true);
+			else if (strcmp(optarg, "stub")) {
+				Usage(argv[0]);
+				return 1;
+			}
+
+			break;
+
+		case 'c':
+#ifdef __CACHE_MODEL__
+			cache = true;
+			break;
+#else
+			cerr << "[ERROR]: Built without the cache model (make CACHE=1)!" << endl;
+			return 1;
+#endif
+
+		case 'f':
+			if (!strcmp(optarg, "full"))
+				Cpu.SetFlush(FLUSH_FULL);
+			else if (!strcmp(optarg, "line"))
+				Cpu.SetFlush(FLUSH_LINE);
+			else if (!strcmp(optarg, "always"))
+				Cpu.SetFlush(FLUSH_ALWAYS);
+			else {
+				Usage(argv[0]);
+				return 1;
+			}
+
+			break;
+
+		case 'g':
+			gdbaddr = optarg;
+			break;
+
+		case 'H':
+			hostperf = true;
+			break;
+
+		case 'k':
+			callfile = optarg;
+			break;
+
+		case 'l':
+			if (Lockstep::Engine(optarg) < 0) {
+				Usage(argv[0]);
+				return 1;
+			}
+
+			engine = optarg;
+			break;
+
+		case 'm':
+			mapfile = optarg;
+			break;
+
+		case 'p':
+			profile = optarg;
+			break;
+
+		case 'q':
+			Cpu.SetVerbose(false);
+			break;
+
+		case 'r':
+			reverse = Utils::StrToInt(optarg);
+			break;
+
+		case 's':
+			statsfile = optarg;
+			break;
+
+		case 't':
+			tracefile = optarg;
+			break;
+
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+
 	/* Show usage */
-	if (argc < 4) {
-		cerr << "[USAGE]: " << argv[0] << " [b <binary file> | e <elf file>] <# of steps> (breakpoint)" << endl;
+	if (argc - optind < (gdbaddr ? 2 : 3)) {
+		Usage(argv[0]);
+		return 1;
+	}
+
+	/* Lockstep runs need the step loop */
+	if (engine && gdbaddr) {
+		cerr << "[ERROR]: Lockstep checking does not work with the GDB stub!" << endl;
 		return 1;
 	}
 
+	/* Skip options */
+	argc -= optind;
+	argv += optind;
+
 	/* Read arguments */
-	steps = Utils::StrToInt(argv[3]);
+	steps = (argc > 2) ? Utils::StrToInt(argv[2]) : 0;
+
+	/* Install memory map */
+	if (mapfile) {
+		const MapRegion *region;
+
+		ret = Map.Load(mapfile);
+		if (!ret)
+			return 1;
+
+		/* Attach devices */
+		region = Map.Device("uart");
+		if (region)
+			Serial.Attach(region->base);
+
+		region = Map.Device("intc");
+		if (region)
+			Vic.Attach(region->base);
+
+		region = Map.Device("timer");
+		if (region) {
+			Ticker.Attach(region->base);
+
+			if (region->irq != ~0U)
+				Ticker.Connect(&Vic, region->irq);
+		}
+
+		region = Map.Device("perf");
+		if (region)
+			Cpu.Counters()->Attach(region->base);
+	}
 
 	/* Check mode */
-	switch (argv[1][0]) {
+	switch (argv[0][0]) {
 	case 'b':
 		/* Load binary */
-		ret = Memory::LoadBinary(argv[2], entry);
+		ret = Memory::LoadBinary(argv[1], entry);
 		if (!ret) {
 			cerr << "[ERROR]: Could not load the binary file!" << endl;
 			return 1;
@@ -58,7 +281,7 @@ int main(int argc, char **argv)
 
 	case 'e':
 		/* Load ELF */
-		ret = Memory::LoadELF(argv[2], entry);
+		ret = Memory::LoadELF(argv[1], entry);
 		if (!ret) {
 			cerr << "[ERROR]: Could not load the ELF file!" << endl;
 			return 1;
@@ -71,23 +294,180 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
-	if (argc >= 4) {
-		s32 address = Utils::HexToInt(argv[4]);
+	/* Write protect ROM */
+	Map.Protect();
+
+	if (argc > 3) {
+		s32 address = Utils::HexToInt(argv[3]);
 
 		/* Add breakpoint */
 		Cpu.BreakAdd(address);
 	}
 
+	/* Open trace */
+	if (tracefile) {
+		ret = Tracer.Open(tracefile);
+		if (!ret) {
+			cerr << "[ERROR]: Could not open the trace file!" << endl;
+			return 1;
+		}
+
+		Cpu.SetVerbose(false);
+		Cpu.SetTrace(&Tracer);
+	}
+
+	/* Linux process setup */
+	if (linux_abi) {
+		Kernel.Start(argv[1]);
+		Cpu.SetKernel(&Kernel);
+	}
+
 	/* Create stack */
 	Memory::Create(0xFFFFFFFF - STACK_SIZE, STACK_SIZE);
 
 	/* Set program counter */
 	Cpu.SetPC(entry);
 
-	/* Step CPU */
-	while (steps-- && Cpu.Step());
+#ifdef __CACHE_MODEL__
+	/* Start timing model */
+	if (cache)
+		Model.Attach();
+#endif
+
+	/* Start checkpoints */
+	if (reverse >= 0 || gdbaddr)
+		Checkpoints.Start();
+
+	/* Start call graph */
+	if (callfile) {
+		Graph.Start();
+		Cpu.SetCallGraph(&Graph);
+	}
+
+	/* Count instruction mix */
+	if (statsfile)
+		Cpu.SetMix(&Mix);
+
+	/* Fork checked engine */
+	if (engine) {
+		ret = Checker.Start(engine);
+		if (!ret) {
+			cerr << "[ERROR]: Could not start the lockstep engine!" << endl;
+			return 1;
+		}
+	}
+
+	/* Start profiler */
+	if (profile) {
+		ret = Sampler.Start();
+		if (!ret) {
+			cerr << "[ERROR]: Could not start the profiler!" << endl;
+			return 1;
+		}
+	}
+
+	/* Start host counters (wall time only if unavailable) */
+	if (hostperf) {
+		Host.Open();
+		Host.Start(Cpu.Count());
+	}
+
+	/* Debug session */
+	if (gdbaddr) {
+		ret = Stub.Listen(gdbaddr);
+		if (!ret) {
+			cerr << "[ERROR]: Could not start the GDB stub!" << endl;
+			return 1;
+		}
+
+		Cpu.SetVerbose(false);
+		Stub.Serve();
+	} else if (engine) {
+		/* Step CPU against the checked engine */
+		while (steps-- && Checker.Step());
+
+		Checker.Finish();
+	} else {
+		/* Step CPU */
+		while (steps-- && Cpu.Step());
+	}
+
+	/* Stop profiler */
+	Sampler.Stop();
+
+	/* Stop host counters */
+	if (hostperf)
+		Host.Stop(Cpu.Count());
+
+	/* Flush guest output */
+	Cpu.Flush();
+
 	cout << endl;
 
+	/* Step back */
+	if (reverse >= 0) {
+		u64 count = Cpu.Count();
+		u64 back  = ((u64)reverse < count) ? reverse : count;
+
+		Checkpoints.Seek(count - back);
+
+		cout << "REVERSE: instruction " << dec << Cpu.Count() << " (" << Checkpoints.Checkpoints()
+		     << " checkpoints, interval " << Checkpoints.Interval() << ")" << endl << endl;
+	}
+
+	/* Close trace */
+	if (tracefile) {
+		Tracer.Close();
+
+		cout << "TRACE: " << dec << Tracer.Records() << " records, "
+		     << Tracer.Stalls() << " stalls" << endl << endl;
+	}
+
+	/* Save profile */
+	if (profile) {
+		ret = Sampler.Save(profile);
+		if (!ret)
+			cerr << "[ERROR]: Could not save the profile!" << endl;
+
+		cout << "PROFILE: " << dec << Sampler.Total() << " samples, "
+		     << Sampler.Addresses() << " addresses" << endl << endl;
+	}
+
+	/* Save call graph */
+	if (callfile) {
+		ret = Graph.Save(callfile);
+		if (!ret)
+			cerr << "[ERROR]: Could not save the call graph!" << endl;
+	}
+
+	/* Save statistics */
+	if (statsfile) {
+		ret = Mix.Save(statsfile);
+		if (!ret)
+			cerr << "[ERROR]: Could not save the statistics!" << endl;
+	}
+
+#ifdef __CACHE_MODEL__
+	/* Cache report */
+	if (cache) {
+		Model.Report();
+		cout << endl;
+	}
+#endif
+
+	/* Host performance */
+	if (hostperf) {
+		Host.Report();
+		cout << endl;
+	}
+
+	/* Stop location */
+	if (!Symbols::Empty())
+		cout << "STOPPED: " << Symbols::Format(Cpu.PeekReg(15)) << endl << endl;
+
+	/* Cycle count */
+	cout << "CYCLES: " << dec << Cpu.Cycles() << " (" << Cpu.Count() << " instructions)" << endl << endl;
+
 	/* Dump registers */
 	Cpu.DumpRegs();
 	cout << endl;
@@ -98,5 +478,5 @@ int main(int argc, char **argv)
 	/* Destroy virtual memory */
 	Memory::Destroy();
 
-	return 0;
+	return (engine && Checker.Diverged()) ? 1 : 0;
 }
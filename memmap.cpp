@@ -0,0 +1,443 @@
+/*
+ * ARM9 emulator - Memory map
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "intc.hpp"
+#include "memmap.hpp"
+#include "memory.hpp"
+
+/*
+ * Map files are INI-style, one section per region:
+ *
+ *   ; ARM946E-S tightly coupled memories
+ *   [itcm]
+ *   type    = ram               ; ram, rom or mmio
+ *   base    = 0x00000000
+ *   size    = 32K               ; K, M and G suffixes
+ *   fill    = 0x00              ; initial byte (default 0xFF)
+ *
+ *   [bios]
+ *   type    = rom
+ *   base    = 0xFFFF0000
+ *   size    = 64K
+ *   backing = file:bios.bin     ; anon (default), file:<path> or shm:<name>
+ *
+ *   [serial]
+ *   type    = mmio
+ *   base    = 0x10000000
+ *   size    = 4K
+ *   device  = uart              ; uart, timer, intc or perf
+ *
+ *   [ticker]
+ *   type    = mmio
+ *   base    = 0x10001000
+ *   size    = 4K
+ *   device  = timer
+ *   irq     = 1                 ; interrupt controller line (timer only)
+ *
+ * Regions must be page aligned and must not overlap. Each one becomes
+ * a VSpace over a host mapping, so they are installed in the page table
+ * like any other space. ROM pages are write protected once the program
+ * has been loaded, MMIO pages are handed to the named device.
+ */
+
+
+/* Known devices */
+static const struct {
+	const char *name;
+	bool        irq;		// Has an interrupt output
+} Devices[] = {
+	{ "uart",  false },
+	{ "intc",  false },
+	{ "timer", true  },
+	{ "perf",  false },
+};
+
+
+static inline s32 DeviceFind(const string &name)
+{
+	/* Search device */
+	for (u32 i = 0; i < sizeof(Devices) / sizeof(*Devices); i++) {
+		if (name == Devices[i].name)
+			return i;
+	}
+
+	return -1;
+}
+
+static inline string Trim(const string &str)
+{
+	size_t first = str.find_first_not_of(" \t\r\n");
+	size_t last  = str.find_last_not_of (" \t\r\n");
+
+	if (first == string::npos)
+		return "";
+
+	return str.substr(first, last - first + 1);
+}
+
+
+bool MemoryMap::Error(const char *msg)
+{
+	/* Print error */
+	cerr << "[ERROR]: " << filename << ":" << dec << line << ": " << msg << endl;
+
+	return false;
+}
+
+bool MemoryMap::Value(const string &str, u32 &value)
+{
+	unsigned long long res;
+	char *end;
+
+	/* Parse number */
+	res = strtoull(str.c_str(), &end, 0);
+	if (end == str.c_str())
+		return false;
+
+	/* Size suffix */
+	switch (*end) {
+	case 'K': case 'k':
+		res <<= 10, end++;
+		break;
+	case 'M': case 'm':
+		res <<= 20, end++;
+		break;
+	case 'G': case 'g':
+		res <<= 30, end++;
+		break;
+	}
+
+	if (*end || res > 0xFFFFFFFFULL)
+		return false;
+
+	value = res;
+
+	return true;
+}
+
+bool MemoryMap::Set(MapRegion &region, const string &key, const string &value)
+{
+	u32 num;
+
+	/* Region type */
+	if (key == "type") {
+		if (value == "ram")
+			region.type = REGION_RAM;
+		else if (value == "rom")
+			region.type = REGION_ROM;
+		else if (value == "mmio")
+			region.type = REGION_MMIO;
+		else
+			return Error("Invalid region type!");
+
+		return true;
+	}
+
+	/* Region backing */
+	if (key == "backing") {
+		if (value == "anon")
+			region.backing = BACKING_ANON;
+		else if (!value.compare(0, 5, "file:")) {
+			region.backing = BACKING_FILE;
+			region.path    = value.substr(5);
+		} else if (!value.compare(0, 4, "shm:")) {
+			region.backing = BACKING_SHM;
+			region.path    = value.substr(4);
+		} else
+			return Error("Invalid region backing!");
+
+		return true;
+	}
+
+	/* Device name */
+	if (key == "device") {
+		if (DeviceFind(value) < 0)
+			return Error("Unknown device!");
+
+		region.device = value;
+		return true;
+	}
+
+	/* Numeric values */
+	if (!Value(value, num))
+		return Error("Invalid number!");
+
+	if (key == "base")
+		region.base = num;
+	else if (key == "size")
+		region.size = num;
+	else if (key == "fill" && num < 0x100)
+		region.fill = num;
+	else if (key == "irq" && num < INTC_LINES)
+		region.irq = num;
+	else
+		return Error("Invalid key!");
+
+	return true;
+}
+
+bool MemoryMap::Check(const MapRegion &region)
+{
+	vector<MapRegion>::iterator it;
+
+	/* Alignment */
+	if (!region.size || ((region.base | region.size) & (PAGE_SIZE - 1)))
+		return Error("Region is not page aligned!");
+
+	/* Wrap around */
+	if (region.base + region.size - 1 < region.base)
+		return Error("Region wraps around!");
+
+	/* Backing path */
+	if (region.backing != BACKING_ANON && region.path.empty())
+		return Error("Missing backing name!");
+
+	/* Device regions */
+	if (!region.device.empty() && region.type != REGION_MMIO)
+		return Error("Devices need an MMIO region!");
+
+	if (region.irq != ~0U && region.device.empty())
+		return Error("Interrupt line without a device!");
+
+	if (region.irq != ~0U && !Devices[DeviceFind(region.device)].irq)
+		return Error("Device cannot raise interrupts!");
+
+	/* Overlaps */
+	for (it = Regions.begin(); it < Regions.end(); it++) {
+		if (region.base - it->base < it->size || it->base - region.base < region.size)
+			return Error("Region overlaps another one!");
+	}
+
+	return true;
+}
+
+u8 *MemoryMap::Backing(const MapRegion &region)
+{
+	struct stat st;
+
+	u8 *buffer;
+	s32 fd;
+
+	/* Shared memory object */
+	if (region.backing == BACKING_SHM) {
+		fd = shm_open(region.path.c_str(), O_RDWR | O_CREAT, 0600);
+		if (fd < 0)
+			return NULL;
+
+		fstat(fd, &st);
+
+		/* Grow object */
+		if ((u64)st.st_size < region.size && ftruncate(fd, region.size) < 0) {
+			close(fd);
+			return NULL;
+		}
+
+		buffer = (u8 *)mmap(NULL, region.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (buffer == MAP_FAILED)
+			return NULL;
+
+		/* Fill new object */
+		if (!st.st_size)
+			memset(buffer, region.fill, region.size);
+
+		return buffer;
+	}
+
+	/* Anonymous memory */
+	buffer = (u8 *)mmap(NULL, region.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (buffer == MAP_FAILED)
+		return NULL;
+
+	if (region.fill)
+		memset(buffer, region.fill, region.size);
+
+	/* File contents over the start */
+	if (region.backing == BACKING_FILE) {
+		u32  len, pages;
+		s32  flags = (region.type == REGION_ROM) ? MAP_PRIVATE : MAP_SHARED;
+		void *ptr;
+
+		fd = open(region.path.c_str(), (region.type == REGION_ROM) ? O_RDONLY : O_RDWR);
+		if (fd < 0 || fstat(fd, &st) < 0) {
+			if (fd >= 0)
+				close(fd);
+
+			munmap(buffer, region.size);
+			return NULL;
+		}
+
+		len   = ((u64)st.st_size < region.size) ? st.st_size : region.size;
+		pages = (len + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+		if (len) {
+			ptr = mmap(buffer, pages, PROT_READ | PROT_WRITE, flags | MAP_FIXED, fd, 0);
+
+			if (ptr == MAP_FAILED) {
+				close(fd);
+				munmap(buffer, region.size);
+
+				return NULL;
+			}
+
+			/* Past the end of file */
+			memset(buffer + len, region.fill, pages - len);
+		}
+
+		close(fd);
+	}
+
+	return buffer;
+}
+
+bool MemoryMap::Load(const char *filename)
+{
+	vector<MapRegion>::iterator it;
+	ifstream File;
+	string   str;
+
+	MapRegion region;
+	bool      section = false;
+
+	/* Set parameters */
+	this->filename = filename;
+	this->line     = 0;
+
+	/* Open file */
+	File.open(filename);
+
+	if (!File.is_open())
+		return Error("Could not open the memory map!");
+
+	/* Parse lines */
+	while (getline(File, str)) {
+		size_t pos;
+
+		line++;
+
+		/* Strip comments */
+		pos = str.find_first_of(";#");
+		if (pos != string::npos)
+			str.erase(pos);
+
+		str = Trim(str);
+		if (str.empty())
+			continue;
+
+		/* Section header */
+		if (str[0] == '[') {
+			if (str[str.size() - 1] != ']')
+				return Error("Invalid section header!");
+
+			/* Finish previous region */
+			if (section) {
+				if (!Check(region))
+					return false;
+
+				Regions.push_back(region);
+			}
+
+			/* Defaults */
+			region.name    = Trim(str.substr(1, str.size() - 2));
+			region.type    = REGION_RAM;
+			region.base    = 0;
+			region.size    = 0;
+			region.fill    = 0xFF;
+			region.backing = BACKING_ANON;
+			region.path.clear();
+			region.device.clear();
+			region.irq     = ~0U;
+
+			section = true;
+			continue;
+		}
+
+		/* Key/value pair */
+		pos = str.find('=');
+		if (pos == string::npos || !section)
+			return Error("Expected a section or a key = value pair!");
+
+		if (!Set(region, Trim(str.substr(0, pos)), Trim(str.substr(pos + 1))))
+			return false;
+	}
+
+	/* Finish last region */
+	if (section) {
+		if (!Check(region))
+			return false;
+
+		Regions.push_back(region);
+	}
+
+	File.close();
+
+	/* Install regions */
+	for (it = Regions.begin(); it < Regions.end(); it++) {
+		u8 *buffer;
+
+		buffer = Backing(*it);
+		if (!buffer) {
+			cerr << "[ERROR]: Could not map region \"" << it->name << "\"!" << endl;
+			return false;
+		}
+
+		if (!Memory::Attach(it->base, it->size, buffer)) {
+			munmap(buffer, it->size);
+
+			cerr << "[ERROR]: Could not install region \"" << it->name << "\"!" << endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MemoryMap::Protect(void)
+{
+	vector<MapRegion>::iterator it;
+
+	/* Write protect ROM regions */
+	for (it = Regions.begin(); it < Regions.end(); it++) {
+		if (it->type == REGION_ROM)
+			Memory::Mark(it->base, it->size, PAGE_ROM);
+	}
+}
+
+const MapRegion *MemoryMap::Device(const char *name)
+{
+	vector<MapRegion>::iterator it;
+
+	/* Find device region */
+	for (it = Regions.begin(); it < Regions.end(); it++) {
+		if (it->type == REGION_MMIO && it->device == name)
+			return &*it;
+	}
+
+	return NULL;
+}
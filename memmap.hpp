@@ -0,0 +1,88 @@
+/*
+ * ARM9 emulator - Memory map
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MEMMAP_HPP__
+#define __MEMMAP_HPP__
+
+#include <string>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+/* Region types */
+enum {
+	REGION_RAM  = 0,
+	REGION_ROM  = 1,
+	REGION_MMIO = 2,
+};
+
+/* Region backings */
+enum {
+	BACKING_ANON = 0,
+	BACKING_FILE = 1,
+	BACKING_SHM  = 2,
+};
+
+/* Region description */
+struct MapRegion {
+	string name;
+	u32    type;
+	u32    base;
+	u32    size;
+	u8     fill;
+	u32    backing;
+	string path;			// File or shared memory name
+	string device;			// Device behind an MMIO region
+	u32    irq;			// Interrupt line (~0 if none)
+};
+
+
+/* Memory map class */
+class MemoryMap {
+	/* Regions */
+	vector<MapRegion> Regions;
+
+	/* Parser state */
+	const char *filename;
+	u32         line;
+
+private:
+	bool Error(const char *msg);
+	bool Value(const string &str, u32 &value);
+	bool Set  (MapRegion &region, const string &key, const string &value);
+	bool Check(const MapRegion &region);
+
+	u8  *Backing(const MapRegion &region);
+
+public:
+	/* Load function */
+	bool Load(const char *filename);
+
+	/* Apply region protections (after loading the program) */
+	void Protect(void);
+
+	/* Find the MMIO region of a device */
+	const MapRegion *Device(const char *name);
+
+	/* Region access */
+	inline const vector<MapRegion> &List(void) { return Regions; }
+};
+
+#endif /* __MEMMAP_HPP__ */
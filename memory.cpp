@@ -21,9 +21,11 @@
 #include <fstream>
 #include <cstring>
 #include <elf.h>
+#include <sys/mman.h>
 
 #include "endian.h"
 #include "memory.hpp"
+#include "symbols.hpp"
 #include "utils.hpp"
 
 
@@ -31,25 +33,66 @@
  * Virtual space class
  */
 
-VSpace::VSpace(u32 address, u32 size)
+VSpace::VSpace(u32 address, u32 size, bool anon)
 {
 	/* Allocate buffer */
-	buffer = new u8[size];
+	if (anon) {
+		/* Zero-filled, committed on first touch */
+		buffer = (u8 *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+		if (buffer == MAP_FAILED)
+			buffer = NULL;
+	} else {
+		buffer = new u8[size];
+
+		/* Initialize buffer */
+		if (buffer)
+			memset(buffer, 0xFF, size);
+	}
+
+	/* Set parameters */
+	this->vaddr  = address;
+	this->size   = size;
+	this->mapped = anon;
+	this->owned  = true;
+
+	/* Allocate page flags */
+	pages = (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	flags = new u8[pages];
 
-	/* Initialize buffer */
-	if (buffer)
-		memset(buffer, 0xFF, size);
+	memset(flags, 0, pages);
+}
+
+VSpace::VSpace(u32 address, u32 size, u8 *buffer, bool owned)
+{
+	/* Adopt (or borrow) host mapping */
+	this->buffer = buffer;
 
 	/* Set parameters */
-	this->vaddr = address;
-	this->size  = size;
+	this->vaddr  = address;
+	this->size   = size;
+	this->mapped = true;
+	this->owned  = owned;
+
+	/* Allocate page flags */
+	pages = (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	flags = new u8[pages];
+
+	memset(flags, 0, pages);
 }
 
 VSpace::~VSpace(void)
 {
 	/* Free buffer */
-	if (buffer)
-		delete[] buffer;
+	if (buffer && owned) {
+		if (mapped)
+			munmap(buffer, size);
+		else
+			delete[] buffer;
+	}
+
+	/* Free page flags */
+	delete[] flags;
 }
 
 u8 VSpace::Read8(u32 address)
@@ -120,19 +163,59 @@ void VSpace::Memcpy(void *dst, u32 src, u32 size)
 	memcpy(dst, buffer + idx, size);
 }
 
+void VSpace::Discard(u32 address, u32 size)
+{
+	u32 idx = (address - vaddr);
+
+	/* Drop host pages (read back as zero) */
+	if (mapped)
+		madvise(buffer + idx, size, MADV_DONTNEED);
+}
+
 
 /*
  * Memory class
  */
 
 vector<VSpace *> Memory::Spaces;
+VSpace          *Memory::Table[PAGE_COUNT];
+vector<Device>   Memory::Devices;
+
+MemHook Memory::Hook     = NULL;
+void   *Memory::HookPriv = NULL;
+
+PageHook Memory::Dirty     = NULL;
+void    *Memory::DirtyPriv = NULL;
+
+vector<u8 *> Memory::Dirtied;
+u8           Memory::Tracked = 0;
+
+MemHook Memory::Watch     = NULL;
+void   *Memory::WatchPriv = NULL;
+
+const u8 *Memory::Perm      = NULL;
+u8        Memory::PermShift = 0;
+
+MemHook Memory::Fault     = NULL;
+void   *Memory::FaultPriv = NULL;
+
+#ifdef __CACHE_MODEL__
+MemHook Memory::Model     = NULL;
+void   *Memory::ModelPriv = NULL;
+#endif
 
 
 VSpace * Memory::Find(u32 address)
 {
 	vector<VSpace *>::iterator it;
+	VSpace *Space;
 
-	/* Find virtual space */
+	/* Page table */
+	Space = Table[address >> PAGE_SHIFT];
+	if (Space)
+		return Space;
+
+	/* Partially covered pages */
 	for (it = Spaces.begin(); it < Spaces.end(); it++) {
 		VSpace *space = *it;
 
@@ -146,7 +229,180 @@ VSpace * Memory::Find(u32 address)
 	return NULL;
 }
 
-bool Memory::Create(u32 vaddr, u32 size)
+void Memory::Map(VSpace *Space, bool shadow)
+{
+	u64 first = ((u64)Space->vaddr + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	u64 last  = ((u64)Space->vaddr + Space->size)   >> PAGE_SHIFT;
+
+	/* Fill pages fully inside the space (older spaces win) */
+	for (u64 i = first; i < last; i++) {
+		if (!Table[i] || shadow)
+			Table[i] = Space;
+	}
+
+	/* Inherit the current instrumentation */
+	Instrument(Space);
+}
+
+void Memory::Unmap(VSpace *Space)
+{
+	vector<VSpace *>::iterator it;
+
+	u64 first = (u64)Space->vaddr >> PAGE_SHIFT;
+	u64 last  = ((u64)Space->vaddr + Space->size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+
+	/* Clear pages */
+	for (u64 i = first; i < last; i++) {
+		if (Table[i] == Space)
+			Table[i] = NULL;
+	}
+
+	/* Forget its dirty pages */
+	for (u32 i = 0; i < Dirtied.size(); ) {
+		if (Dirtied[i] >= Space->flags && Dirtied[i] < Space->flags + Space->pages)
+			Dirtied.erase(Dirtied.begin() + i);
+		else
+			i++;
+	}
+
+	/* Let overlapped spaces take them back */
+	for (it = Spaces.begin(); it < Spaces.end(); it++) {
+		if (*it != Space)
+			Map(*it);
+	}
+}
+
+void Memory::Instrument(VSpace *Space)
+{
+	bool slow = Hook || Perm;
+
+#ifdef __CACHE_MODEL__
+	slow = slow || Model;
+#endif
+
+	/* Route every page through the slow path (or release them) */
+	for (u32 i = 0; i < Space->pages; i++) {
+		if (slow)
+			Space->flags[i] |=  PAGE_SLOW;
+		else
+			Space->flags[i] &= ~PAGE_SLOW;
+	}
+}
+
+void Memory::Refresh(void)
+{
+	vector<VSpace *>::iterator it;
+
+	/* Update all spaces */
+	for (it = Spaces.begin(); it < Spaces.end(); it++)
+		Instrument(*it);
+}
+
+void Memory::Touch(VSpace *Space, u32 address, u32 size)
+{
+	u32 first = (address - Space->vaddr) >> PAGE_SHIFT;
+	u32 last  = (address - Space->vaddr + size - 1) >> PAGE_SHIFT;
+
+	/* Clamp to the space */
+	if (last >= Space->pages)
+		last = Space->pages - 1;
+
+	/* Mark pages */
+	for (u32 i = first; i <= last; i++) {
+		u32 offset = i << PAGE_SHIFT;
+		u32 len    = Space->size - offset;
+
+		if (Space->flags[i] & PAGE_DIRTY)
+			continue;
+
+		Space->flags[i] |= PAGE_DIRTY;
+		Dirtied.push_back(&Space->flags[i]);
+
+		/* Notify first write */
+		Dirty(DirtyPriv, Space->vaddr + offset, (len < PAGE_SIZE) ? len : PAGE_SIZE);
+	}
+}
+
+bool Memory::Watched(VSpace *Space, u32 address, u32 size)
+{
+	u32 first = (address - Space->vaddr) >> PAGE_SHIFT;
+	u32 last  = (address - Space->vaddr + size - 1) >> PAGE_SHIFT;
+
+	/* Clamp to the space */
+	if (last >= Space->pages)
+		last = Space->pages - 1;
+
+	/* Check pages */
+	for (u32 i = first; i <= last; i++) {
+		if (Space->flags[i] & PAGE_WATCH)
+			return (Watch != NULL);
+	}
+
+	return false;
+}
+
+u32 Memory::Direct(VSpace *Space, u32 address, u32 size, u8 mask)
+{
+	u32 first = (address - Space->vaddr) >> PAGE_SHIFT;
+	u32 last  = (address - Space->vaddr + size - 1) >> PAGE_SHIFT;
+
+	/* Clamp to the space */
+	if (last >= Space->pages)
+		last = Space->pages - 1;
+
+	/* Stop at the first special page */
+	for (u32 i = first; i <= last; i++) {
+		if (Space->flags[i] & mask) {
+			u32 offset = Space->vaddr + (i << PAGE_SHIFT);
+
+			return (offset > address) ? offset - address : 0;
+		}
+	}
+
+	return size;
+}
+
+u32 Memory::IoRead(u32 address, u8 size)
+{
+	vector<Device>::iterator it;
+
+	/* Find device */
+	for (it = Devices.begin(); it < Devices.end(); it++) {
+		if (address - it->base < it->size)
+			return (it->read) ? it->read(it->priv, address - it->base, size) : 0;
+	}
+
+	return 0;
+}
+
+bool Memory::IoWrite(u32 address, u32 value, u8 size)
+{
+	vector<Device>::iterator it;
+
+	/* Find device */
+	for (it = Devices.begin(); it < Devices.end(); it++) {
+		if (address - it->base < it->size) {
+			if (it->write)
+				it->write(it->priv, address - it->base, value, size);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+u32 Memory::Abort(u32 address, u8 flags)
+{
+	/* Notify fault */
+	if (Fault)
+		Fault(FaultPriv, address, 0, flags);
+
+	/* Aborted loads read zero */
+	return 0;
+}
+
+bool Memory::Create(u32 vaddr, u32 size, bool anon)
 {
 	VSpace *Space;
 
@@ -156,12 +412,33 @@ bool Memory::Create(u32 vaddr, u32 size)
 		return true;
 
 	/* Create virtual space */
-	Space = new VSpace(vaddr, size);
+	Space = new VSpace(vaddr, size, anon);
 	if (!Space)
 		return false;
 
 	/* Push virtual space */
 	Spaces.push_back(Space);
+	Map(Space);
+
+	return true;
+}
+
+bool Memory::Attach(u32 vaddr, u32 size, u8 *buffer)
+{
+	VSpace *Space;
+
+	/* Already mapped */
+	if (Find(vaddr))
+		return false;
+
+	/* Create virtual space */
+	Space = new VSpace(vaddr, size, buffer);
+	if (!Space)
+		return false;
+
+	/* Push virtual space */
+	Spaces.push_back(Space);
+	Map(Space);
 
 	return true;
 }
@@ -176,6 +453,8 @@ void Memory::Destroy(void)
 		space = Spaces.back();
 		Spaces.pop_back();
 
+		Unmap(space);
+
 		/* Delete it */
 		delete space;
 	}
@@ -192,6 +471,8 @@ void Memory::Destroy(u32 vaddr)
 		/* Delete if found */
 		if (space->vaddr == vaddr) {
 			Spaces.erase(it);
+			Unmap(space);
+
 			delete space;
 
 			break;
@@ -199,6 +480,128 @@ void Memory::Destroy(u32 vaddr)
 	}
 }
 
+VSpace *Memory::Overlay(u32 vaddr, u32 size, u8 *buffer)
+{
+	VSpace *Space;
+
+	/* Create virtual space */
+	Space = new VSpace(vaddr, size, buffer, false);
+	if (!Space)
+		return NULL;
+
+	/* Searched first, takes over the page table */
+	Spaces.insert(Spaces.begin(), Space);
+	Map(Space, true);
+
+	return Space;
+}
+
+void Memory::Remove(VSpace *Space)
+{
+	vector<VSpace *>::iterator it;
+
+	/* Find virtual space */
+	for (it = Spaces.begin(); it < Spaces.end(); it++) {
+		if (*it == Space) {
+			Spaces.erase(it);
+			Unmap(Space);
+
+			delete Space;
+
+			break;
+		}
+	}
+}
+
+void Memory::Discard(u32 address, u32 size)
+{
+	VSpace *Space;
+
+	/* Find virtual space */
+	Space = Find(address);
+	if (!Space || address - Space->vaddr + size > Space->size)
+		return;
+
+	/* Keep the old contents for rewinding */
+	if (Dirty && size)
+		Touch(Space, address, size);
+
+	/* Release pages */
+	Space->Discard(address, size);
+}
+
+bool Memory::Register(u32 base, u32 size, DevRead read, DevWrite write, void *priv)
+{
+	Device dev;
+	bool   ret;
+
+	/* Back the range if unmapped */
+	if (!Find(base)) {
+		ret = Create(base, size);
+		if (!ret)
+			return false;
+	}
+
+	/* Add device */
+	dev.base  = base;
+	dev.size  = size;
+	dev.read  = read;
+	dev.write = write;
+	dev.priv  = priv;
+
+	Devices.push_back(dev);
+
+	/* Route its pages through the slow path */
+	Mark(base, size, PAGE_IO);
+
+	return true;
+}
+
+bool Memory::Inside(u32 address, u32 size)
+{
+	VSpace *Space;
+
+	/* Find virtual space */
+	Space = Find(address);
+	if (!Space)
+		return false;
+
+	/* Range ends inside it */
+	return (address - Space->vaddr + (u64)size <= Space->size);
+}
+
+bool Memory::Overlaps(u32 address, u32 size)
+{
+	vector<VSpace *>::iterator it;
+
+	/* Check every space */
+	for (it = Spaces.begin(); it < Spaces.end(); it++) {
+		VSpace *space = *it;
+
+		if ((u64)space->vaddr < (u64)address + size &&
+		    (u64)address < (u64)space->vaddr + space->size)
+			return true;
+	}
+
+	return false;
+}
+
+u32 Memory::End(void)
+{
+	vector<VSpace *>::iterator it;
+	u32 end = 0;
+
+	/* Find highest space */
+	for (it = Spaces.begin(); it < Spaces.end(); it++) {
+		VSpace *space = *it;
+
+		if (space->vaddr + space->size > end)
+			end = space->vaddr + space->size;
+	}
+
+	return end;
+}
+
 bool Memory::LoadBinary(const char *filename, u32 &entry)
 {
 	char *buffer;
@@ -209,11 +612,23 @@ bool Memory::LoadBinary(const char *filename, u32 &entry)
 	if (!buffer)
 		return false;
 
-	/* Create virtual space */
-	Create(0, size);
+	/* Copy binary (into mapped regions if any) */
+	for (u32 i = 0; i < size; ) {
+		u32 len;
+		u8 *ptr;
 
-	/* Copy binary */
-	Memcpy(0, buffer, size);
+		ptr = Translate(i, size - i, len, true);
+		if (!ptr) {
+			/* Create virtual space */
+			if (Find(i) || !Create(i, size - i))
+				break;
+
+			continue;
+		}
+
+		memcpy(ptr, buffer + i, len);
+		i += len;
+	}
 
 	/* Set entry point */
 	entry = 0;
@@ -231,8 +646,8 @@ bool Memory::LoadELF(const char *filename, u32 &entry)
 
 	ifstream File;
 
-	u32  phoff;
-	u16  phnum, shnum;
+	u32  phoff, shoff;
+	u16  phnum, shnum, shstrndx;
 	bool ret;
 
 	/* Open file */
@@ -249,9 +664,12 @@ bool Memory::LoadELF(const char *filename, u32 &entry)
 	/* Header parameters */
 	phnum = Swap16(ehdr.e_phnum);
 	phoff = Swap32(ehdr.e_phoff);
+	shoff = Swap32(ehdr.e_shoff);
 	shnum = Swap16(ehdr.e_shnum);
 	entry = Swap32(ehdr.e_entry);
 
+	shstrndx = Swap16(ehdr.e_shstrndx);
+
 	printf("Entry point: 0x%08X\n", entry);
 
 	/* Allocate array */
@@ -300,10 +718,26 @@ bool Memory::LoadELF(const char *filename, u32 &entry)
 				Write32(vaddr + j, Swap32(value));
 			}
 		}
+
+		/* Clear BSS */
+		for (u32 j = filesz; j < memsz; ) {
+			u32 len;
+			u8 *ptr;
+
+			ptr = Translate(vaddr + j, memsz - j, len, true);
+			if (!ptr)
+				break;
+
+			memset(ptr, 0, len);
+			j += len;
+		}
 	}
 
 	printf("\n");
 
+	/* Symbols and lines (optional) */
+	Symbols::Load(File, shoff, shnum, shstrndx);
+
 out:
 	/* Free array */
 	delete[] phdr;
@@ -314,9 +748,242 @@ out:
 	return ret;
 }
 
+void Memory::SetHook(MemHook hook, void *priv)
+{
+	/* Set access hook */
+	Hook     = hook;
+	HookPriv = priv;
+
+	/* Update the fast path */
+	Refresh();
+}
+
+void Memory::GetHook(MemHook &hook, void *&priv)
+{
+	/* Get access hook (for chaining) */
+	hook = Hook;
+	priv = HookPriv;
+}
+
+void Memory::SetDirtyHook(PageHook hook, void *priv)
+{
+	/* Set dirty page hook */
+	Dirty     = hook;
+	DirtyPriv = priv;
+
+	/* Clean pages take the slow path while tracking */
+	Tracked = (hook) ? PAGE_DIRTY : 0;
+}
+
+void Memory::Clean(void)
+{
+	/* Clear dirty flags (only pages written since the last clean) */
+	for (u32 i = 0; i < Dirtied.size(); i++)
+		*Dirtied[i] &= ~PAGE_DIRTY;
+
+	Dirtied.clear();
+}
+
+void Memory::SetWatchHook(MemHook hook, void *priv)
+{
+	/* Set watchpoint hook */
+	Watch     = hook;
+	WatchPriv = priv;
+}
+
+void Memory::SetFaultHook(MemHook hook, void *priv)
+{
+	/* Set fault hook */
+	Fault     = hook;
+	FaultPriv = priv;
+}
+
+#ifdef __CACHE_MODEL__
+void Memory::SetModelHook(MemHook hook, void *priv)
+{
+	/* Set timing model hook */
+	Model     = hook;
+	ModelPriv = priv;
+
+	/* Update the fast path */
+	Refresh();
+}
+#endif
+
+void Memory::SetPermissions(const u8 *perm)
+{
+	/* Set page permissions */
+	Perm = perm;
+
+	/* Update the fast path */
+	Refresh();
+}
+
+void Memory::SetUser(bool user)
+{
+	/* Select permission bits */
+	PermShift = (user) ? PERM_USER : 0;
+}
+
+u8 Memory::Flags(u32 address)
+{
+	VSpace *Space;
+
+	/* Find virtual space */
+	Space = Find(address);
+	if (!Space)
+		return 0;
+
+	/* Return page flags */
+	return Space->flags[(address - Space->vaddr) >> PAGE_SHIFT];
+}
+
+void Memory::Mark(u32 address, u32 size, u8 flag)
+{
+	VSpace *Space;
+	u32     first, last;
+
+	/* Find virtual space */
+	Space = Find(address);
+	if (!Space || !size)
+		return;
+
+	first = (address - Space->vaddr) >> PAGE_SHIFT;
+	last  = (address - Space->vaddr + size - 1) >> PAGE_SHIFT;
+
+	/* Set flag */
+	for (u32 i = first; i <= last && i < Space->pages; i++)
+		Space->flags[i] |= flag;
+}
+
+void Memory::Unmark(u32 address, u32 size, u8 flag)
+{
+	VSpace *Space;
+	u32     first, last;
+
+	/* Find virtual space */
+	Space = Find(address);
+	if (!Space || !size)
+		return;
+
+	first = (address - Space->vaddr) >> PAGE_SHIFT;
+	last  = (address - Space->vaddr + size - 1) >> PAGE_SHIFT;
+
+	/* Clear flag */
+	for (u32 i = first; i <= last && i < Space->pages; i++)
+		Space->flags[i] &= ~flag;
+}
+
+void Memory::Save(u32 address, void *buf, u32 size)
+{
+	VSpace *Space;
+
+	/* Find virtual space */
+	Space = Find(address);
+	if (!Space)
+		return;
+
+	/* Copy data */
+	Space->Memcpy(buf, address, size);
+}
+
+void Memory::Restore(u32 address, const void *buf, u32 size)
+{
+	VSpace *Space;
+
+	/* Find virtual space */
+	Space = Find(address);
+	if (!Space)
+		return;
+
+	/* Copy data */
+	Space->Memcpy(address, (void *)buf, size);
+}
+
+bool Memory::Peek8(u32 address, u8 &value)
+{
+	VSpace *Space;
+
+	/* Find virtual space */
+	Space = Find(address);
+	if (!Space)
+		return false;
+
+	/* Never touch devices */
+	if (Space->Flags(address) & PAGE_IO)
+		return false;
+
+	/* Read byte */
+	value = Space->Read8(address);
+
+	return true;
+}
+
+bool Memory::Poke8(u32 address, u8 value)
+{
+	VSpace *Space;
+
+	/* Find virtual space */
+	Space = Find(address);
+	if (!Space)
+		return false;
+
+	/* Never touch devices */
+	if (Space->Flags(address) & PAGE_IO)
+		return false;
+
+	/* Track dirty pages */
+	if (Dirty)
+		Touch(Space, address, 1);
+
+	/* Write byte (ROM included) */
+	Space->Write8(address, value);
+
+	return true;
+}
+
+u16 Memory::Fetch16(u32 address)
+{
+	VSpace *Space;
+
+	/* Find virtual space */
+	Space = Find(address);
+	if (!Space)
+		return -1;
+
+	/* Read half-word */
+	return Space->Read16(address);
+}
+
+u32 Memory::Fetch32(u32 address)
+{
+	VSpace *Space;
+
+	/* Find virtual space */
+	Space = Find(address);
+	if (!Space)
+		return -1;
+
+	/* Read word */
+	return Space->Read32(address);
+}
+
 u8 Memory::Read8(u32 address)
 {
 	VSpace *Space;
+	u8 value;
+
+	/* Fast path (plain memory, no instrumentation) */
+	Space = Table[address >> PAGE_SHIFT];
+	if (Space && !(Space->Flags(address) & PAGE_READ_SLOW))
+		return Space->Read8(address);
+
+	/* Protection unit */
+	if (!Allowed(address, PERM_READ))
+		return Abort(address, 1);
+
+	/* Timing model */
+	Account(address, 1);
 
 	/* Find virtual space */
 	Space = Find(address);
@@ -324,12 +991,38 @@ u8 Memory::Read8(u32 address)
 		return -1;
 
 	/* Read byte */
-	return Space->Read8(address);
+	if (Space->Flags(address) & PAGE_IO)
+		value = IoRead(address, 1);
+	else
+		value = Space->Read8(address);
+
+	/* Call hook */
+	if (Hook)
+		Hook(HookPriv, address, value, 1);
+
+	/* Check watchpoints */
+	if (Watched(Space, address, 1))
+		Watch(WatchPriv, address, value, 1);
+
+	return value;
 }
 
 u16 Memory::Read16(u32 address)
 {
 	VSpace *Space;
+	u16 value;
+
+	/* Fast path (plain memory, no instrumentation) */
+	Space = Table[address >> PAGE_SHIFT];
+	if (Space && !(Space->Flags(address) & PAGE_READ_SLOW))
+		return Space->Read16(address);
+
+	/* Protection unit */
+	if (!Allowed(address, PERM_READ))
+		return Abort(address, 2);
+
+	/* Timing model */
+	Account(address, 2);
 
 	/* Find virtual space */
 	Space = Find(address);
@@ -337,12 +1030,38 @@ u16 Memory::Read16(u32 address)
 		return -1;
 
 	/* Read half-word */
-	return Space->Read16(address);
+	if (Space->Flags(address) & PAGE_IO)
+		value = IoRead(address, 2);
+	else
+		value = Space->Read16(address);
+
+	/* Call hook */
+	if (Hook)
+		Hook(HookPriv, address, value, 2);
+
+	/* Check watchpoints */
+	if (Watched(Space, address, 2))
+		Watch(WatchPriv, address, value, 2);
+
+	return value;
 }
 
 u32 Memory::Read32(u32 address)
 {
 	VSpace *Space;
+	u32 value;
+
+	/* Fast path (plain memory, no instrumentation) */
+	Space = Table[address >> PAGE_SHIFT];
+	if (Space && !(Space->Flags(address) & PAGE_READ_SLOW))
+		return Space->Read32(address);
+
+	/* Protection unit */
+	if (!Allowed(address, PERM_READ))
+		return Abort(address, 4);
+
+	/* Timing model */
+	Account(address, 4);
 
 	/* Find virtual space */
 	Space = Find(address);
@@ -350,46 +1069,161 @@ u32 Memory::Read32(u32 address)
 		return -1;
 
 	/* Read word */
-	return Space->Read32(address);
+	if (Space->Flags(address) & PAGE_IO)
+		value = IoRead(address, 4);
+	else
+		value = Space->Read32(address);
+
+	/* Call hook */
+	if (Hook)
+		Hook(HookPriv, address, value, 4);
+
+	/* Check watchpoints */
+	if (Watched(Space, address, 4))
+		Watch(WatchPriv, address, value, 4);
+
+	return value;
 }
 
 void Memory::Write8(u32 address, u8 value)
 {
 	VSpace *Space;
 
+	/* Fast path (plain memory, no instrumentation) */
+	Space = Table[address >> PAGE_SHIFT];
+	if (Space && (Space->Flags(address) & PAGE_WRITE_SLOW) == Tracked) {
+		Space->Write8(address, value);
+		return;
+	}
+
+	/* Protection unit */
+	if (!Allowed(address, PERM_WRITE)) {
+		Abort(address, ACCESS_WRITE | 1);
+		return;
+	}
+
+	/* Timing model */
+	Account(address, ACCESS_WRITE | 1);
+
 	/* Find virtual space */
 	Space = Find(address);
 	if (!Space)
 		return;
 
-	/* Write byte */
-	Space->Write8(address, value);
+	/* Device or read-only page */
+	if (Space->Flags(address) & (PAGE_ROM | PAGE_IO)) {
+		if (!IoWrite(address, value, 1))
+			return;
+	} else {
+		/* Track dirty pages */
+		if (Dirty)
+			Touch(Space, address, 1);
+
+		/* Write byte */
+		Space->Write8(address, value);
+	}
+
+	/* Call hook */
+	if (Hook)
+		Hook(HookPriv, address, value, ACCESS_WRITE | 1);
+
+	/* Check watchpoints */
+	if (Watched(Space, address, 1))
+		Watch(WatchPriv, address, value, ACCESS_WRITE | 1);
 }
 
 void Memory::Write16(u32 address, u16 value)
 {
 	VSpace *Space;
 
+	/* Fast path (plain memory, no instrumentation) */
+	Space = Table[address >> PAGE_SHIFT];
+	if (Space && (Space->Flags(address) & PAGE_WRITE_SLOW) == Tracked) {
+		Space->Write16(address, value);
+		return;
+	}
+
+	/* Protection unit */
+	if (!Allowed(address, PERM_WRITE)) {
+		Abort(address, ACCESS_WRITE | 2);
+		return;
+	}
+
+	/* Timing model */
+	Account(address, ACCESS_WRITE | 2);
+
 	/* Find virtual space */
 	Space = Find(address);
 	if (!Space)
 		return;
 
-	/* Write half-word */
-	Space->Write16(address, value);
+	/* Device or read-only page */
+	if (Space->Flags(address) & (PAGE_ROM | PAGE_IO)) {
+		if (!IoWrite(address, value, 2))
+			return;
+	} else {
+		/* Track dirty pages */
+		if (Dirty)
+			Touch(Space, address, 2);
+
+		/* Write half-word */
+		Space->Write16(address, value);
+	}
+
+	/* Call hook */
+	if (Hook)
+		Hook(HookPriv, address, value, ACCESS_WRITE | 2);
+
+	/* Check watchpoints */
+	if (Watched(Space, address, 2))
+		Watch(WatchPriv, address, value, ACCESS_WRITE | 2);
 }
 
 void Memory::Write32(u32 address, u32 value)
 {
 	VSpace *Space;
 
+	/* Fast path (plain memory, no instrumentation) */
+	Space = Table[address >> PAGE_SHIFT];
+	if (Space && (Space->Flags(address) & PAGE_WRITE_SLOW) == Tracked) {
+		Space->Write32(address, value);
+		return;
+	}
+
+	/* Protection unit */
+	if (!Allowed(address, PERM_WRITE)) {
+		Abort(address, ACCESS_WRITE | 4);
+		return;
+	}
+
+	/* Timing model */
+	Account(address, ACCESS_WRITE | 4);
+
 	/* Find virtual space */
 	Space = Find(address);
 	if (!Space)
 		return;
 
-	/* Write word */
-	Space->Write32(address, value);
+	/* Device or read-only page */
+	if (Space->Flags(address) & (PAGE_ROM | PAGE_IO)) {
+		if (!IoWrite(address, value, 4))
+			return;
+	} else {
+		/* Track dirty pages */
+		if (Dirty)
+			Touch(Space, address, 4);
+
+		/* Write word */
+		Space->Write32(address, value);
+	}
+
+	/* Call hook */
+	if (Hook)
+		Hook(HookPriv, address, value, ACCESS_WRITE | 4);
+
+	/* Check watchpoints */
+	if (Watched(Space, address, 4))
+		Watch(WatchPriv, address, value, ACCESS_WRITE | 4);
 }
 
 void Memory::Memcpy(u32 dst, void *src, u32 size)
@@ -401,8 +1235,24 @@ void Memory::Memcpy(u32 dst, void *src, u32 size)
 	if (!Space)
 		return;
 
+	/* Skip device and read-only pages */
+	if (size)
+		size = Direct(Space, dst, size, PAGE_ROM | PAGE_IO);
+
+	/* Track dirty pages */
+	if (Dirty && size)
+		Touch(Space, dst, size);
+
 	/* Copy data */
 	Space->Memcpy(dst, src, size);
+
+	/* Call hook */
+	if (Hook)
+		Hook(HookPriv, dst, size, ACCESS_WRITE | ACCESS_BLOCK);
+
+	/* Check watchpoints */
+	if (size && Watched(Space, dst, size))
+		Watch(WatchPriv, dst, size, ACCESS_WRITE | ACCESS_BLOCK);
 }
 
 void Memory::Memcpy(void *dst, u32 src, u32 size)
@@ -414,6 +1264,79 @@ void Memory::Memcpy(void *dst, u32 src, u32 size)
 	if (!Space)
 		return;
 
+	/* Skip device pages */
+	if (size)
+		size = Direct(Space, src, size, PAGE_IO);
+
 	/* Copy data */
 	Space->Memcpy(dst, src, size);
+
+	/* Call hook */
+	if (Hook)
+		Hook(HookPriv, src, size, ACCESS_BLOCK);
+
+	/* Check watchpoints */
+	if (size && Watched(Space, src, size))
+		Watch(WatchPriv, src, size, ACCESS_BLOCK);
+}
+
+u8 *Memory::Translate(u32 address, u32 size, u32 &len, bool write)
+{
+	VSpace *Space;
+	u8      flags = (write) ? (ACCESS_WRITE | ACCESS_BLOCK) : ACCESS_BLOCK;
+
+	/* Find virtual space */
+	Space = Find(address);
+	if (!Space)
+		return NULL;
+
+	/* Contiguous span */
+	len = Space->vaddr + Space->size - address;
+	if (len > size)
+		len = size;
+
+	/* Device and read-only pages */
+	if (len) {
+		len = Direct(Space, address, len, (write) ? (PAGE_ROM | PAGE_IO) : PAGE_IO);
+		if (!len)
+			return NULL;
+	}
+
+	/* Track dirty pages */
+	if (write && Dirty && len)
+		Touch(Space, address, len);
+
+	/* Call hook */
+	if (Hook)
+		Hook(HookPriv, address, len, flags);
+
+	/* Check watchpoints */
+	if (len && Watched(Space, address, len))
+		Watch(WatchPriv, address, len, flags);
+
+	/* Return host pointer */
+	return Space->Pointer(address);
+}
+
+u32 Memory::Spans(u32 address, u32 size, struct iovec *iov, u32 max, bool write)
+{
+	u32 cnt;
+
+	/* Resolve guest range into host spans */
+	for (cnt = 0; size && cnt < max; cnt++) {
+		u32 len;
+		u8 *ptr;
+
+		ptr = Translate(address, size, len, write);
+		if (!ptr)
+			break;
+
+		iov[cnt].iov_base = ptr;
+		iov[cnt].iov_len  = len;
+
+		address += len;
+		size    -= len;
+	}
+
+	return cnt;
 }
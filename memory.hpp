@@ -21,23 +21,85 @@
 #define __MEMORY_HPP__
 
 #include <vector>
+#include <sys/uio.h>
 #include "types.h"
 
 using namespace std;
 
 
+/* Access flags */
+enum {
+	ACCESS_SIZE  = 0x07,
+	ACCESS_WRITE = 0x08,
+	ACCESS_BLOCK = 0x10,
+};
+
+/* Page constants */
+#define PAGE_SHIFT	12
+#define PAGE_SIZE	(1 << PAGE_SHIFT)
+#define PAGE_COUNT	(1 << (32 - PAGE_SHIFT))
+
+/* Page flags */
+enum {
+	PAGE_DIRTY = 1 << 0,
+	PAGE_BREAK = 1 << 1,		// Page holds a breakpoint
+	PAGE_WATCH = 1 << 2,		// Page holds a watchpoint
+	PAGE_ROM   = 1 << 3,		// Writes are ignored
+	PAGE_IO    = 1 << 4,		// Device registers
+	PAGE_SLOW  = 1 << 5,		// Instrumented (access hook, MPU, timing model)
+};
+
+/* Page flags that force the slow access path */
+#define PAGE_READ_SLOW	(PAGE_SLOW | PAGE_WATCH | PAGE_IO)
+#define PAGE_WRITE_SLOW	(PAGE_READ_SLOW | PAGE_ROM | PAGE_DIRTY)
+
+/* Page permissions (privileged bits, user bits above) */
+enum {
+	PERM_READ  = 1 << 0,
+	PERM_WRITE = 1 << 1,
+	PERM_EXEC  = 1 << 2,
+	PERM_USER  = 3,			// Shift of the user bits
+};
+
+/* Access hook */
+typedef void (*MemHook)(void *priv, u32 address, u32 value, u8 flags);
+
+/* Page hook (first write to a clean page) */
+typedef void (*PageHook)(void *priv, u32 address, u32 size);
+
+/* Device callbacks (offset from the device base) */
+typedef u32  (*DevRead) (void *priv, u32 offset, u8 size);
+typedef void (*DevWrite)(void *priv, u32 offset, u32 value, u8 size);
+
+/* Device range */
+struct Device {
+	u32      base;
+	u32      size;
+	DevRead  read;
+	DevWrite write;
+	void    *priv;
+};
+
+
 /* Virtual space class */
 class VSpace {
 	/* Buffer */
-	u8 *buffer;
+	u8  *buffer;
+	bool mapped;			// Host mapping (not heap)
+	bool owned;			// Released with the space
 
 public:
 	/* Parameters */
 	u32 vaddr;
 	u32 size;
 
+	/* Page flags */
+	u8 *flags;
+	u32 pages;
+
 public:
-	 VSpace(u32 vaddr, u32 size);
+	 VSpace(u32 vaddr, u32 size, bool anon = false);
+	 VSpace(u32 vaddr, u32 size, u8 *buffer, bool owned = true);
 	~VSpace(void);
 
 	/* Read functions */
@@ -53,6 +115,19 @@ public:
 	/* Copy functions */
 	void Memcpy(u32 dst, void *src, u32 size);
 	void Memcpy(void *dst, u32 src, u32 size);
+
+	/* Release pages (anonymous spaces only) */
+	void Discard(u32 address, u32 size);
+
+	/* Host pointer */
+	inline u8 *Pointer(u32 address) {
+		return buffer + (address - vaddr);
+	}
+
+	/* Page flags of an address */
+	inline u8 Flags(u32 address) {
+		return flags[(address - vaddr) >> PAGE_SHIFT];
+	}
 };
 
 /* Memory class */
@@ -60,19 +135,145 @@ class Memory {
 	/* Virtual spaces */
 	static vector<VSpace *> Spaces;
 
+	/* Page table (pages fully inside one space) */
+	static VSpace *Table[PAGE_COUNT];
+
+	/* Devices */
+	static vector<Device> Devices;
+
+	/* Access hook */
+	static MemHook Hook;
+	static void   *HookPriv;
+
+	/* Dirty page hook */
+	static PageHook Dirty;
+	static void    *DirtyPriv;
+
+	/* Dirty page flags (cleared by Clean) */
+	static vector<u8 *> Dirtied;
+
+	/* Write fast path flags (PAGE_DIRTY while tracking) */
+	static u8 Tracked;
+
+	/* Watchpoint hook */
+	static MemHook Watch;
+	static void   *WatchPriv;
+
+	/* Page permissions (NULL if unprotected) */
+	static const u8 *Perm;
+	static u8        PermShift;
+
+	/* Permission fault hook */
+	static MemHook Fault;
+	static void   *FaultPriv;
+
+#ifdef __CACHE_MODEL__
+	/* Timing model hook */
+	static MemHook Model;
+	static void   *ModelPriv;
+#endif
+
 private:
 	static VSpace * Find(u32 address);
 
+	static void Map  (VSpace *Space, bool shadow = false);
+	static void Unmap(VSpace *Space);
+
+	static void Instrument(VSpace *Space);
+	static void Refresh   (void);
+
+	static void Touch  (VSpace *Space, u32 address, u32 size);
+	static bool Watched(VSpace *Space, u32 address, u32 size);
+	static u32  Direct (VSpace *Space, u32 address, u32 size, u8 mask);
+
+	/* Device access */
+	static u32  IoRead (u32 address, u8 size);
+	static bool IoWrite(u32 address, u32 value, u8 size);
+
+	/* Permission fault */
+	static u32  Abort  (u32 address, u8 flags);
+
+	/* Timing model (compiled out by default) */
+	static inline void Account(u32 address, u8 flags) {
+#ifdef __CACHE_MODEL__
+		if (Model)
+			Model(ModelPriv, address, 0, flags);
+#endif
+	}
+
 public:
 	/* Create/Destroy spaces */
-	static bool Create (u32 vaddr, u32 size);
+	static bool Create (u32 vaddr, u32 size, bool anon = false);
+	static bool Attach (u32 vaddr, u32 size, u8 *buffer);
 	static void Destroy(void);
 	static void Destroy(u32 vaddr);
 
+	/* Shadow spaces with a borrowed buffer (TCM) */
+	static VSpace *Overlay(u32 vaddr, u32 size, u8 *buffer);
+	static void    Remove (VSpace *Space);
+
+	/* Release pages back to zero */
+	static void Discard(u32 address, u32 size);
+
+	/* Register device registers */
+	static bool Register(u32 base, u32 size, DevRead read, DevWrite write, void *priv);
+
+	/* Range lookups (whole range in one space, any space in the range) */
+	static bool Inside  (u32 address, u32 size);
+	static bool Overlaps(u32 address, u32 size);
+
+	/* End of the highest space */
+	static u32 End(void);
+
 	/* Load functions */
 	static bool LoadBinary(const char *filename, u32 &entry);
 	static bool LoadELF   (const char *filename, u32 &entry);
 
+	/* Hook functions */
+	static void SetHook(MemHook hook, void *priv);
+	static void GetHook(MemHook &hook, void *&priv);
+
+	/* Dirty tracking functions */
+	static void SetDirtyHook(PageHook hook, void *priv);
+	static void Clean(void);
+
+	/* Page flag functions */
+	static void SetWatchHook(MemHook hook, void *priv);
+	static u8   Flags (u32 address);
+	static void Mark  (u32 address, u32 size, u8 flag);
+	static void Unmark(u32 address, u32 size, u8 flag);
+
+	/* Permission functions */
+	static void SetFaultHook  (MemHook hook, void *priv);
+	static void SetPermissions(const u8 *perm);
+	static void SetUser       (bool user);
+
+#ifdef __CACHE_MODEL__
+	/* Timing model functions */
+	static void SetModelHook(MemHook hook, void *priv);
+#endif
+
+	static inline bool Allowed(u32 address, u8 perm) {
+		return !Perm || ((Perm[address >> PAGE_SHIFT] >> PermShift) & perm);
+	}
+
+	/* Accesses can abort */
+	static inline bool Protected(void) {
+		return (Perm != 0);
+	}
+
+	/* Save/Restore functions (not hooked) */
+	static void Save   (u32 address, void *buf, u32 size);
+	static void Restore(u32 address, const void *buf, u32 size);
+
+	/* Debugger functions (not hooked, no permissions) */
+	static bool Peek8(u32 address, u8 &value);
+	static bool Poke8(u32 address, u8  value);
+
+	/* Fetch functions (not hooked) */
+	static u16 Fetch16(u32 address);
+	static u32 Fetch32(u32 address);
+
 	/* Read functions */
 	static u8  Read8 (u32 address);
 	static u16 Read16(u32 address);
@@ -86,6 +287,10 @@ public:
 	/* Copy functions */
 	static void Memcpy(u32 dst, void *src, u32 size);
 	static void Memcpy(void *dst, u32 src, u32 size);
+
+	/* Translate functions */
+	static u8 *Translate(u32 address, u32 size, u32 &len, bool write);
+	static u32 Spans    (u32 address, u32 size, struct iovec *iov, u32 max, bool write);
 };
 
 #endif /* __MEMORY_HPP__ */
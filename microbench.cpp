@@ -0,0 +1,423 @@
+/*
+ * ARM9 emulator - Host microbenchmarks
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <time.h>
+
+#include "arm.hpp"
+#include "memory.hpp"
+#include "microbench.hpp"
+
+/*
+ * Every kernel runs its operation in a loop sized so that one sample
+ * takes about BENCH_TARGET. After BENCH_WARMUP discarded samples (page
+ * faults, cold caches, frequency ramp-up) BENCH_SAMPLES are taken and
+ * reported as nanoseconds per operation. The "empty" kernel gives the
+ * loop overhead included in every other figure.
+ */
+
+
+/* Guest layout */
+#define CODE_BASE	0x00000000
+#define CODE_SIZE	0x00010000
+#define DATA_BASE	0x00008000	// Inside the code space
+#define REGION_BASE	0x10000000
+#define SWAP_BASE	0x20000000
+#define SWAP_SIZE	0x00010000
+
+/* Region counts */
+#define REGION_FIRST	1
+#define REGION_LAST	512
+
+
+/* Decoded instructions (Thumb BL pairs: first half in the low bits) */
+static const struct {
+	const char *name;
+	bool        thumb;
+	u32         opcode;
+} Opcodes[] = {
+	{ "arm/alu",       false, 0xE0910002 },	// adds r0, r1, r2
+	{ "arm/alu-imm",   false, 0xE2800001 },	// add r0, r0, #1
+	{ "arm/alu-shift", false, 0xE1A00181 },	// mov r0, r1, lsl #3
+	{ "arm/mul",       false, 0xE0000291 },	// mul r0, r1, r2
+	{ "arm/ldr",       false, 0xE5910004 },	// ldr r0, [r1, #4]
+	{ "arm/str",       false, 0xE5810004 },	// str r0, [r1, #4]
+	{ "arm/ldrh",      false, 0xE1D100B2 },	// ldrh r0, [r1, #2]
+	{ "arm/ldm",       false, 0xE891003C },	// ldmia r1, {r2-r5}
+	{ "arm/stm",       false, 0xE901003C },	// stmdb r1, {r2-r5}
+	{ "arm/b",         false, 0xEA000000 },	// b .+8
+	{ "arm/mrs",       false, 0xE10F0000 },	// mrs r0, cpsr
+	{ "arm/condfail",  false, 0x00910002 },	// addseq r0, r1, r2 (Z clear)
+	{ "thumb/alu",     true,  0x00001888 },	// adds r0, r1, r2
+	{ "thumb/shift",   true,  0x00000080 },	// lsls r0, r0, #2
+	{ "thumb/cmp",     true,  0x00002805 },	// cmp r0, #5
+	{ "thumb/ldr",     true,  0x00006848 },	// ldr r0, [r1, #4]
+	{ "thumb/str",     true,  0x00006048 },	// str r0, [r1, #4]
+	{ "thumb/b",       true,  0x0000E000 },	// b .+4
+	{ "thumb/bl",      true,  0xF800F000 },	// bl .+4
+};
+
+/* Kernel results end up here (keeps the loops alive) */
+static volatile u32 Sink;
+
+
+MicroBench::MicroBench(ARM *cpu, const char *filter)
+{
+	/* Set CPU */
+	this->cpu    = cpu;
+	this->filter = filter;
+
+	/* Clear state */
+	space   = NULL;
+	address = 0;
+	opcode  = 0;
+}
+
+u64 MicroBench::Now(void)
+{
+	struct timespec ts;
+
+	/* Monotonic time */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+u64 MicroBench::Time(BenchFunc func, u64 count)
+{
+	u64 start = Now();
+
+	/* Run kernel */
+	func(this, count);
+
+	return Now() - start;
+}
+
+void MicroBench::Run(const string &name, BenchFunc func)
+{
+	vector<double> samples;
+	BenchResult    res;
+
+	u64 count, elapsed;
+
+	/* Filtered out */
+	if (filter && name.find(filter) == string::npos)
+		return;
+
+	/* Calibrate (double until measurable, then scale to the target) */
+	for (count = 1; ; count <<= 1) {
+		elapsed = Time(func, count);
+
+		if (elapsed >= BENCH_TARGET / 10)
+			break;
+	}
+
+	count = max<u64>(1, count * BENCH_TARGET / elapsed);
+
+	/* Warm up */
+	for (u32 i = 0; i < BENCH_WARMUP; i++)
+		Time(func, count);
+
+	/* Take samples */
+	for (u32 i = 0; i < BENCH_SAMPLES; i++)
+		samples.push_back((double)Time(func, count) / count);
+
+	sort(samples.begin(), samples.end());
+
+	/* Statistics */
+	res.name   = name;
+	res.median = samples[BENCH_SAMPLES / 2];
+	res.min    = samples[0];
+	res.mean   = 0;
+	res.stddev = 0;
+
+	for (u32 i = 0; i < BENCH_SAMPLES; i++)
+		res.mean += samples[i] / BENCH_SAMPLES;
+
+	for (u32 i = 0; i < BENCH_SAMPLES; i++)
+		res.stddev += (samples[i] - res.mean) * (samples[i] - res.mean);
+
+	res.stddev = sqrt(res.stddev / (BENCH_SAMPLES - 1));
+
+	Results.push_back(res);
+}
+
+void MicroBench::Empty(void *priv, u64 count)
+{
+	u32 acc = 0;
+
+	for (u64 i = 0; i < count; i++)
+		acc += Sink;
+
+	Sink = acc;
+}
+
+void MicroBench::Read32(void *priv, u64 count)
+{
+	MicroBench *bench = (MicroBench *)priv;
+
+	u32 base = bench->address;
+	u32 acc  = 0;
+
+	for (u64 i = 0; i < count; i++)
+		acc += Memory::Read32(base + ((i << 2) & (PAGE_SIZE / 2 - 4)));
+
+	Sink = acc;
+}
+
+void MicroBench::Write32(void *priv, u64 count)
+{
+	MicroBench *bench = (MicroBench *)priv;
+
+	u32 base = bench->address;
+
+	for (u64 i = 0; i < count; i++)
+		Memory::Write32(base + ((i << 2) & (PAGE_SIZE / 2 - 4)), i);
+}
+
+void MicroBench::SpaceRead(void *priv, u64 count)
+{
+	MicroBench *bench = (MicroBench *)priv;
+
+	VSpace *space = bench->space;
+	u32     acc   = 0;
+
+	for (u64 i = 0; i < count; i++)
+		acc += space->Read32(SWAP_BASE + ((i << 2) & (SWAP_SIZE - 4)));
+
+	Sink = acc;
+}
+
+void MicroBench::SpaceWrite(void *priv, u64 count)
+{
+	MicroBench *bench = (MicroBench *)priv;
+
+	VSpace *space = bench->space;
+
+	for (u64 i = 0; i < count; i++)
+		space->Write32(SWAP_BASE + ((i << 2) & (SWAP_SIZE - 4)), i);
+}
+
+void MicroBench::CondArm(void *priv, u64 count)
+{
+	ARM *cpu = ((MicroBench *)priv)->cpu;
+	u32  acc = 0;
+
+	for (u64 i = 0; i < count; i++)
+		acc += cpu->CondCheck((u32)(i << 28));
+
+	Sink = acc;
+}
+
+void MicroBench::CondThumb(void *priv, u64 count)
+{
+	ARM *cpu = ((MicroBench *)priv)->cpu;
+	u32  acc = 0;
+
+	for (u64 i = 0; i < count; i++)
+		acc += cpu->CondCheck((u16)(0xD000 | ((i & 0xF) << 8)));
+
+	Sink = acc;
+}
+
+void MicroBench::Shift(void *priv, u64 count)
+{
+	ARM *cpu = ((MicroBench *)priv)->cpu;
+	u32  acc = 0;
+
+	/* All types and amounts, flags updated */
+	for (u64 i = 0; i < count; i++)
+		acc += cpu->Shift((1 << 20) | ((i & 0x7F) << 5), acc ^ i);
+
+	Sink = acc;
+}
+
+void MicroBench::Addition(void *priv, u64 count)
+{
+	ARM *cpu = ((MicroBench *)priv)->cpu;
+	u32  acc = 0;
+
+	for (u64 i = 0; i < count; i++)
+		acc = cpu->Addition(acc, i);
+
+	Sink = acc;
+}
+
+void MicroBench::Substract(void *priv, u64 count)
+{
+	ARM *cpu = ((MicroBench *)priv)->cpu;
+	u32  acc = 0;
+
+	for (u64 i = 0; i < count; i++)
+		acc = cpu->Substract(acc, i);
+
+	Sink = acc;
+}
+
+void MicroBench::DecodeArm(void *priv, u64 count)
+{
+	ARM *cpu = ((MicroBench *)priv)->cpu;
+
+	for (u64 i = 0; i < count; i++) {
+		*cpu->pc = CODE_BASE;
+		cpu->Parse();
+	}
+}
+
+void MicroBench::DecodeThumb(void *priv, u64 count)
+{
+	ARM *cpu = ((MicroBench *)priv)->cpu;
+
+	for (u64 i = 0; i < count; i++) {
+		*cpu->pc = CODE_BASE;
+		cpu->ParseThumb();
+	}
+}
+
+void MicroBench::Step(void *priv, u64 count)
+{
+	ARM *cpu = ((MicroBench *)priv)->cpu;
+
+	for (u64 i = 0; i < count; i++) {
+		*cpu->pc = CODE_BASE;
+		cpu->Execute();
+	}
+}
+
+void MicroBench::Regions(u32 count, bool partial)
+{
+	const char *kind = (partial) ? "partial" : "pages";
+
+	/* Half pages are found by a linear search, whole ones in the table */
+	u32  size   = (partial) ? PAGE_SIZE / 2 : PAGE_SIZE;
+	u32  stride = (partial) ? PAGE_SIZE / 2 : PAGE_SIZE * 2;
+	char name[64];
+
+	/* Create regions */
+	for (u32 i = 0; i < count; i++)
+		Memory::Create(REGION_BASE + i * stride, size);
+
+	/* Access the last one (longest search) */
+	address = REGION_BASE + (count - 1) * stride;
+
+	snprintf(name, sizeof(name), "read32/%s/%u", kind, count);
+	Run(name, Read32);
+
+	snprintf(name, sizeof(name), "write32/%s/%u", kind, count);
+	Run(name, Write32);
+
+	/* Destroy regions */
+	for (u32 i = 0; i < count; i++)
+		Memory::Destroy(REGION_BASE + i * stride);
+}
+
+void MicroBench::Swap(void)
+{
+	/* Standalone space (no lookup) */
+	space = new VSpace(SWAP_BASE, SWAP_SIZE);
+
+	Run("vspace/read32",  SpaceRead);
+	Run("vspace/write32", SpaceWrite);
+
+	delete space;
+	space = NULL;
+}
+
+void MicroBench::Flags(void)
+{
+	/* Mixed flags (N and C set) */
+	cpu->cpsr.value = 0xA0000000;
+
+	Run("cond/arm",   CondArm);
+	Run("cond/thumb", CondThumb);
+	Run("shift",      Shift);
+	Run("add",        Addition);
+	Run("sub",        Substract);
+
+	cpu->cpsr.value = 0;
+}
+
+void MicroBench::Decode(void)
+{
+	u32 count = sizeof(Opcodes) / sizeof(*Opcodes);
+
+	for (u32 i = 0; i < count; i++) {
+		/* Write instruction */
+		if (Opcodes[i].thumb) {
+			Memory::Write16(CODE_BASE,     Opcodes[i].opcode);
+			Memory::Write16(CODE_BASE + 2, Opcodes[i].opcode >> 16);
+		} else
+			Memory::Write32(CODE_BASE, Opcodes[i].opcode);
+
+		/* Operands */
+		cpu->cpsr.value = 0;
+		cpu->cpsr.t     = Opcodes[i].thumb;
+		cpu->r[1]       = DATA_BASE;
+		cpu->r[2]       = 3;
+
+		Run(string("decode/") + Opcodes[i].name, (Opcodes[i].thumb) ? DecodeThumb : DecodeArm);
+	}
+
+	/* Whole step (fetch checks, counters, hooks) */
+	Memory::Write32(CODE_BASE, Opcodes[0].opcode);
+
+	cpu->cpsr.value = 0;
+	Run("step/arm", Step);
+}
+
+void MicroBench::RunAll(void)
+{
+	/* Code and data */
+	Memory::Create(CODE_BASE, CODE_SIZE);
+
+	/* Loop overhead */
+	Run("empty", Empty);
+
+	/* Memory accesses */
+	for (u32 n = REGION_FIRST; n <= REGION_LAST; n *= 8)
+		Regions(n, false);
+
+	for (u32 n = REGION_FIRST; n <= REGION_LAST; n *= 8)
+		Regions(n, true);
+
+	/* Byte swapping */
+	Swap();
+
+	/* Conditions and flags */
+	Flags();
+
+	/* Instruction classes */
+	Decode();
+
+	/* Restore state */
+	Memory::Destroy(CODE_BASE);
+	cpu->Reset();
+}
+
+void MicroBench::Report(void)
+{
+	vector<BenchResult>::iterator it;
+
+	printf("%-24s %10s %10s %10s %10s\n", "BENCHMARK (ns/op)", "median", "mean", "stddev", "min");
+
+	for (it = Results.begin(); it != Results.end(); it++)
+		printf("%-24s %10.2f %10.2f %10.2f %10.2f\n", it->name.c_str(), it->median, it->mean, it->stddev, it->min);
+}
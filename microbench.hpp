@@ -0,0 +1,104 @@
+/*
+ * ARM9 emulator - Host microbenchmarks
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MICROBENCH_HPP__
+#define __MICROBENCH_HPP__
+
+#include <string>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+/* Constants */
+#define BENCH_WARMUP	3		// Discarded samples
+#define BENCH_SAMPLES	21
+#define BENCH_TARGET	10000000	// Sample length (ns)
+
+/* Benchmark kernel (runs the operation count times) */
+typedef void (*BenchFunc)(void *priv, u64 count);
+
+/* Benchmark result (nanoseconds per operation) */
+struct BenchResult {
+	string name;
+
+	double median;
+	double mean;
+	double stddev;
+	double min;
+};
+
+/* Forward declarations */
+class ARM;
+class VSpace;
+
+
+/* Microbenchmark class */
+class MicroBench {
+	ARM *cpu;
+
+	/* Name filter (substring) */
+	const char *filter;
+
+	/* Kernel state */
+	VSpace *space;
+	u32     address;
+	u32     opcode;
+
+	/* Results */
+	vector<BenchResult> Results;
+
+private:
+	static u64 Now(void);
+
+	u64  Time(BenchFunc func, u64 count);
+	void Run (const string &name, BenchFunc func);
+
+	/* Kernels */
+	static void Empty      (void *priv, u64 count);
+	static void Read32     (void *priv, u64 count);
+	static void Write32    (void *priv, u64 count);
+	static void SpaceRead  (void *priv, u64 count);
+	static void SpaceWrite (void *priv, u64 count);
+	static void CondArm    (void *priv, u64 count);
+	static void CondThumb  (void *priv, u64 count);
+	static void Shift      (void *priv, u64 count);
+	static void Addition   (void *priv, u64 count);
+	static void Substract  (void *priv, u64 count);
+	static void DecodeArm  (void *priv, u64 count);
+	static void DecodeThumb(void *priv, u64 count);
+	static void Step       (void *priv, u64 count);
+
+	/* Suites */
+	void Regions(u32 count, bool partial);
+	void Swap   (void);
+	void Flags  (void);
+	void Decode (void);
+
+public:
+	MicroBench(ARM *cpu, const char *filter = NULL);
+
+	/* Run all benchmarks */
+	void RunAll(void);
+
+	/* Report function */
+	void Report(void);
+};
+
+#endif /* __MICROBENCH_HPP__ */
@@ -0,0 +1,146 @@
+/*
+ * ARM9 emulator - Performance counters
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "arm.hpp"
+#include "memory.hpp"
+#include "perf.hpp"
+
+/*
+ * Counters are never ticked: a running counter is the distance of the
+ * CPU cycle or instruction count from a base, so reading it costs two
+ * loads and executing costs nothing. The same counters are seen through
+ * CP15 and through the memory-mapped block, so both report consistent
+ * numbers. They run from reset, like a free-running timestamp.
+ */
+
+
+PerfCounters::PerfCounters(ARM *cpu)
+{
+	/* Set parameters */
+	this->cpu = cpu;
+
+	/* Reset counters */
+	Reset();
+}
+
+u64 PerfCounters::Source(u32 idx)
+{
+	/* CPU counters */
+	return (idx == PERF_CYCLES) ? cpu->Cycles() : cpu->Count();
+}
+
+void PerfCounters::Reset(void)
+{
+	/* Count from zero */
+	for (u32 i = 0; i < PERF_COUNT; i++) {
+		base [i] = 0;
+		value[i] = 0;
+		latch[i] = 0;
+	}
+
+	running = true;
+}
+
+u64 PerfCounters::Get(u32 idx)
+{
+	/* Running or frozen */
+	return (running) ? Source(idx) - base[idx] : value[idx];
+}
+
+void PerfCounters::Set(u32 idx, u64 value)
+{
+	/* Rebase counter */
+	if (running)
+		base[idx] = Source(idx) - value;
+	else
+		this->value[idx] = value;
+}
+
+void PerfCounters::Enable(bool enable)
+{
+	if (enable == running)
+		return;
+
+	/* Freeze or resume counting */
+	for (u32 i = 0; i < PERF_COUNT; i++) {
+		if (enable)
+			base[i] = Source(i) - value[i];
+		else
+			value[i] = Source(i) - base[i];
+	}
+
+	running = enable;
+}
+
+u32 PerfCounters::Read(void *priv, u32 offset, u8 size)
+{
+	PerfCounters *Dev = (PerfCounters *)priv;
+	u64 value;
+
+	switch (offset) {
+	case PERF_CTRL:
+		return (Dev->running) ? PERF_ENABLE : 0;
+
+	case PERF_CYCLO:
+	case PERF_INSLO: {
+		u32 idx = (offset == PERF_CYCLO) ? PERF_CYCLES : PERF_INSTR;
+
+		/* Latch high word */
+		value = Dev->Get(idx);
+		Dev->latch[idx] = value >> 32;
+
+		return value;
+	}
+
+	case PERF_CYCHI:
+		return Dev->latch[PERF_CYCLES];
+
+	case PERF_INSHI:
+		return Dev->latch[PERF_INSTR];
+
+	default:
+		return 0;
+	}
+}
+
+void PerfCounters::Write(void *priv, u32 offset, u32 value, u8 size)
+{
+	PerfCounters *Dev = (PerfCounters *)priv;
+
+	switch (offset) {
+	case PERF_CTRL:
+		/* Zero both counters */
+		if (value & PERF_RESET) {
+			Dev->Set(PERF_CYCLES, 0);
+			Dev->Set(PERF_INSTR,  0);
+		}
+
+		Dev->Enable(value & PERF_ENABLE);
+		break;
+
+	default:
+		break;
+	}
+}
+
+bool PerfCounters::Attach(u32 base)
+{
+	/* Register device */
+	return Memory::Register(base, PERF_SIZE, Read, Write, this);
+}
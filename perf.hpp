@@ -0,0 +1,93 @@
+/*
+ * ARM9 emulator - Performance counters
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PERF_HPP__
+#define __PERF_HPP__
+
+#include "types.h"
+
+/* Constants */
+#define PERF_SIZE	0x1000		// Register window
+
+/* Counters */
+enum {
+	PERF_CYCLES = 0,
+	PERF_INSTR  = 1,
+	PERF_COUNT  = 2,
+};
+
+/* Registers (counter block) */
+enum {
+	PERF_CTRL  = 0x00,
+	PERF_CYCLO = 0x04,
+	PERF_CYCHI = 0x08,		// Latched by a CYCLO read
+	PERF_INSLO = 0x0C,
+	PERF_INSHI = 0x10,		// Latched by an INSLO read
+};
+
+/* Control register bits */
+enum {
+	PERF_ENABLE = 1 << 0,
+	PERF_RESET  = 1 << 1,		// Write only
+};
+
+/* Forward declarations */
+class ARM;
+
+
+/* Performance counters class */
+class PerfCounters {
+	ARM *cpu;
+
+	/* Counter state */
+	bool running;
+	u64  base [PERF_COUNT];		// Source value at zero (running)
+	u64  value[PERF_COUNT];		// Value (stopped)
+
+	/* High words latched by low reads */
+	u32  latch[PERF_COUNT];
+
+private:
+	static u32  Read (void *priv, u32 offset, u8 size);
+	static void Write(void *priv, u32 offset, u32 value, u8 size);
+
+	u64 Source(u32 idx);
+
+public:
+	PerfCounters(ARM *cpu);
+
+	/* Reset function */
+	void Reset(void);
+
+	/* Attach function (memory-mapped block) */
+	bool Attach(u32 base);
+
+	/* Counter functions */
+	u64  Get(u32 idx);
+	void Set(u32 idx, u64 value);
+
+	/* Enable functions */
+	void Enable(bool enable);
+
+	inline bool Enabled(void) {
+		return running;
+	}
+};
+
+#endif /* __PERF_HPP__ */
@@ -0,0 +1,148 @@
+/*
+ * ARM9 emulator - Sampling profiler
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <ctime>
+
+#include "arm.hpp"
+#include "profile.hpp"
+#include "symbols.hpp"
+
+/*
+ * The CPU publishes the address of each instruction it executes in a
+ * single word, which costs one plain store on the emulator thread. A
+ * host thread wakes at a fixed rate, reads that word and counts it, so
+ * the histogram is only touched by the sampler until it is joined.
+ * Addresses are folded into their functions when the profile is saved.
+ */
+
+
+Profiler::Profiler(ARM *cpu)
+{
+	/* Set parameters */
+	this->cpu = cpu;
+
+	/* Clear state */
+	running = false;
+	period  = 0;
+	total   = 0;
+}
+
+Profiler::~Profiler(void)
+{
+	/* Stop sampler */
+	Stop();
+}
+
+void *Profiler::Sampler(void *arg)
+{
+	Profiler *prof = (Profiler *)arg;
+	struct timespec next;
+
+	/* First tick */
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	while (__atomic_load_n(&prof->running, __ATOMIC_ACQUIRE)) {
+		/* Next tick (absolute, so the rate does not drift) */
+		next.tv_nsec += prof->period;
+		if (next.tv_nsec >= 1000000000) {
+			next.tv_nsec -= 1000000000;
+			next.tv_sec++;
+		}
+
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		/* Take sample */
+		prof->Samples[prof->cpu->Sample()]++;
+		prof->total++;
+	}
+
+	return NULL;
+}
+
+bool Profiler::Start(u32 hz)
+{
+	s32 ret;
+
+	/* Already running */
+	if (running || !hz)
+		return false;
+
+	/* Clear histogram */
+	Samples.clear();
+	total  = 0;
+	period = 1000000000 / hz;
+
+	/* Start sampler */
+	running = true;
+
+	ret = pthread_create(&thread, NULL, Sampler, this);
+	if (ret) {
+		running = false;
+		return false;
+	}
+
+	return true;
+}
+
+void Profiler::Stop(void)
+{
+	/* Stop sampler */
+	if (running) {
+		__atomic_store_n(&running, false, __ATOMIC_RELEASE);
+		pthread_join(thread, NULL);
+	}
+}
+
+bool Profiler::Save(const char *filename)
+{
+	map<string, u64> Frames;
+	map<string, u64>::iterator frame;
+	map<u32, u64>::iterator    it;
+
+	FILE *fp;
+
+	/* Open file */
+	fp = fopen(filename, "w");
+	if (!fp)
+		return false;
+
+	/* Fold addresses into functions (address if unknown) */
+	for (it = Samples.begin(); it != Samples.end(); it++) {
+		const char *name;
+		u32  offset;
+		char buf[16];
+
+		if (!Symbols::Lookup(it->first & ~1, name, offset)) {
+			snprintf(buf, sizeof(buf), "0x%08X", it->first & ~1);
+			name = buf;
+		}
+
+		Frames[name] += it->second;
+	}
+
+	/* One leaf frame per function */
+	for (frame = Frames.begin(); frame != Frames.end(); frame++)
+		fprintf(fp, "%s %llu\n", frame->first.c_str(), frame->second);
+
+	/* Close file */
+	fclose(fp);
+
+	return true;
+}
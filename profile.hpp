@@ -0,0 +1,70 @@
+/*
+ * ARM9 emulator - Sampling profiler
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PROFILE_HPP__
+#define __PROFILE_HPP__
+
+#include <map>
+#include <string>
+#include <pthread.h>
+#include "types.h"
+
+using namespace std;
+
+/* Constants */
+#define PROFILE_HZ	1000		// Default sampling frequency
+
+
+/* Forward declarations */
+class ARM;
+
+
+/* Sampling profiler class */
+class Profiler {
+	ARM *cpu;
+
+	/* Sampler thread */
+	pthread_t thread;
+	bool      running;
+	u32       period;		// Nanoseconds
+
+	/* Histogram (guest PC, bit 0 set in Thumb state) */
+	map<u32, u64> Samples;
+	u64           total;
+
+private:
+	static void *Sampler(void *arg);
+
+public:
+	 Profiler(ARM *cpu);
+	~Profiler(void);
+
+	/* Start/Stop functions */
+	bool Start(u32 hz = PROFILE_HZ);
+	void Stop (void);
+
+	/* Save function (folded stacks) */
+	bool Save(const char *filename);
+
+	/* Statistics */
+	inline u64 Total    (void) { return total; }
+	inline u64 Addresses(void) { return Samples.size(); }
+};
+
+#endif /* __PROFILE_HPP__ */
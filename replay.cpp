@@ -0,0 +1,389 @@
+/*
+ * ARM9 emulator - Checkpoints and reverse execution
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <set>
+
+#include "arm.hpp"
+#include "memory.hpp"
+#include "replay.hpp"
+
+/*
+ * Every checkpoint holds the CPU state at its instruction count and
+ * the pre-image of each page first written after it was taken, so
+ * restoring checkpoint N means putting back the pre-images of the
+ * checkpoints from the newest down to N. Going to an arbitrary
+ * instruction restores the nearest older checkpoint and re-executes
+ * forward; syscall results (and the guest memory they wrote) are
+ * taken from the log while doing so, and scheduler events and
+ * interrupts are delivered at the same boundaries as Step/Run.
+ *
+ * Changes to the memory map made by syscalls (brk, mmap, munmap) and
+ * device state are not undone: device registers, interrupt lines and
+ * the pending events that devices scheduled keep their current values.
+ * Reverse execution is therefore only exact for guests that do not
+ * depend on devices (timers, interrupt controllers) in the replayed
+ * range.
+ */
+
+
+Replay::Replay(ARM *cpu, u64 budget)
+{
+	/* Set parameters */
+	this->cpu    = cpu;
+	this->budget = budget;
+
+	interval = REPLAY_INTERVAL;
+	bytes    = 0;
+}
+
+Replay::~Replay(void)
+{
+	/* Stop checkpoints */
+	Stop();
+}
+
+void Replay::Dirty(void *priv, u32 address, u32 size)
+{
+	Replay    *replay = (Replay *)priv;
+	ReplayPage page;
+
+	/* Save pre-image */
+	page.address = address;
+	page.size    = size;
+	page.data    = new u8[size];
+
+	Memory::Save(address, page.data, size);
+
+	/* Add to the newest checkpoint */
+	replay->checkpoints.back()->pages.push_back(page);
+	replay->bytes += size;
+}
+
+void Replay::Take(void)
+{
+	Checkpoint *cp = new Checkpoint;
+
+	/* Save CPU state */
+	memcpy(cp->r, cpu->r, sizeof(cp->r));
+
+	cp->cpsr     = cpu->cpsr.value;
+	cp->spsr     = cpu->spsr;
+	cp->bank     = cpu->bank;
+	cp->icount   = cpu->icount;
+	cp->cycles   = cpu->cycles;
+	cp->loadreg  = cpu->loadreg;
+	cp->loadwait = cpu->loadwait;
+	cp->finished = cpu->finished;
+
+	/* Start tracking pages */
+	Memory::Clean();
+
+	/* Push checkpoint */
+	checkpoints.push_back(cp);
+
+	/* Keep within budget */
+	if (bytes > budget)
+		Thin();
+}
+
+void Replay::Rewind(u32 idx)
+{
+	Checkpoint *cp;
+
+	/* Undo pages, newest first */
+	while (checkpoints.size() > idx) {
+		cp = checkpoints.back();
+
+		for (u32 i = cp->pages.size(); i--; ) {
+			ReplayPage *page = &cp->pages[i];
+
+			/* Restore pre-image */
+			Memory::Restore(page->address, page->data, page->size);
+
+			delete[] page->data;
+			bytes -= page->size;
+		}
+
+		cp->pages.clear();
+
+		/* Target checkpoint */
+		if (checkpoints.size() == idx + 1)
+			break;
+
+		/* Drop newer checkpoint */
+		checkpoints.pop_back();
+		delete cp;
+	}
+
+	/* Restore CPU state */
+	cp = checkpoints[idx];
+
+	memcpy(cpu->r, cp->r, sizeof(cp->r));
+
+	cpu->spsr     = cp->spsr;
+	cpu->bank     = cp->bank;
+	cpu->icount   = cp->icount;
+	cpu->finished = cp->finished;
+
+	/* Registers are already in the checkpoint's bank (updates privilege) */
+	cpu->SetCPSR(cp->cpsr);
+
+	/* Rewind the clock (pending events keep their distance) */
+	cpu->events.Rebase(cpu->cycles, cp->cycles);
+	cpu->cycles   = cp->cycles;
+	cpu->loadreg  = cp->loadreg;
+	cpu->loadwait = cp->loadwait;
+
+	/* Start tracking pages */
+	Memory::Clean();
+}
+
+void Replay::Thin(void)
+{
+	vector<Checkpoint *> kept;
+	u32 last = checkpoints.size() - 1;
+
+	/* Merge every other checkpoint into its predecessor (the newest one keeps tracking) */
+	for (u32 i = 0; i < last; i++) {
+		Checkpoint *cp = checkpoints[i];
+		Checkpoint *prev;
+		set<u32>    addrs;
+
+		if (!(i & 1)) {
+			kept.push_back(cp);
+			continue;
+		}
+
+		prev = kept.back();
+
+		for (u32 j = 0; j < prev->pages.size(); j++)
+			addrs.insert(prev->pages[j].address);
+
+		/* Older pre-image wins */
+		for (u32 j = 0; j < cp->pages.size(); j++) {
+			ReplayPage *page = &cp->pages[j];
+
+			if (addrs.count(page->address)) {
+				delete[] page->data;
+				bytes -= page->size;
+			} else
+				prev->pages.push_back(*page);
+		}
+
+		delete cp;
+	}
+
+	kept.push_back(checkpoints[last]);
+
+	/* Update checkpoints */
+	checkpoints = kept;
+	interval  <<= 1;
+}
+
+void Replay::Forward(u64 target, u64 *hit)
+{
+	Trace *trace   = cpu->trace;
+	bool   verbose = cpu->verbose;
+
+	MemHook hook;
+	void   *priv;
+
+	/* Re-execute silently (no access capture either) */
+	Memory::GetHook(hook, priv);
+	Memory::SetHook(NULL, NULL);
+
+	cpu->trace   = NULL;
+	cpu->verbose = false;
+
+	while (cpu->icount < target && !cpu->finished) {
+		/* Remove thumb bit */
+		cpu->r[15] &= ~1;
+
+		/* Breakpoint hit */
+		if (hit && cpu->BreakFind(cpu->r[15]))
+			*hit = cpu->icount;
+
+		/* Execute instruction */
+		cpu->Execute();
+
+		/* Deliver events and interrupts as Step/Run did (stop requests wait) */
+		cpu->Retire(false);
+	}
+
+	/* Restore tracing */
+	cpu->trace   = trace;
+	cpu->verbose = verbose;
+
+	Memory::SetHook(hook, priv);
+}
+
+void Replay::Start(void)
+{
+	/* Stop checkpoints */
+	Stop();
+
+	/* Install hooks */
+	Memory::SetDirtyHook(Dirty, this);
+	cpu->SetReplay(this);
+
+	/* First checkpoint */
+	Take();
+}
+
+void Replay::Stop(void)
+{
+	/* Remove hooks */
+	if (!checkpoints.empty()) {
+		Memory::SetDirtyHook(NULL, NULL);
+		cpu->SetReplay(NULL);
+	}
+
+	/* Free checkpoints */
+	while (!checkpoints.empty()) {
+		Checkpoint *cp = checkpoints.back();
+
+		for (u32 i = 0; i < cp->pages.size(); i++)
+			delete[] cp->pages[i].data;
+
+		checkpoints.pop_back();
+		delete cp;
+	}
+
+	/* Clear log */
+	log.clear();
+	pending.clear();
+
+	bytes = 0;
+}
+
+void Replay::Tick(void)
+{
+	/* Checkpoint interval reached */
+	if (cpu->icount - checkpoints.back()->icount >= interval)
+		Take();
+}
+
+void Replay::Log(u64 icount, u32 value, bool finished)
+{
+	SvcResult res;
+
+	/* Log result */
+	res.value    = value;
+	res.finished = finished;
+	res.writes.swap(pending);
+
+	log[icount] = res;
+	pending.clear();
+}
+
+void Replay::LogData(u32 address, const void *buf, u32 size)
+{
+	SvcData data;
+
+	/* Save written data */
+	data.address = address;
+	data.data.assign((const u8 *)buf, (const u8 *)buf + size);
+
+	pending.push_back(data);
+}
+
+bool Replay::Lookup(u64 icount, u32 &value, bool &finished)
+{
+	map<u64, SvcResult>::iterator it;
+
+	/* Find result */
+	it = log.find(icount);
+	if (it == log.end())
+		return false;
+
+	value    = it->second.value;
+	finished = it->second.finished;
+
+	/* Write guest memory again */
+	for (u32 i = 0; i < it->second.writes.size(); i++) {
+		SvcData *data = &it->second.writes[i];
+
+		if (!data->data.empty())
+			Memory::Memcpy(data->address, &data->data[0], data->data.size());
+	}
+
+	return true;
+}
+
+bool Replay::Seek(u64 icount)
+{
+	u32 idx;
+
+	/* Outside of the recorded history */
+	if (checkpoints.empty() || icount > cpu->icount || icount < checkpoints[0]->icount)
+		return false;
+
+	/* Find nearest older checkpoint */
+	for (idx = checkpoints.size() - 1; checkpoints[idx]->icount > icount; idx--);
+
+	/* Restore and re-execute */
+	Rewind(idx);
+	Forward(icount, NULL);
+
+	return (cpu->icount == icount);
+}
+
+bool Replay::StepBack(void)
+{
+	/* Start of history */
+	if (checkpoints.empty() || cpu->icount == checkpoints[0]->icount)
+		return false;
+
+	return Seek(cpu->icount - 1);
+}
+
+bool Replay::ContinueBack(void)
+{
+	u64 end = cpu->icount;
+
+	if (checkpoints.empty())
+		return false;
+
+	/* Search intervals backwards */
+	for (s32 idx = checkpoints.size() - 1; idx >= 0; idx--) {
+		u64 start = checkpoints[idx]->icount;
+		u64 hit   = end;
+
+		if (start >= end)
+			continue;
+
+		/* Replay interval looking for breakpoints */
+		Rewind(idx);
+		Forward(end, &hit);
+
+		/* Stop at the last hit */
+		if (hit != end) {
+			Seek(hit);
+			return true;
+		}
+
+		end = start;
+	}
+
+	/* Stop at the start of history */
+	Seek(checkpoints[0]->icount);
+
+	return false;
+}
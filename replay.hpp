@@ -0,0 +1,125 @@
+/*
+ * ARM9 emulator - Checkpoints and reverse execution
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __REPLAY_HPP__
+#define __REPLAY_HPP__
+
+#include <map>
+#include <vector>
+#include "arm.hpp"
+#include "types.h"
+
+using namespace std;
+
+/* Constants */
+#define REPLAY_INTERVAL	1024			// Initial checkpoint interval
+#define REPLAY_BUDGET	(64 * 1024 * 1024)	// Default page budget
+
+/* Page pre-image */
+struct ReplayPage {
+	u32 address;
+	u32 size;
+	u8 *data;
+};
+
+/* Checkpoint */
+struct Checkpoint {
+	/* CPU state */
+	u32  r[16];
+	u32  cpsr;
+	u32  spsr;
+	RegBanks bank;
+	u64  icount;
+	u64  cycles;
+	u32  loadreg;			// Pending load-use interlock
+	u32  loadwait;
+	bool finished;
+
+	/* Pages first written after this checkpoint */
+	vector<ReplayPage> pages;
+};
+
+/* Guest memory written by a syscall */
+struct SvcData {
+	u32 address;
+	vector<u8> data;
+};
+
+/* Syscall result */
+struct SvcResult {
+	u32  value;
+	bool finished;
+
+	vector<SvcData> writes;
+};
+
+
+/* Replay class */
+class Replay {
+	ARM *cpu;
+
+	/* Checkpoints */
+	vector<Checkpoint *> checkpoints;
+
+	/* Syscall log */
+	map<u64, SvcResult> log;
+	vector<SvcData>     pending;
+
+	/* Parameters */
+	u64 interval;
+	u64 budget;
+	u64 bytes;
+
+private:
+	static void Dirty(void *priv, u32 address, u32 size);
+
+	/* Checkpoint functions */
+	void Take   (void);
+	void Rewind (u32 idx);
+	void Thin   (void);
+	void Forward(u64 target, u64 *hit);
+
+public:
+	 Replay(ARM *cpu, u64 budget = REPLAY_BUDGET);
+	~Replay(void);
+
+	/* Start/Stop functions */
+	void Start(void);
+	void Stop (void);
+
+	/* Execution hook */
+	void Tick(void);
+
+	/* Syscall log functions */
+	void Log    (u64 icount, u32  value, bool  finished);
+	void LogData(u32 address, const void *buf, u32 size);
+	bool Lookup (u64 icount, u32 &value, bool &finished);
+
+	/* Reverse execution functions */
+	bool Seek        (u64 icount);
+	bool StepBack    (void);
+	bool ContinueBack(void);
+
+	/* Statistics */
+	inline u64 Checkpoints(void) { return checkpoints.size(); }
+	inline u64 Interval   (void) { return interval; }
+	inline u64 Bytes      (void) { return bytes;    }
+};
+
+#endif /* __REPLAY_HPP__ */
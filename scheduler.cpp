@@ -0,0 +1,119 @@
+/*
+ * ARM9 emulator - Event scheduler
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "scheduler.hpp"
+
+/*
+ * Events are kept in a binary min-heap keyed on the CPU cycle counter,
+ * ties broken by insertion order. The CPU only compares its counter
+ * against the earliest deadline between bursts, devices are never
+ * polled.
+ */
+
+
+Scheduler::Scheduler(void)
+{
+	/* Clear state */
+	nextid = 1;
+}
+
+bool Scheduler::Later(const Event &a, const Event &b)
+{
+	if (a.when != b.when)
+		return a.when > b.when;
+
+	return a.id > b.id;
+}
+
+void Scheduler::Deliver(u64 now)
+{
+	/* Pop due events (hooks may add new ones) */
+	while (!heap.empty() && heap.front().when <= now) {
+		Event ev = heap.front();
+
+		pop_heap(heap.begin(), heap.end(), Later);
+		heap.pop_back();
+
+		ev.hook(ev.priv, ev.when);
+	}
+}
+
+u32 Scheduler::Add(u64 when, EventHook hook, void *priv)
+{
+	Event ev;
+
+	/* Fill event */
+	ev.when = when;
+	ev.id   = nextid++;
+	ev.hook = hook;
+	ev.priv = priv;
+
+	/* Push event */
+	heap.push_back(ev);
+	push_heap(heap.begin(), heap.end(), Later);
+
+	return ev.id;
+}
+
+void Scheduler::Cancel(u32 id)
+{
+	vector<Event>::iterator it;
+
+	/* Find event */
+	for (it = heap.begin(); it < heap.end(); it++) {
+		if (it->id == id) {
+			heap.erase(it);
+			make_heap(heap.begin(), heap.end(), Later);
+
+			break;
+		}
+	}
+}
+
+void Scheduler::Clear(void)
+{
+	/* Drop events */
+	heap.clear();
+}
+
+u64 Scheduler::When(u32 id)
+{
+	vector<Event>::iterator it;
+
+	/* Find event */
+	for (it = heap.begin(); it < heap.end(); it++) {
+		if (it->id == id)
+			return it->when;
+	}
+
+	return EVENT_NEVER;
+}
+
+void Scheduler::Rebase(u64 from, u64 to)
+{
+	vector<Event>::iterator it;
+
+	/* Keep the distance to each deadline (overdue ones fire at once) */
+	for (it = heap.begin(); it < heap.end(); it++)
+		it->when = to + ((it->when > from) ? it->when - from : 0);
+
+	make_heap(heap.begin(), heap.end(), Later);
+}
@@ -0,0 +1,82 @@
+/*
+ * ARM9 emulator - Event scheduler
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCHEDULER_HPP__
+#define __SCHEDULER_HPP__
+
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+/* Constants */
+#define EVENT_NEVER	(~0ULL)		// No pending event
+
+/* Event hook (called at or after its cycle) */
+typedef void (*EventHook)(void *priv, u64 when);
+
+/* Pending event */
+struct Event {
+	u64       when;
+	u32       id;
+	EventHook hook;
+	void     *priv;
+};
+
+
+/* Scheduler class */
+class Scheduler {
+	/* Min-heap on (when, id) */
+	vector<Event> heap;
+
+	/* Next event id */
+	u32 nextid;
+
+private:
+	static bool Later(const Event &a, const Event &b);
+
+	void Deliver(u64 now);
+
+public:
+	Scheduler(void);
+
+	/* Event functions */
+	u32  Add   (u64 when, EventHook hook, void *priv);
+	void Cancel(u32 id);
+	void Clear (void);
+
+	/* Deadline of an event (EVENT_NEVER if not pending) */
+	u64  When(u32 id);
+
+	/* Move pending events to a new cycle counter value */
+	void Rebase(u64 from, u64 to);
+
+	/* Next deadline */
+	inline u64 Deadline(void) {
+		return (heap.empty()) ? EVENT_NEVER : heap.front().when;
+	}
+
+	/* Run due events */
+	inline void Dispatch(u64 now) {
+		if (now >= Deadline())
+			Deliver(now);
+	}
+};
+
+#endif /* __SCHEDULER_HPP__ */
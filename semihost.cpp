@@ -0,0 +1,268 @@
+/*
+ * ARM9 emulator - ARM semihosting
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "arm.hpp"
+#include "endian.h"
+#include "memory.hpp"
+#include "semihost.hpp"
+
+using namespace std;
+
+/*
+ * r0 holds the operation and r1 points to its parameter block. File
+ * handles are host descriptors ("tt" maps to 0, 1 and 2), reads and
+ * writes go between the descriptor and the guest buffer spans with a
+ * single readv()/writev().
+ */
+
+/* open() flags for each semihosting mode (r, r+, w, w+, a, a+) */
+static const s32 OpenFlags[6] = {
+	O_RDONLY,
+	O_RDWR,
+	O_WRONLY | O_CREAT | O_TRUNC,
+	O_RDWR   | O_CREAT | O_TRUNC,
+	O_WRONLY | O_CREAT | O_APPEND,
+	O_RDWR   | O_CREAT | O_APPEND,
+};
+
+
+static u64 Now(void)
+{
+	struct timeval tv;
+
+	/* Get time */
+	gettimeofday(&tv, NULL);
+
+	return (u64)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+
+Semihost::Semihost(ARM *cpu)
+{
+	/* Set parameters */
+	this->cpu = cpu;
+
+	/* Start time */
+	start = Now();
+}
+
+u32 Semihost::Arg(u32 idx)
+{
+	/* Read parameter */
+	return Memory::Read32(cpu->r[1] + (idx << 2));
+}
+
+s32 Semihost::Open(u32 name, u32 mode, u32 len)
+{
+	struct iovec iov[SEMIHOST_IOVS];
+
+	string path;
+	u32    cnt;
+	s32    fd;
+
+	if (mode > 11)
+		return -1;
+
+	/* Copy name */
+	cnt = Memory::Spans(name, len, iov, SEMIHOST_IOVS, false);
+
+	for (u32 i = 0; i < cnt; i++)
+		path.append((char *)iov[i].iov_base, iov[i].iov_len);
+
+	/* Console */
+	if (path == ":tt")
+		return mode >> 2;
+
+	/* Open file */
+	fd = open(path.c_str(), OpenFlags[mode >> 1], 0644);
+
+	return (fd < 0) ? -1 : fd;
+}
+
+s32 Semihost::Close(u32 handle)
+{
+	/* Keep console */
+	if (handle <= 2)
+		return 0;
+
+	/* Close file */
+	return (close(handle) < 0) ? -1 : 0;
+}
+
+s32 Semihost::Write0(u32 address)
+{
+	struct iovec iov[SEMIHOST_IOVS];
+	u32 cnt = 0;
+
+	for (;;) {
+		u32 len  = PAGE_SIZE - (address & (PAGE_SIZE - 1));
+		u8 *ptr, *end;
+
+		/* Resolve up to the page boundary */
+		ptr = Memory::Translate(address, len, len, false);
+		if (!ptr)
+			break;
+
+		/* Look for the terminator */
+		end = (u8 *)memchr(ptr, 0, len);
+
+		iov[cnt].iov_base = ptr;
+		iov[cnt].iov_len  = (end) ? (u32)(end - ptr) : len;
+		cnt++;
+
+		if (end)
+			break;
+
+		/* Flush spans */
+		if (cnt == SEMIHOST_IOVS) {
+			cpu->output[0]->Write(iov, cnt);
+			cnt = 0;
+		}
+
+		address += len;
+	}
+
+	/* Write string */
+	cpu->output[0]->Write(iov, cnt);
+
+	return 0;
+}
+
+u32 Semihost::Write(u32 handle, u32 address, u32 size)
+{
+	struct iovec iov[SEMIHOST_IOVS];
+
+	u32 cnt, total = 0;
+	s32 ret;
+
+	/* Resolve guest buffer */
+	cnt = Memory::Spans(address, size, iov, SEMIHOST_IOVS, false);
+
+	for (u32 i = 0; i < cnt; i++)
+		total += iov[i].iov_len;
+
+	/* Console */
+	if (handle == 1 || handle == 2) {
+		cpu->output[handle - 1]->Write(iov, cnt);
+		return size - total;
+	}
+
+	/* Write file */
+	ret = writev(handle, iov, cnt);
+	if (ret < 0)
+		return size;
+
+	/* Bytes not written */
+	return size - ret;
+}
+
+u32 Semihost::Read(u32 handle, u32 address, u32 size)
+{
+	struct iovec iov[SEMIHOST_IOVS];
+
+	u32 cnt;
+	s32 ret;
+
+	/* Resolve guest buffer */
+	cnt = Memory::Spans(address, size, iov, SEMIHOST_IOVS, true);
+
+	/* Read file */
+	ret = readv(handle, iov, cnt);
+	if (ret < 0)
+		return size;
+
+	/* Log for replay */
+	cpu->SvcLog(address, iov, cnt, ret);
+
+	/* Bytes not read */
+	return size - ret;
+}
+
+u32 Semihost::Clock(void)
+{
+	/* Centiseconds since start */
+	return (Now() - start) / 10000;
+}
+
+s32 Semihost::Elapsed(u32 address)
+{
+	u32 buf[2];
+
+	/* Instructions executed, low word first */
+	buf[0] = Swap32(cpu->icount);
+	buf[1] = Swap32(cpu->icount >> 32);
+
+	cpu->SvcStore(address, buf, sizeof(buf));
+
+	return 0;
+}
+
+void Semihost::Call(void)
+{
+	u32 *r = cpu->r;
+
+	switch (r[0]) {
+	case SH_OPEN:
+		r[0] = Open(Arg(0), Arg(1), Arg(2));
+		break;
+
+	case SH_CLOSE:
+		r[0] = Close(Arg(0));
+		break;
+
+	case SH_WRITE0:
+		r[0] = Write0(r[1]);
+		break;
+
+	case SH_WRITE:
+		r[0] = Write(Arg(0), Arg(1), Arg(2));
+		break;
+
+	case SH_READ:
+		r[0] = Read(Arg(0), Arg(1), Arg(2));
+		break;
+
+	case SH_CLOCK:
+		r[0] = Clock();
+		break;
+
+	case SH_ELAPSED:
+		r[0] = Elapsed(r[1]);
+		break;
+
+	case SH_EXIT:
+		/* Set finish flag */
+		cpu->finished = true;
+
+		r[0] = (r[1] == ADP_STOPPED_EXIT) ? 0 : r[1];
+		break;
+
+	default:
+		printf("         [S] Unhandled semihosting call! (%02X)\n", r[0]);
+
+		r[0] = -1;
+	}
+}
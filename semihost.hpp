@@ -0,0 +1,76 @@
+/*
+ * ARM9 emulator - ARM semihosting
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SEMIHOST_HPP__
+#define __SEMIHOST_HPP__
+
+#include "types.h"
+
+/* Constants */
+#define SEMIHOST_ARM	0x123456	// ARM state SWI
+#define SEMIHOST_THUMB	0xAB		// Thumb state SWI
+#define SEMIHOST_IOVS	16		// Max spans per transfer
+
+/* Operations */
+enum {
+	SH_OPEN    = 0x01,
+	SH_CLOSE   = 0x02,
+	SH_WRITE0  = 0x04,
+	SH_WRITE   = 0x05,
+	SH_READ    = 0x06,
+	SH_CLOCK   = 0x10,
+	SH_EXIT    = 0x18,
+	SH_ELAPSED = 0x30,
+};
+
+/* Exit reasons */
+#define ADP_STOPPED_EXIT	0x20026
+
+/* Forward declarations */
+class ARM;
+
+
+/* Semihosting class */
+class Semihost {
+	ARM *cpu;
+
+	/* Start time (us) */
+	u64 start;
+
+private:
+	/* Parameter block */
+	u32 Arg(u32 idx);
+
+	/* Operation functions */
+	s32 Open   (u32 name, u32 mode, u32 len);
+	s32 Close  (u32 handle);
+	s32 Write0 (u32 address);
+	u32 Write  (u32 handle, u32 address, u32 size);
+	u32 Read   (u32 handle, u32 address, u32 size);
+	u32 Clock  (void);
+	s32 Elapsed(u32 address);
+
+public:
+	Semihost(ARM *cpu);
+
+	/* Call function */
+	void Call(void);
+};
+
+#endif /* __SEMIHOST_HPP__ */
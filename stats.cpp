@@ -0,0 +1,265 @@
+/*
+ * ARM9 emulator - Instruction mix statistics
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "stats.hpp"
+
+using namespace std;
+
+/*
+ * Instructions are classified by the same tests, in the same order, as
+ * the dispatch in ARM::Parse and ARM::ParseThumb, so each handler count
+ * is the number of times that handler ran. Counting happens before the
+ * instruction executes, with the condition tested against the flags it
+ * sees: a branch is taken when its condition passes. Counters are only
+ * bumped while an InstrMix is attached, so a plain run pays a single
+ * pointer test per instruction.
+ */
+
+
+/* Handler names */
+static const char *Names[HANDLER_COUNT] = {
+	"arm_bx", "arm_swi", "arm_mul",
+	"arm_and", "arm_eor", "arm_sub", "arm_rsb", "arm_add", "arm_adc", "arm_sbc", "arm_rsc",
+	"arm_tst_mrs", "arm_teq_msr", "arm_cmp", "arm_cmn", "arm_orr", "arm_mov", "arm_bic", "arm_mvn",
+	"arm_ldr_pc", "arm_ldr_str", "arm_ldm_stm", "arm_b_bl", "arm_mrc_mcr", "arm_other",
+
+	"thumb_shift_add", "thumb_imm", "thumb_alu", "thumb_blx", "thumb_hireg",
+	"thumb_ldr_pc", "thumb_ldr_str_reg", "thumb_ldr_str_imm", "thumb_ldrh_strh",
+	"thumb_ldr_str_sp", "thumb_add_pc_sp", "thumb_misc", "thumb_ldmia_stmia",
+	"thumb_swi", "thumb_bcc", "thumb_b", "thumb_bl", "thumb_other",
+};
+
+/* Transfer size names */
+static const char *Sizes[XFER_COUNT] = { "byte", "half", "word", "multiple" };
+
+
+static bool CountMore(const pair<u64, u32> &a, const pair<u64, u32> &b)
+{
+	if (a.first != b.first)
+		return a.first > b.first;
+
+	return a.second < b.second;
+}
+
+
+InstrMix::InstrMix(void)
+{
+	/* Clear counters */
+	Clear();
+}
+
+void InstrMix::Clear(void)
+{
+	/* Zero counters */
+	memset(&stats, 0, sizeof(stats));
+}
+
+void InstrMix::Arm(u32 opcode, bool pass)
+{
+	u32  handler;
+	bool L = (opcode >> 20) & 1;
+
+	stats.arm++;
+
+	if (!pass)
+		stats.condfail++;
+
+	/* Classify (as ARM::Parse) */
+	if (((opcode >> 8) & 0xFFFFF) == 0x12FFF) {
+		handler = HANDLER_ARM_BX;
+		Branch(pass);
+	} else if ((opcode >> 24) == 0xEF)
+		handler = HANDLER_ARM_SWI;
+	else if (((opcode >> 22) & 0x3F) == 0 && ((opcode >> 4) & 0x0F) == 9)
+		handler = HANDLER_ARM_MUL;
+	else if (((opcode >> 26) & 3) == 0)
+		handler = HANDLER_ARM_DP + ((opcode >> 21) & 0xF);
+	else if (((opcode >> 26) & 3) == 1) {
+		bool B = (opcode >> 22) & 1;
+
+		if (L && ((opcode >> 16) & 0xF) == 15) {
+			handler = HANDLER_ARM_LDRPC;
+
+			if (pass)
+				Transfer(true, XFER_WORD);
+		} else {
+			handler = HANDLER_ARM_LDRSTR;
+
+			if (pass)
+				Transfer(L, (B) ? XFER_BYTE : XFER_WORD);
+		}
+	} else {
+		switch ((opcode >> 25) & 7) {
+		case 4:
+			handler = HANDLER_ARM_LDMSTM;
+
+			if (pass)
+				Transfer(L, XFER_MULTIPLE);
+			break;
+
+		case 5:
+			handler = HANDLER_ARM_B;
+			Branch(pass);
+			break;
+
+		case 7:
+			handler = HANDLER_ARM_MRCMCR;
+			break;
+
+		default:
+			handler = HANDLER_ARM_OTHER;
+			break;
+		}
+	}
+
+	stats.handler[handler]++;
+}
+
+void InstrMix::Thumb(u16 opcode, bool pass)
+{
+	u32  handler;
+	bool L = (opcode >> 11) & 1;
+
+	stats.thumb++;
+
+	if (!pass)
+		stats.condfail++;
+
+	/* Classify (as ARM::ParseThumb) */
+	if ((opcode >> 13) == 0)
+		handler = HANDLER_THUMB_SHIFT;
+	else if ((opcode >> 13) == 1)
+		handler = HANDLER_THUMB_IMM;
+	else if ((opcode >> 10) == 0x10)
+		handler = HANDLER_THUMB_ALU;
+	else if ((opcode >> 7) == 0x8F) {
+		handler = HANDLER_THUMB_BLX;
+		Branch(pass);
+	} else if ((opcode >> 10) == 0x11) {
+		handler = HANDLER_THUMB_HIREG;
+
+		/* BX */
+		if (((opcode >> 8) & 3) == 3)
+			Branch(pass);
+	} else if ((opcode >> 11) == 9) {
+		handler = HANDLER_THUMB_LDRPC;
+		Transfer(true, XFER_WORD);
+	} else if ((opcode >> 12) == 5) {
+		handler = HANDLER_THUMB_LDRREG;
+
+		/* STR, STRB, LDR, LDRB */
+		if (!(opcode & 0x200))
+			Transfer(opcode & 0x800, (opcode & 0x400) ? XFER_BYTE : XFER_WORD);
+	} else if ((opcode >> 13) == 3) {
+		handler = HANDLER_THUMB_LDRIMM;
+		Transfer(L, (opcode & 0x1000) ? XFER_BYTE : XFER_WORD);
+	} else if ((opcode >> 12) == 8) {
+		handler = HANDLER_THUMB_LDRH;
+		Transfer(L, XFER_HALF);
+	} else if ((opcode >> 12) == 9) {
+		handler = HANDLER_THUMB_LDRSP;
+		Transfer(L, XFER_WORD);
+	} else if ((opcode >> 12) == 10)
+		handler = HANDLER_THUMB_ADDR;
+	else if ((opcode >> 12) == 11) {
+		handler = HANDLER_THUMB_MISC;
+
+		/* PUSH, POP */
+		if (((opcode >> 9) & 7) == 2)
+			Transfer(false, XFER_MULTIPLE);
+		if (((opcode >> 9) & 7) == 6)
+			Transfer(true,  XFER_MULTIPLE);
+	} else if ((opcode >> 12) == 12) {
+		handler = HANDLER_THUMB_LDMSTM;
+		Transfer(L, XFER_MULTIPLE);
+	} else if ((opcode >> 8) == 0xDF)
+		handler = HANDLER_THUMB_SWI;
+	else if ((opcode >> 12) == 13) {
+		handler = HANDLER_THUMB_BCC;
+		Branch(pass);
+	} else if ((opcode >> 11) == 28) {
+		handler = HANDLER_THUMB_B;
+		Branch(pass);
+	} else if ((opcode >> 11) == 0x1E) {
+		handler = HANDLER_THUMB_BL;
+		Branch(pass);
+	} else
+		handler = HANDLER_THUMB_OTHER;
+
+	stats.handler[handler]++;
+}
+
+bool InstrMix::Save(const char *filename)
+{
+	vector< pair<u64, u32> > Sorted;
+
+	u64   total = stats.arm + stats.thumb;
+	FILE *fp;
+
+	/* Open file */
+	fp = fopen(filename, "w");
+	if (!fp)
+		return false;
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"instructions\": %llu,\n", total);
+	fprintf(fp, "  \"arm\": %llu,\n",          stats.arm);
+	fprintf(fp, "  \"thumb\": %llu,\n",        stats.thumb);
+	fprintf(fp, "  \"thumb_ratio\": %.6f,\n",  (total) ? (double)stats.thumb / total : 0.0);
+	fprintf(fp, "  \"condition_failed\": %llu,\n", stats.condfail);
+
+	/* Transfers */
+	fprintf(fp, "  \"loads\": {");
+	for (u32 i = 0; i < XFER_COUNT; i++)
+		fprintf(fp, "%s \"%s\": %llu", (i) ? "," : "", Sizes[i], stats.loads[i]);
+	fprintf(fp, " },\n");
+
+	fprintf(fp, "  \"stores\": {");
+	for (u32 i = 0; i < XFER_COUNT; i++)
+		fprintf(fp, "%s \"%s\": %llu", (i) ? "," : "", Sizes[i], stats.stores[i]);
+	fprintf(fp, " },\n");
+
+	/* Branches */
+	fprintf(fp, "  \"branches\": { \"taken\": %llu, \"not_taken\": %llu },\n", stats.taken, stats.nottaken);
+
+	/* Handlers (hottest first) */
+	for (u32 i = 0; i < HANDLER_COUNT; i++) {
+		if (stats.handler[i])
+			Sorted.push_back(make_pair(stats.handler[i], i));
+	}
+
+	sort(Sorted.begin(), Sorted.end(), CountMore);
+
+	fprintf(fp, "  \"handlers\": {");
+	for (u32 i = 0; i < Sorted.size(); i++)
+		fprintf(fp, "%s\n    \"%s\": %llu", (i) ? "," : "", Names[Sorted[i].second], Sorted[i].first);
+	fprintf(fp, "%s}\n", (Sorted.empty()) ? "" : "\n  ");
+
+	fprintf(fp, "}\n");
+
+	/* Close file */
+	fclose(fp);
+
+	return true;
+}
@@ -0,0 +1,124 @@
+/*
+ * ARM9 emulator - Instruction mix statistics
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STATS_HPP__
+#define __STATS_HPP__
+
+#include "types.h"
+
+/* Handlers (in dispatch order) */
+enum {
+	HANDLER_ARM_BX = 0,
+	HANDLER_ARM_SWI,
+	HANDLER_ARM_MUL,
+	HANDLER_ARM_DP,			// 16 opcodes (AND ... MVN)
+	HANDLER_ARM_LDRPC = HANDLER_ARM_DP + 16,
+	HANDLER_ARM_LDRSTR,
+	HANDLER_ARM_LDMSTM,
+	HANDLER_ARM_B,
+	HANDLER_ARM_MRCMCR,
+	HANDLER_ARM_OTHER,
+
+	HANDLER_THUMB_SHIFT,
+	HANDLER_THUMB_IMM,
+	HANDLER_THUMB_ALU,
+	HANDLER_THUMB_BLX,
+	HANDLER_THUMB_HIREG,
+	HANDLER_THUMB_LDRPC,
+	HANDLER_THUMB_LDRREG,
+	HANDLER_THUMB_LDRIMM,
+	HANDLER_THUMB_LDRH,
+	HANDLER_THUMB_LDRSP,
+	HANDLER_THUMB_ADDR,
+	HANDLER_THUMB_MISC,		// SP adjust, PUSH, POP
+	HANDLER_THUMB_LDMSTM,
+	HANDLER_THUMB_SWI,
+	HANDLER_THUMB_BCC,
+	HANDLER_THUMB_B,
+	HANDLER_THUMB_BL,
+	HANDLER_THUMB_OTHER,
+
+	HANDLER_COUNT,
+};
+
+/* Transfer sizes */
+enum {
+	XFER_BYTE     = 0,
+	XFER_HALF     = 1,
+	XFER_WORD     = 2,
+	XFER_MULTIPLE = 3,
+	XFER_COUNT    = 4,
+};
+
+/* Counters (one cache line block per instance) */
+struct InstrStats {
+	u64 arm;
+	u64 thumb;
+	u64 condfail;
+
+	u64 loads [XFER_COUNT];
+	u64 stores[XFER_COUNT];
+
+	u64 taken;			// Branches that passed their condition
+	u64 nottaken;
+
+	u64 handler[HANDLER_COUNT];
+} __attribute__((aligned(64)));
+
+
+/* Instruction mix class */
+class InstrMix {
+	/* Counters */
+	InstrStats stats;
+
+private:
+	inline void Transfer(bool load, u32 size) {
+		if (load)
+			stats.loads [size]++;
+		else
+			stats.stores[size]++;
+	}
+
+	inline void Branch(bool pass) {
+		if (pass)
+			stats.taken++;
+		else
+			stats.nottaken++;
+	}
+
+public:
+	InstrMix(void);
+
+	/* Clear function */
+	void Clear(void);
+
+	/* Count functions (before execution) */
+	void Arm  (u32 opcode, bool pass);
+	void Thumb(u16 opcode, bool pass);
+
+	/* Save function (JSON) */
+	bool Save(const char *filename);
+
+	/* Counters */
+	inline const InstrStats &Stats(void) {
+		return stats;
+	}
+};
+
+#endif /* __STATS_HPP__ */
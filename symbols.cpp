@@ -0,0 +1,651 @@
+/*
+ * ARM9 emulator - Symbol and line index
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+
+#include "endian.h"
+#include "symbols.hpp"
+
+/*
+ * Symbols and line rows are kept in two flat arrays sorted by address,
+ * with names in a single pool, so a lookup is one binary search and the
+ * ELF file is never touched again after loading. Line rows come from a
+ * DWARF (versions 2 to 5) .debug_line program; a row with line 0 marks
+ * the end of a sequence so addresses past it resolve to nothing.
+ */
+
+
+/* DWARF line opcodes */
+enum {
+	DW_LNS_copy             = 1,
+	DW_LNS_advance_pc       = 2,
+	DW_LNS_advance_line     = 3,
+	DW_LNS_set_file         = 4,
+	DW_LNS_const_add_pc     = 8,
+	DW_LNS_fixed_advance_pc = 9,
+
+	DW_LNE_end_sequence     = 1,
+	DW_LNE_set_address      = 2,
+	DW_LNE_define_file      = 3,
+};
+
+/* DWARF 5 entry formats */
+enum {
+	DW_LNCT_path            = 1,
+	DW_LNCT_directory_index = 2,
+
+	DW_FORM_data2           = 0x05,
+	DW_FORM_data4           = 0x06,
+	DW_FORM_data8           = 0x07,
+	DW_FORM_string          = 0x08,
+	DW_FORM_block           = 0x09,
+	DW_FORM_data1           = 0x0B,
+	DW_FORM_strp            = 0x0E,
+	DW_FORM_udata           = 0x0F,
+	DW_FORM_data16          = 0x1E,
+	DW_FORM_line_strp       = 0x1F,
+};
+
+
+/* Index */
+vector<SymbolEntry> Symbols::Syms;
+vector<char>        Symbols::Names;
+vector<LineEntry>   Symbols::Lines;
+vector<string>      Symbols::Files;
+
+
+static u16 Get16(const u8 *ptr)
+{
+	u16 value;
+
+	memcpy(&value, ptr, sizeof(value));
+	return Swap16(value);
+}
+
+static u32 Get32(const u8 *ptr)
+{
+	u32 value;
+
+	memcpy(&value, ptr, sizeof(value));
+	return Swap32(value);
+}
+
+static u32 Uleb(const u8 *&ptr, const u8 *end)
+{
+	u32 value = 0;
+
+	for (u32 shift = 0; ptr < end; shift += 7) {
+		u8 byte = *ptr++;
+
+		if (shift < 32)
+			value |= (byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			break;
+	}
+
+	return value;
+}
+
+static s32 Sleb(const u8 *&ptr, const u8 *end)
+{
+	s32 value = 0;
+	u32 shift = 0;
+	u8  byte  = 0;
+
+	while (ptr < end) {
+		byte = *ptr++;
+
+		if (shift < 32)
+			value |= (byte & 0x7F) << shift;
+		shift += 7;
+
+		if (!(byte & 0x80))
+			break;
+	}
+
+	/* Sign extend */
+	if (shift < 32 && (byte & 0x40))
+		value |= -(1 << shift);
+
+	return value;
+}
+
+static const char *String(const u8 *&ptr, const u8 *end)
+{
+	const char *str = (const char *)ptr;
+
+	/* Skip string */
+	while (ptr < end && *ptr)
+		ptr++;
+
+	if (ptr >= end)
+		return "";
+
+	ptr++;
+	return str;
+}
+
+static const char *Pool(const vector<u8> &pool, u32 offset)
+{
+	/* String in a section */
+	if (offset >= pool.size() || !memchr(&pool[offset], 0, pool.size() - offset))
+		return "";
+
+	return (const char *)&pool[offset];
+}
+
+static bool SymLess(const SymbolEntry &a, const SymbolEntry &b)
+{
+	return a.address < b.address;
+}
+
+static bool LineLess(const LineEntry &a, const LineEntry &b)
+{
+	if (a.address != b.address)
+		return a.address < b.address;
+
+	/* Sequence ends first, so a sequence starting there wins */
+	return !a.line && b.line;
+}
+
+
+bool Symbols::Section(ifstream &File, u32 offset, u32 size, vector<u8> &data)
+{
+	/* Read section */
+	data.resize(size);
+
+	if (!size)
+		return true;
+
+	File.clear();
+	File.seekg(offset, ios::beg);
+	File.read ((char *)&data[0], size);
+
+	return (u32)File.gcount() == size;
+}
+
+void Symbols::LoadSymbols(const vector<u8> &symtab, const vector<u8> &strtab)
+{
+	u32 count = symtab.size() / sizeof(Elf32_Sym);
+
+	for (u32 i = 0; i < count; i++) {
+		const u8 *ptr = &symtab[i * sizeof(Elf32_Sym)];
+
+		u32 name  = Get32(ptr + offsetof(Elf32_Sym, st_name));
+		u32 value = Get32(ptr + offsetof(Elf32_Sym, st_value));
+		u32 size  = Get32(ptr + offsetof(Elf32_Sym, st_size));
+		u16 shndx = Get16(ptr + offsetof(Elf32_Sym, st_shndx));
+		u8  info  = ptr[offsetof(Elf32_Sym, st_info)];
+		u8  type  = ELF32_ST_TYPE(info);
+
+		const char  *str = Pool(strtab, name);
+		SymbolEntry  entry;
+
+		/* Code and labels only */
+		if (type != STT_FUNC && type != STT_NOTYPE)
+			continue;
+		if (shndx == SHN_UNDEF || shndx == SHN_ABS || !*str)
+			continue;
+
+		/* Skip mapping symbols ($a, $t, $d) */
+		if (str[0] == '$')
+			continue;
+
+		/* Add symbol (Thumb functions have bit 0 set) */
+		entry.address = (type == STT_FUNC) ? value & ~1 : value;
+		entry.size    = size;
+		entry.name    = Names.size();
+
+		Names.insert(Names.end(), str, str + strlen(str) + 1);
+		Syms.push_back(entry);
+	}
+}
+
+const u8 *Symbols::LineUnit(const u8 *ptr, const u8 *end, const vector<u8> &str, const vector<u8> &linestr)
+{
+	vector<u32> FileMap;
+	vector<string> Dirs;
+
+	const u8 *prog, *lengths;
+	u32 length, version, minlen, range, opbase;
+	s32 linebase;
+
+	u32 address = 0, file = 1, line = 1;
+
+	/* Unit length (32-bit DWARF only) */
+	if (end - ptr < 4)
+		return end;
+
+	length = Get32(ptr);
+	ptr   += 4;
+
+	if (length >= 0xFFFFFFF0 || length > (u32)(end - ptr))
+		return end;
+
+	end     = ptr + length;
+	version = Get16(ptr);
+	ptr    += 2;
+
+	if (version < 2 || version > 5)
+		return end;
+
+	/* Address and segment selector sizes */
+	if (version >= 5)
+		ptr += 2;
+
+	/* Header length */
+	prog = ptr + 4 + Get32(ptr);
+	ptr += 4;
+
+	if (prog > end)
+		return end;
+
+	minlen   = *ptr++;
+	if (version >= 4)
+		ptr++;			// Maximum operations per instruction
+	ptr++;				// Default is_stmt
+	linebase = (s8)*ptr++;
+	range    = *ptr++;
+	opbase   = *ptr++;
+
+	if (!range || !opbase)
+		return end;
+
+	/* Standard opcode lengths */
+	lengths = ptr;
+	ptr    += opbase - 1;
+
+	if (version < 5) {
+		/* Directories (index 0 is the compilation directory) */
+		Dirs.push_back("");
+
+		while (ptr < prog && *ptr)
+			Dirs.push_back(String(ptr, prog));
+		ptr++;
+
+		/* Files (from index 1) */
+		FileMap.push_back(~0U);
+
+		while (ptr < prog && *ptr) {
+			string name = String(ptr, prog);
+			u32    dir  = Uleb(ptr, prog);
+
+			Uleb(ptr, prog);
+			Uleb(ptr, prog);
+
+			if (dir && dir < Dirs.size() && name[0] != '/')
+				name = Dirs[dir] + "/" + name;
+
+			FileMap.push_back(Files.size());
+			Files.push_back(name);
+		}
+	} else {
+		/* Directories, then files (from index 0) */
+		for (u32 table = 0; table < 2; table++) {
+			vector<u32> format;
+			u32 nformat, count;
+
+			nformat = *ptr++;
+			for (u32 i = 0; i < nformat * 2; i++)
+				format.push_back(Uleb(ptr, prog));
+
+			count = Uleb(ptr, prog);
+
+			for (u32 i = 0; i < count && ptr < prog; i++) {
+				string name;
+				u32    dir = 0;
+
+				for (u32 j = 0; j < nformat; j++) {
+					u32 type  = format[j * 2];
+					u32 form  = format[j * 2 + 1];
+					u32 value = 0;
+
+					const char *sval = NULL;
+
+					switch (form) {
+					case DW_FORM_string:
+						sval = String(ptr, prog);
+						break;
+					case DW_FORM_line_strp:
+						sval = Pool(linestr, Get32(ptr));
+						ptr += 4;
+						break;
+					case DW_FORM_strp:
+						sval = Pool(str, Get32(ptr));
+						ptr += 4;
+						break;
+					case DW_FORM_udata:
+						value = Uleb(ptr, prog);
+						break;
+					case DW_FORM_data1:
+						value = *ptr++;
+						break;
+					case DW_FORM_data2:
+						value = Get16(ptr);
+						ptr  += 2;
+						break;
+					case DW_FORM_data4:
+						value = Get32(ptr);
+						ptr  += 4;
+						break;
+					case DW_FORM_data8:
+						ptr += 8;
+						break;
+					case DW_FORM_data16:
+						ptr += 16;
+						break;
+					case DW_FORM_block:
+						ptr += Uleb(ptr, prog);
+						break;
+					default:
+						/* Unknown form, skip the unit */
+						return end;
+					}
+
+					if (type == DW_LNCT_path && sval)
+						name = sval;
+					if (type == DW_LNCT_directory_index)
+						dir = value;
+				}
+
+				if (!table) {
+					Dirs.push_back(Dirs.empty() ? "" : name);
+					continue;
+				}
+
+				if (dir && dir < Dirs.size() && name[0] != '/')
+					name = Dirs[dir] + "/" + name;
+
+				FileMap.push_back(Files.size());
+				Files.push_back(name);
+			}
+		}
+	}
+
+	/* Run the line program */
+	for (ptr = prog; ptr < end; ) {
+		u8   op   = *ptr++;
+		bool emit = false;
+
+		if (op >= opbase) {
+			/* Special opcode */
+			op      -= opbase;
+			address += (op / range) * minlen;
+			line    += linebase + (op % range);
+			emit     = true;
+		} else if (op) {
+			/* Standard opcode */
+			switch (op) {
+			case DW_LNS_copy:
+				emit = true;
+				break;
+			case DW_LNS_advance_pc:
+				address += Uleb(ptr, end) * minlen;
+				break;
+			case DW_LNS_advance_line:
+				line += Sleb(ptr, end);
+				break;
+			case DW_LNS_set_file:
+				file = Uleb(ptr, end);
+				break;
+			case DW_LNS_const_add_pc:
+				address += ((255 - opbase) / range) * minlen;
+				break;
+			case DW_LNS_fixed_advance_pc:
+				address += Get16(ptr);
+				ptr     += 2;
+				break;
+			default:
+				/* Skip operands */
+				for (u32 i = 0; i < lengths[op - 1]; i++)
+					Uleb(ptr, end);
+				break;
+			}
+		} else {
+			/* Extended opcode */
+			u32 len = Uleb(ptr, end);
+			const u8 *next = ptr + len;
+
+			if (!len || next > end)
+				break;
+
+			switch (*ptr) {
+			case DW_LNE_end_sequence: {
+				LineEntry entry = { address, 0, 0 };
+
+				Lines.push_back(entry);
+
+				address = 0;
+				file    = 1;
+				line    = 1;
+				break;
+			}
+
+			case DW_LNE_set_address:
+				if (len >= 5)
+					address = Get32(ptr + 1);
+				break;
+
+			default:
+				break;
+			}
+
+			ptr = next;
+		}
+
+		/* Append row */
+		if (emit && file < FileMap.size() && FileMap[file] != ~0U) {
+			LineEntry entry = { address, FileMap[file], line };
+
+			Lines.push_back(entry);
+		}
+	}
+
+	return end;
+}
+
+void Symbols::LoadLines(const vector<u8> &data, const vector<u8> &str, const vector<u8> &linestr)
+{
+	const u8 *ptr = &data[0];
+	const u8 *end = ptr + data.size();
+
+	/* Units */
+	while (ptr < end)
+		ptr = LineUnit(ptr, end, str, linestr);
+}
+
+bool Symbols::Load(ifstream &File, u32 shoff, u16 shnum, u16 shstrndx)
+{
+	vector<u8> shdr, names;
+	vector<u8> symtab, strtab, lines, str, linestr;
+
+	const u8 *sh;
+	bool ret;
+
+	/* Drop previous index */
+	Clear();
+
+	/* No section headers */
+	if (!shoff || !shnum || shstrndx >= shnum)
+		return false;
+
+	/* Read section headers */
+	ret = Section(File, shoff, shnum * sizeof(Elf32_Shdr), shdr);
+	if (!ret)
+		return false;
+
+	/* Read section names */
+	sh = &shdr[shstrndx * sizeof(Elf32_Shdr)];
+
+	ret = Section(File, Get32(sh + offsetof(Elf32_Shdr, sh_offset)),
+			    Get32(sh + offsetof(Elf32_Shdr, sh_size)), names);
+	if (!ret)
+		return false;
+
+	/* Find sections */
+	for (u32 i = 0; i < shnum; i++) {
+		sh = &shdr[i * sizeof(Elf32_Shdr)];
+
+		u32 type   = Get32(sh + offsetof(Elf32_Shdr, sh_type));
+		u32 offset = Get32(sh + offsetof(Elf32_Shdr, sh_offset));
+		u32 size   = Get32(sh + offsetof(Elf32_Shdr, sh_size));
+		u32 link   = Get32(sh + offsetof(Elf32_Shdr, sh_link));
+
+		const char *name = Pool(names, Get32(sh + offsetof(Elf32_Shdr, sh_name)));
+
+		if (type == SHT_SYMTAB && link < shnum) {
+			const u8 *strsh = &shdr[link * sizeof(Elf32_Shdr)];
+
+			/* Symbols and their strings */
+			ret  = Section(File, offset, size, symtab);
+			ret &= Section(File, Get32(strsh + offsetof(Elf32_Shdr, sh_offset)),
+					     Get32(strsh + offsetof(Elf32_Shdr, sh_size)), strtab);
+		} else if (!strcmp(name, ".debug_line"))
+			ret = Section(File, offset, size, lines);
+		else if (!strcmp(name, ".debug_line_str"))
+			ret = Section(File, offset, size, linestr);
+		else if (!strcmp(name, ".debug_str"))
+			ret = Section(File, offset, size, str);
+
+		if (!ret) {
+			Clear();
+			return false;
+		}
+	}
+
+	/* Build index */
+	LoadSymbols(symtab, strtab);
+
+	if (!lines.empty())
+		LoadLines(lines, str, linestr);
+
+	stable_sort(Syms.begin(),  Syms.end(),  SymLess);
+	stable_sort(Lines.begin(), Lines.end(), LineLess);
+
+	return true;
+}
+
+bool Symbols::Load(const char *filename)
+{
+	Elf32_Ehdr ehdr;
+	ifstream   File;
+
+	/* Open file */
+	File.open(filename);
+	if (!File.is_open())
+		return false;
+
+	/* Read ELF header */
+	File.read((char *)&ehdr, sizeof(ehdr));
+
+	if (File.gcount() != sizeof(ehdr) || memcmp(ehdr.e_ident, ELFMAG, SELFMAG))
+		return false;
+
+	return Load(File, Swap32(ehdr.e_shoff), Swap16(ehdr.e_shnum), Swap16(ehdr.e_shstrndx));
+}
+
+void Symbols::Clear(void)
+{
+	/* Free index */
+	Syms.clear();
+	Names.clear();
+	Lines.clear();
+	Files.clear();
+}
+
+bool Symbols::Lookup(u32 address, const char *&name, u32 &offset)
+{
+	vector<SymbolEntry>::iterator it;
+	SymbolEntry key;
+
+	/* Last symbol at or before the address */
+	key.address = address;
+
+	it = upper_bound(Syms.begin(), Syms.end(), key, SymLess);
+	if (it == Syms.begin())
+		return false;
+
+	it--;
+
+	/* Past a sized symbol */
+	offset = address - it->address;
+	if (it->size && offset >= it->size)
+		return false;
+
+	name = &Names[it->name];
+	return true;
+}
+
+bool Symbols::Line(u32 address, const char *&file, u32 &line)
+{
+	vector<LineEntry>::iterator it;
+	LineEntry key;
+
+	/* Last row at or before the address */
+	key.address = address;
+	key.line    = 1;
+
+	it = upper_bound(Lines.begin(), Lines.end(), key, LineLess);
+	if (it == Lines.begin())
+		return false;
+
+	it--;
+
+	/* End of a sequence */
+	if (!it->line)
+		return false;
+
+	file = Files[it->file].c_str();
+	line = it->line;
+
+	return true;
+}
+
+string Symbols::Format(u32 address, bool lines)
+{
+	const char *name, *file;
+	u32  offset, line;
+	char buf[32];
+
+	string str;
+
+	/* Function and offset */
+	if (Lookup(address, name, offset)) {
+		str = name;
+
+		if (offset) {
+			snprintf(buf, sizeof(buf), "+0x%X", offset);
+			str += buf;
+		}
+	} else {
+		snprintf(buf, sizeof(buf), "0x%08X", address);
+		str = buf;
+	}
+
+	/* Source line */
+	if (lines && Line(address, file, line)) {
+		snprintf(buf, sizeof(buf), ":%u)", line);
+		str += string(" (") + file + buf;
+	}
+
+	return str;
+}
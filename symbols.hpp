@@ -0,0 +1,82 @@
+/*
+ * ARM9 emulator - Symbol and line index
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SYMBOLS_HPP__
+#define __SYMBOLS_HPP__
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+/* Symbol entry (sorted by address) */
+struct SymbolEntry {
+	u32 address;
+	u32 size;			// 0 if unknown (runs to the next symbol)
+	u32 name;			// Offset in the name pool
+};
+
+/* Line entry (sorted by address) */
+struct LineEntry {
+	u32 address;
+	u32 file;			// Index in the file list
+	u32 line;			// 0 ends a sequence
+};
+
+
+/* Symbol and line index class */
+class Symbols {
+	/* Symbols */
+	static vector<SymbolEntry> Syms;
+	static vector<char>        Names;
+
+	/* Lines */
+	static vector<LineEntry> Lines;
+	static vector<string>    Files;
+
+private:
+	static bool Section(ifstream &File, u32 offset, u32 size, vector<u8> &data);
+
+	static void LoadSymbols(const vector<u8> &symtab, const vector<u8> &strtab);
+	static void LoadLines  (const vector<u8> &data, const vector<u8> &str, const vector<u8> &linestr);
+
+	static const u8 *LineUnit(const u8 *ptr, const u8 *end, const vector<u8> &str, const vector<u8> &linestr);
+
+public:
+	/* Load function (ELF section headers) */
+	static bool Load (ifstream &File, u32 shoff, u16 shnum, u16 shstrndx);
+	static bool Load (const char *filename);
+	static void Clear(void);
+
+	/* Lookup functions */
+	static bool Lookup(u32 address, const char *&name, u32 &offset);
+	static bool Line  (u32 address, const char *&file, u32 &line);
+
+	/* Format an address as function+offset (file:line) */
+	static string Format(u32 address, bool lines = true);
+
+	/* Loaded symbols */
+	static inline bool Empty(void) {
+		return Syms.empty() && Lines.empty();
+	}
+};
+
+#endif /* __SYMBOLS_HPP__ */
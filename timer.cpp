@@ -0,0 +1,215 @@
+/*
+ * ARM9 emulator - Timer device
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "arm.hpp"
+#include "intc.hpp"
+#include "memory.hpp"
+#include "timer.hpp"
+
+/*
+ * The counter is never ticked: a running timer schedules one event for
+ * the cycle it reaches zero. Reads of the value register are computed
+ * from the CPU cycle counter and that deadline, so moving the pending
+ * events (a rewound cycle counter) moves the count with them.
+ */
+
+
+Timer::Timer(ARM *cpu)
+{
+	/* Set parameters */
+	this->cpu = cpu;
+
+	/* Reset registers */
+	load    = 0;
+	control = TIMER_IE;
+	ris     = 0;
+
+	value = 0xFFFFFFFF;
+	event = 0;
+
+	intc = NULL;
+	line = 0;
+}
+
+u32 Timer::Shift(void)
+{
+	/* Prescaler (1, 16, 256) */
+	switch (control & TIMER_PRESCALE) {
+	case 1 << 2:
+		return 4;
+	case 2 << 2:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+u32 Timer::Current(void)
+{
+	u64 start, elapsed;
+
+	/* Stopped */
+	if (!event)
+		return value;
+
+	/* Started count + 1 ticks before the deadline */
+	start   = cpu->Events()->When(event) - (((u64)value + 1) << Shift());
+	elapsed = (cpu->Cycles() - start) >> Shift();
+
+	return value - elapsed;
+}
+
+void Timer::Arm(u64 now, u32 count)
+{
+	/* Count from now */
+	value = count;
+
+	/* Expires after count + 1 ticks (zero is reached, then reloaded) */
+	event = cpu->Events()->Add(now + (((u64)count + 1) << Shift()), Expire, this);
+}
+
+void Timer::Stop(void)
+{
+	/* Latch current value */
+	value = Current();
+
+	/* Cancel expiry */
+	if (event)
+		cpu->Events()->Cancel(event);
+
+	event = 0;
+}
+
+void Timer::Update(void)
+{
+	/* Drive interrupt line */
+	if (intc)
+		intc->Set(line, Pending());
+}
+
+void Timer::Expire(void *priv, u64 when)
+{
+	Timer *Dev = (Timer *)priv;
+
+	/* Raise interrupt */
+	Dev->ris   = 1;
+	Dev->event = 0;
+
+	Dev->Update();
+
+	/* One-shot: halt at zero */
+	if (Dev->control & TIMER_ONESHOT) {
+		Dev->value    = 0;
+		Dev->control &= ~TIMER_ENABLE;
+
+		return;
+	}
+
+	/* Periodic reloads, free-running wraps */
+	Dev->Arm(when, (Dev->control & TIMER_PERIODIC) ? Dev->load : 0xFFFFFFFF);
+}
+
+u32 Timer::Read(void *priv, u32 offset, u8 size)
+{
+	Timer *Dev = (Timer *)priv;
+
+	switch (offset) {
+	case TIMER_LOAD:
+	case TIMER_BGLOAD:
+		return Dev->load;
+
+	case TIMER_VALUE:
+		return Dev->Current();
+
+	case TIMER_CONTROL:
+		return Dev->control;
+
+	case TIMER_RIS:
+		return Dev->ris;
+
+	case TIMER_MIS:
+		return Dev->Pending();
+
+	default:
+		return 0;
+	}
+}
+
+void Timer::Write(void *priv, u32 offset, u32 value, u8 size)
+{
+	Timer *Dev = (Timer *)priv;
+
+	switch (offset) {
+	case TIMER_LOAD:
+		/* Restart from the new value */
+		Dev->load = value;
+
+		if (Dev->event) {
+			Dev->Stop();
+			Dev->Arm(Dev->cpu->Cycles(), value);
+		} else
+			Dev->value = value;
+
+		break;
+
+	case TIMER_BGLOAD:
+		/* Used on the next reload */
+		Dev->load = value;
+		break;
+
+	case TIMER_CONTROL:
+		/* Stop with the old prescaler */
+		if (Dev->event)
+			Dev->Stop();
+
+		Dev->control = value & 0xFF;
+
+		/* Start counting */
+		if (Dev->control & TIMER_ENABLE)
+			Dev->Arm(Dev->cpu->Cycles(), Dev->value);
+
+		Dev->Update();
+		break;
+
+	case TIMER_INTCLR:
+		/* Clear interrupt */
+		Dev->ris = 0;
+
+		Dev->Update();
+		break;
+
+	default:
+		break;
+	}
+}
+
+bool Timer::Attach(u32 base)
+{
+	/* Register device */
+	return Memory::Register(base, TIMER_SIZE, Read, Write, this);
+}
+
+void Timer::Connect(Intc *intc, u32 line)
+{
+	/* Set interrupt line */
+	this->intc = intc;
+	this->line = line;
+
+	Update();
+}
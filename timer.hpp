@@ -0,0 +1,96 @@
+/*
+ * ARM9 emulator - Timer device
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TIMER_HPP__
+#define __TIMER_HPP__
+
+#include "types.h"
+
+/* Constants */
+#define TIMER_SIZE	0x1000		// Register window
+
+/* Registers (SP804 subset) */
+enum {
+	TIMER_LOAD    = 0x00,
+	TIMER_VALUE   = 0x04,
+	TIMER_CONTROL = 0x08,
+	TIMER_INTCLR  = 0x0C,
+	TIMER_RIS     = 0x10,
+	TIMER_MIS     = 0x14,
+	TIMER_BGLOAD  = 0x18,
+};
+
+/* Control register bits */
+enum {
+	TIMER_ONESHOT  = 1 << 0,
+	TIMER_PRESCALE = 3 << 2,	// Divide by 1, 16 or 256
+	TIMER_IE       = 1 << 5,
+	TIMER_PERIODIC = 1 << 6,
+	TIMER_ENABLE   = 1 << 7,
+};
+
+/* Forward declarations */
+class ARM;
+class Intc;
+
+
+/* Timer class */
+class Timer {
+	ARM *cpu;
+
+	/* Registers */
+	u32 load;
+	u32 control;
+	u32 ris;
+
+	/* Counter state */
+	u32 value;			// Value when stopped, start value when running
+	u32 event;			// Pending expiry event (0 if none)
+
+	/* Interrupt line */
+	Intc *intc;
+	u32   line;
+
+private:
+	static u32  Read  (void *priv, u32 offset, u8 size);
+	static void Write (void *priv, u32 offset, u32 value, u8 size);
+	static void Expire(void *priv, u64 when);
+
+	u32  Shift  (void);
+	u32  Current(void);
+	void Arm    (u64 now, u32 count);
+	void Stop   (void);
+	void Update (void);
+
+public:
+	Timer(ARM *cpu);
+
+	/* Attach function */
+	bool Attach(u32 base);
+
+	/* Connect interrupt output */
+	void Connect(Intc *intc, u32 line);
+
+	/* Interrupt output */
+	inline bool Pending(void) {
+		return ris && (control & TIMER_IE);
+	}
+};
+
+#endif /* __TIMER_HPP__ */
@@ -0,0 +1,560 @@
+/*
+ * ARM9 emulator - Binary execution trace
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <sched.h>
+#include <unistd.h>
+
+#include "lz.hpp"
+#include "memory.hpp"
+#include "trace.hpp"
+
+/*
+ * Record layout (all integers are LEB128 varints unless noted):
+ *
+ *   flags           1 byte (REC_*)
+ *   pc delta        zigzag, only with REC_JUMP (relative to the
+ *                   sequential successor of the previous record)
+ *   opcode          2 bytes (Thumb) or 4 bytes (ARM, Thumb BL pair)
+ *   regmask         only with REC_REGS, bit 16 is the cpsr
+ *   reg deltas      zigzag, one per bit set in regmask
+ *   access count    only with REC_MEM, followed per access by
+ *                   1 flag byte, zigzag address delta and value
+ *
+ * Records are packed back to back and cut into TRACE_BLOCK sized
+ * blocks, each compressed with the LZ codec.
+ */
+
+
+static inline u32 ZigZag(u32 value)
+{
+	return (value << 1) ^ ((s32)value >> 31);
+}
+
+static inline u32 UnZigZag(u32 value)
+{
+	return (value >> 1) ^ -(value & 1);
+}
+
+static inline void PutVarint(u8 *buf, u32 &pos, u32 value)
+{
+	while (value >= 0x80) {
+		buf[pos++] = value | 0x80;
+		value    >>= 7;
+	}
+
+	buf[pos++] = value;
+}
+
+
+/*
+ * Trace writer class
+ */
+
+Trace::Trace(void)
+{
+	/* Clear state */
+	ring    = NULL;
+	file    = NULL;
+	running = false;
+}
+
+Trace::~Trace(void)
+{
+	/* Close trace */
+	Close();
+}
+
+void *Trace::Writer(void *arg)
+{
+	Trace *trace = (Trace *)arg;
+
+	u8  *block;
+	u32  fill = 0;
+
+	/* Allocate block */
+	block = new u8[TRACE_BLOCK];
+
+	for (;;) {
+		bool run  = __atomic_load_n(&trace->running, __ATOMIC_ACQUIRE);
+		u32  head = __atomic_load_n(&trace->head,    __ATOMIC_ACQUIRE);
+		u32  tail = trace->tail;
+		u32  len;
+
+		/* Nothing to drain */
+		if (head == tail) {
+			if (!run)
+				break;
+
+			usleep(1000);
+			continue;
+		}
+
+		/* Copy as much as fits in the block */
+		len = head - tail;
+		if (len > TRACE_BLOCK - fill)
+			len = TRACE_BLOCK - fill;
+
+		for (u32 i = 0; i < len; i++)
+			block[fill + i] = trace->ring[(tail + i) & (TRACE_RING - 1)];
+
+		fill += len;
+
+		/* Release ring space */
+		__atomic_store_n(&trace->tail, tail + len, __ATOMIC_RELEASE);
+
+		/* Write full block */
+		if (fill == TRACE_BLOCK) {
+			trace->Flush(block, fill);
+			fill = 0;
+		}
+	}
+
+	/* Write last block */
+	if (fill)
+		trace->Flush(block, fill);
+
+	/* Free block */
+	delete[] block;
+
+	return NULL;
+}
+
+void Trace::Hook(void *priv, u32 address, u32 value, u8 flags)
+{
+	Trace *trace = (Trace *)priv;
+
+	/* Pending list full */
+	if (trace->naccess >= TRACE_ACCESSES)
+		return;
+
+	/* Add access */
+	TraceAccess *acc = &trace->access[trace->naccess++];
+
+	acc->address = address;
+	acc->value   = value;
+	acc->flags   = flags;
+}
+
+void Trace::Push(const u8 *buf, u32 len)
+{
+	/* Wait for the writer to free some space */
+	while (TRACE_RING - (head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) < len) {
+		stalls++;
+		sched_yield();
+	}
+
+	/* Copy record */
+	for (u32 i = 0; i < len; i++)
+		ring[(head + i) & (TRACE_RING - 1)] = buf[i];
+
+	/* Publish record */
+	__atomic_store_n(&head, head + len, __ATOMIC_RELEASE);
+}
+
+bool Trace::Flush(const u8 *buf, u32 len)
+{
+	TraceBlock hdr;
+	u8 *cbuf;
+
+	/* Allocate buffer */
+	cbuf = new u8[LZ_BOUND(len)];
+
+	/* Compress block */
+	hdr.size  = len;
+	hdr.csize = LZ::Compress(buf, len, cbuf);
+
+	/* Store raw if not compressible */
+	if (hdr.csize >= len) {
+		hdr.csize = len;
+		memcpy(cbuf, buf, len);
+	}
+
+	/* Write block */
+	fwrite(&hdr, sizeof(hdr), 1, file);
+	fwrite(cbuf, hdr.csize, 1, file);
+
+	/* Free buffer */
+	delete[] cbuf;
+
+	return true;
+}
+
+bool Trace::Open(const char *filename)
+{
+	TraceHeader hdr;
+	s32 ret;
+
+	/* Open file */
+	file = fopen(filename, "wb");
+	if (!file)
+		return false;
+
+	/* Write header */
+	hdr.magic   = TRACE_MAGIC;
+	hdr.version = TRACE_VERSION;
+
+	fwrite(&hdr, sizeof(hdr), 1, file);
+
+	/* Allocate ring */
+	ring = new u8[TRACE_RING];
+	head = tail = 0;
+
+	/* Reset encoder */
+	memset(regs, 0, sizeof(regs));
+	nextpc   = 0;
+	lastaddr = 0;
+	naccess  = 0;
+	records  = 0;
+	stalls   = 0;
+
+	/* Start writer */
+	running = true;
+
+	ret = pthread_create(&thread, NULL, Writer, this);
+	if (ret) {
+		running = false;
+		Close();
+
+		return false;
+	}
+
+	/* Capture memory accesses */
+	Memory::SetHook(Hook, this);
+
+	return true;
+}
+
+void Trace::Close(void)
+{
+	/* Stop capturing */
+	Memory::SetHook(NULL, NULL);
+
+	/* Stop writer */
+	if (running) {
+		__atomic_store_n(&running, false, __ATOMIC_RELEASE);
+		pthread_join(thread, NULL);
+	}
+
+	/* Close file */
+	if (file) {
+		fclose(file);
+		file = NULL;
+	}
+
+	/* Free ring */
+	delete[] ring;
+	ring = NULL;
+}
+
+void Trace::Record(u32 pc, u32 opcode, u8 flags, const u32 *r, u32 cpsr)
+{
+	u8  buf[TRACE_RECORD];
+	u32 pos  = 1;
+	u32 mask = 0;
+
+	/* PC delta */
+	if (pc != nextpc) {
+		flags |= REC_JUMP;
+		PutVarint(buf, pos, ZigZag(pc - nextpc));
+	}
+
+	/* Opcode */
+	buf[pos++] = opcode;
+	buf[pos++] = opcode >> 8;
+
+	if (!(flags & REC_THUMB) || (flags & REC_WIDE)) {
+		buf[pos++] = opcode >> 16;
+		buf[pos++] = opcode >> 24;
+	}
+
+	/* Register write-backs (PC is implied by the next record) */
+	for (u32 i = 0; i < 15; i++)
+		if (r[i] != regs[i])
+			mask |= 1 << i;
+
+	if (cpsr != regs[16])
+		mask |= 1 << 16;
+
+	if (mask) {
+		flags |= REC_REGS;
+		PutVarint(buf, pos, mask);
+
+		for (u32 i = 0; i < TRACE_REGS; i++) {
+			u32 value;
+
+			if (!(mask & (1 << i)))
+				continue;
+
+			value = (i == 16) ? cpsr : r[i];
+
+			PutVarint(buf, pos, ZigZag(value - regs[i]));
+			regs[i] = value;
+		}
+	}
+
+	/* Memory accesses */
+	if (naccess) {
+		flags |= REC_MEM;
+		PutVarint(buf, pos, naccess);
+
+		for (u32 i = 0; i < naccess; i++) {
+			buf[pos++] = access[i].flags;
+
+			PutVarint(buf, pos, ZigZag(access[i].address - lastaddr));
+			PutVarint(buf, pos, access[i].value);
+
+			lastaddr = access[i].address;
+		}
+
+		naccess = 0;
+	}
+
+	/* Flags */
+	buf[0] = flags;
+
+	/* Next sequential PC */
+	nextpc = pc + ((flags & REC_THUMB) && !(flags & REC_WIDE) ? 2 : 4);
+
+	/* Queue record */
+	Push(buf, pos);
+	records++;
+}
+
+
+/*
+ * Trace reader class
+ */
+
+TraceReader::TraceReader(void)
+{
+	/* Clear state */
+	file  = NULL;
+	block = NULL;
+}
+
+TraceReader::~TraceReader(void)
+{
+	/* Close trace */
+	Close();
+}
+
+bool TraceReader::Fill(void)
+{
+	TraceBlock hdr;
+	u8  *cbuf;
+	bool ret;
+
+	/* Read block header */
+	if (fread(&hdr, sizeof(hdr), 1, file) != 1)
+		return false;
+
+	/* Invalid block */
+	if (hdr.size > TRACE_BLOCK || hdr.csize > LZ_BOUND(hdr.size))
+		return false;
+
+	/* Allocate buffer */
+	cbuf = new u8[hdr.csize];
+
+	/* Read block */
+	ret = (fread(cbuf, hdr.csize, 1, file) == 1);
+
+	/* Decompress block */
+	if (ret) {
+		if (hdr.csize == hdr.size)
+			memcpy(block, cbuf, hdr.size);
+		else
+			ret = LZ::Decompress(cbuf, hdr.csize, block, hdr.size);
+	}
+
+	/* Free buffer */
+	delete[] cbuf;
+
+	/* Set position */
+	size = (ret) ? hdr.size : 0;
+	pos  = 0;
+
+	return ret;
+}
+
+s32 TraceReader::Byte(void)
+{
+	/* Refill block */
+	if (pos >= size && !Fill())
+		return -1;
+
+	return block[pos++];
+}
+
+bool TraceReader::Varint(u32 &value)
+{
+	value = 0;
+
+	for (u32 shift = 0; shift < 35; shift += 7) {
+		s32 b = Byte();
+
+		if (b < 0)
+			return false;
+
+		value |= (b & 0x7F) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+
+	return false;
+}
+
+bool TraceReader::Open(const char *filename)
+{
+	TraceHeader hdr;
+
+	/* Open file */
+	file = fopen(filename, "rb");
+	if (!file)
+		return false;
+
+	/* Read header */
+	if (fread(&hdr, sizeof(hdr), 1, file) != 1 ||
+	    hdr.magic != TRACE_MAGIC || hdr.version != TRACE_VERSION) {
+		Close();
+		return false;
+	}
+
+	/* Allocate block */
+	block = new u8[TRACE_BLOCK];
+	size  = pos = 0;
+
+	/* Reset decoder */
+	memset(regs, 0, sizeof(regs));
+	nextpc   = 0;
+	lastaddr = 0;
+	index    = 0;
+
+	return true;
+}
+
+void TraceReader::Close(void)
+{
+	/* Close file */
+	if (file) {
+		fclose(file);
+		file = NULL;
+	}
+
+	/* Free block */
+	delete[] block;
+	block = NULL;
+}
+
+bool TraceReader::Next(TraceRecord &rec)
+{
+	s32 flags;
+	u32 value;
+
+	/* Flags */
+	flags = Byte();
+	if (flags < 0)
+		return false;
+
+	rec.flags   = flags;
+	rec.index   = index++;
+	rec.pc      = nextpc;
+	rec.regmask = 0;
+	rec.naccess = 0;
+
+	/* PC delta */
+	if (flags & REC_JUMP) {
+		if (!Varint(value))
+			return false;
+
+		rec.pc += UnZigZag(value);
+	}
+
+	/* Opcode */
+	rec.opcode = 0;
+
+	for (u32 i = 0; i < 4; i++) {
+		s32 b;
+
+		if (i == 2 && (flags & REC_THUMB) && !(flags & REC_WIDE))
+			break;
+
+		b = Byte();
+		if (b < 0)
+			return false;
+
+		rec.opcode |= (u32)b << (i * 8);
+	}
+
+	/* Register write-backs */
+	if (flags & REC_REGS) {
+		if (!Varint(rec.regmask))
+			return false;
+
+		for (u32 i = 0; i < TRACE_REGS; i++) {
+			if (!(rec.regmask & (1 << i)))
+				continue;
+
+			if (!Varint(value))
+				return false;
+
+			regs[i] += UnZigZag(value);
+		}
+	}
+
+	/* Memory accesses */
+	if (flags & REC_MEM) {
+		u32 count;
+
+		if (!Varint(count))
+			return false;
+
+		for (u32 i = 0; i < count; i++) {
+			TraceAccess acc;
+			s32 b;
+
+			b = Byte();
+			if (b < 0)
+				return false;
+
+			acc.flags = b;
+
+			if (!Varint(value))
+				return false;
+
+			acc.address = lastaddr + UnZigZag(value);
+			lastaddr    = acc.address;
+
+			if (!Varint(acc.value))
+				return false;
+
+			if (rec.naccess < TRACE_ACCESSES)
+				rec.access[rec.naccess++] = acc;
+		}
+	}
+
+	/* Register state */
+	memcpy(rec.regs, regs, sizeof(regs));
+	rec.regs[15] = rec.pc;
+
+	/* Next sequential PC */
+	nextpc = rec.pc + ((flags & REC_THUMB) && !(flags & REC_WIDE) ? 2 : 4);
+
+	return true;
+}
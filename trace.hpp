@@ -0,0 +1,161 @@
+/*
+ * ARM9 emulator - Binary execution trace
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TRACE_HPP__
+#define __TRACE_HPP__
+
+#include <cstdio>
+#include <pthread.h>
+#include "types.h"
+
+/* Constants */
+#define TRACE_MAGIC	0x544D5241	// "ARMT"
+#define TRACE_VERSION	1
+#define TRACE_BLOCK	(64 * 1024)
+#define TRACE_RING	(4 * 1024 * 1024)
+#define TRACE_ACCESSES	32
+#define TRACE_REGS	17		// r0-r15 + cpsr
+#define TRACE_RECORD	512		// max encoded record
+
+/* Record flags */
+enum {
+	REC_THUMB = 1 << 0,
+	REC_WIDE  = 1 << 1,		// Thumb BL pair
+	REC_JUMP  = 1 << 2,		// Non-sequential PC
+	REC_REGS  = 1 << 3,
+	REC_MEM   = 1 << 4,
+};
+
+/* File header */
+struct TraceHeader {
+	u32 magic;
+	u32 version;
+};
+
+/* Block header */
+struct TraceBlock {
+	u32 size;			// Raw size
+	u32 csize;			// Compressed size (== size if stored)
+};
+
+/* Memory access */
+struct TraceAccess {
+	u32 address;
+	u32 value;			// Size for block accesses
+	u8  flags;			// ACCESS_* flags
+};
+
+/* Decoded record */
+struct TraceRecord {
+	u64 index;
+	u32 pc;
+	u32 opcode;
+	u8  flags;
+
+	/* Registers (after execution) */
+	u32 regmask;
+	u32 regs[TRACE_REGS];
+
+	/* Memory accesses */
+	u32 naccess;
+	TraceAccess access[TRACE_ACCESSES];
+};
+
+
+/* Trace writer class */
+class Trace {
+	/* Ring buffer (single producer, single consumer) */
+	u8 *ring;
+	u32 head;
+	u32 tail;
+
+	/* Writer thread */
+	pthread_t thread;
+	bool      running;
+	FILE     *file;
+
+	/* Encoder state */
+	u32 regs[TRACE_REGS];
+	u32 nextpc;
+	u32 lastaddr;
+
+	/* Pending accesses */
+	TraceAccess access[TRACE_ACCESSES];
+	u32         naccess;
+
+	/* Statistics */
+	u64 records;
+	u64 stalls;
+
+private:
+	static void *Writer(void *arg);
+	static void  Hook  (void *priv, u32 address, u32 value, u8 flags);
+
+	void Push (const u8 *buf, u32 len);
+	bool Flush(const u8 *buf, u32 len);
+
+public:
+	 Trace(void);
+	~Trace(void);
+
+	/* Open/Close functions */
+	bool Open (const char *filename);
+	void Close(void);
+
+	/* Record function */
+	void Record(u32 pc, u32 opcode, u8 flags, const u32 *r, u32 cpsr);
+
+	/* Statistics */
+	inline u64 Records(void) { return records; }
+	inline u64 Stalls (void) { return stalls;  }
+};
+
+/* Trace reader class */
+class TraceReader {
+	FILE *file;
+
+	/* Current block */
+	u8 *block;
+	u32 size;
+	u32 pos;
+
+	/* Decoder state */
+	u32 regs[TRACE_REGS];
+	u32 nextpc;
+	u32 lastaddr;
+	u64 index;
+
+private:
+	bool Fill  (void);
+	s32  Byte  (void);
+	bool Varint(u32 &value);
+
+public:
+	 TraceReader(void);
+	~TraceReader(void);
+
+	/* Open/Close functions */
+	bool Open (const char *filename);
+	void Close(void);
+
+	/* Read function */
+	bool Next(TraceRecord &rec);
+};
+
+#endif /* __TRACE_HPP__ */
@@ -0,0 +1,306 @@
+/*
+ * ARM9 emulator - Trace index
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "memory.hpp"
+#include "trace.hpp"
+#include "traceidx.hpp"
+
+using namespace std;
+
+
+/* Index file suffixes */
+static const char *Suffix[INDEX_COUNT] = { ".exec", ".write" };
+
+
+static bool ExecLess(const IndexExec &a, const IndexExec &b)
+{
+	if (a.pc != b.pc)
+		return a.pc < b.pc;
+
+	return a.index < b.index;
+}
+
+static bool WriteLess(const IndexWrite &a, const IndexWrite &b)
+{
+	if (a.word != b.word)
+		return a.word < b.word;
+
+	return a.index < b.index;
+}
+
+
+TraceIndex::TraceIndex(void)
+{
+	/* Clear state */
+	for (u32 i = 0; i < INDEX_COUNT; i++) {
+		map [i] = NULL;
+		size[i] = 0;
+	}
+
+	execs   = NULL;
+	writes  = NULL;
+	nexecs  = 0;
+	nwrites = 0;
+}
+
+TraceIndex::~TraceIndex(void)
+{
+	/* Close index */
+	Close();
+}
+
+bool TraceIndex::Save(const char *filename, const void *data, u64 count, u32 size)
+{
+	IndexHeader hdr;
+	FILE *fp;
+	bool  ret;
+
+	/* Open file */
+	fp = fopen(filename, "wb");
+	if (!fp)
+		return false;
+
+	/* Header */
+	hdr.magic   = INDEX_MAGIC;
+	hdr.version = INDEX_VERSION;
+	hdr.count   = count;
+
+	/* Write index */
+	ret  = (fwrite(&hdr, sizeof(hdr), 1, fp) == 1);
+	ret &= (!count || fwrite(data, size, count, fp) == count);
+
+	/* Close file */
+	fclose(fp);
+
+	return ret;
+}
+
+bool TraceIndex::Map(const char *filename, u32 kind)
+{
+	IndexHeader *hdr;
+	struct stat  st;
+
+	string name = string(filename) + Suffix[kind];
+	s32    fd;
+
+	/* Open file */
+	fd = open(name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	/* Map file */
+	if (!fstat(fd, &st) && (u64)st.st_size >= sizeof(*hdr)) {
+		map [kind] = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		size[kind] = st.st_size;
+
+		if (map[kind] == MAP_FAILED)
+			map[kind] = NULL;
+	}
+
+	/* Close file */
+	close(fd);
+
+	if (!map[kind])
+		return false;
+
+	/* Check header */
+	hdr = (IndexHeader *)map[kind];
+
+	if (hdr->magic != INDEX_MAGIC || hdr->version != INDEX_VERSION)
+		return false;
+
+	return true;
+}
+
+bool TraceIndex::Build(const char *filename)
+{
+	TraceReader Reader;
+	TraceRecord rec;
+
+	vector<IndexExec>  Execs;
+	vector<IndexWrite> Writes;
+
+	string name;
+	bool   ret;
+
+	/* Open trace */
+	ret = Reader.Open(filename);
+	if (!ret)
+		return false;
+
+	/* Collect entries */
+	while (Reader.Next(rec)) {
+		IndexExec exec;
+
+		/* Execution entry */
+		exec.pc    = rec.pc;
+		exec.pad   = 0;
+		exec.index = rec.index;
+
+		Execs.push_back(exec);
+
+		/* Write entries (one per word touched) */
+		for (u32 i = 0; i < rec.naccess; i++) {
+			TraceAccess *acc = &rec.access[i];
+			IndexWrite   write;
+
+			if (!(acc->flags & ACCESS_WRITE))
+				continue;
+
+			write.address = acc->address;
+			write.index   = rec.index;
+
+			if (acc->flags & ACCESS_BLOCK) {
+				write.size  = acc->value;
+				write.value = 0;
+			} else {
+				write.size  = acc->flags & ACCESS_SIZE;
+				write.value = acc->value;
+			}
+
+			if (!write.size)
+				continue;
+
+			for (u32 word = acc->address & ~3; word <= ((acc->address + write.size - 1) & ~3); word += 4) {
+				write.word = word;
+				Writes.push_back(write);
+
+				/* Wrapped around */
+				if (word == 0xFFFFFFFC)
+					break;
+			}
+		}
+	}
+
+	/* Sort entries */
+	sort(Execs.begin(),  Execs.end(),  ExecLess);
+	sort(Writes.begin(), Writes.end(), WriteLess);
+
+	/* Save indexes */
+	name = string(filename) + Suffix[INDEX_EXEC];
+	ret  = Save(name.c_str(), Execs.empty() ? NULL : &Execs[0], Execs.size(), sizeof(IndexExec));
+	if (!ret)
+		return false;
+
+	name = string(filename) + Suffix[INDEX_WRITE];
+	ret  = Save(name.c_str(), Writes.empty() ? NULL : &Writes[0], Writes.size(), sizeof(IndexWrite));
+
+	return ret;
+}
+
+bool TraceIndex::Open(const char *filename)
+{
+	IndexHeader *hdr;
+
+	/* Map indexes */
+	for (u32 i = 0; i < INDEX_COUNT; i++) {
+		if (!Map(filename, i)) {
+			Close();
+			return false;
+		}
+	}
+
+	/* Execution entries */
+	hdr    = (IndexHeader *)map[INDEX_EXEC];
+	execs  = (IndexExec *)(hdr + 1);
+	nexecs = hdr->count;
+
+	/* Write entries */
+	hdr     = (IndexHeader *)map[INDEX_WRITE];
+	writes  = (IndexWrite *)(hdr + 1);
+	nwrites = hdr->count;
+
+	/* Check sizes */
+	if (sizeof(*hdr) + nexecs  * sizeof(IndexExec)  > size[INDEX_EXEC] ||
+	    sizeof(*hdr) + nwrites * sizeof(IndexWrite) > size[INDEX_WRITE]) {
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void TraceIndex::Close(void)
+{
+	/* Unmap indexes */
+	for (u32 i = 0; i < INDEX_COUNT; i++) {
+		if (map[i])
+			munmap(map[i], size[i]);
+
+		map [i] = NULL;
+		size[i] = 0;
+	}
+
+	execs   = NULL;
+	writes  = NULL;
+	nexecs  = 0;
+	nwrites = 0;
+}
+
+bool TraceIndex::LastWrite(u32 address, u64 before, IndexWrite &entry)
+{
+	const IndexWrite *it;
+	IndexWrite key;
+
+	/* Search key */
+	key.word  = address & ~3;
+	key.index = before;
+
+	/* First entry at or after the key */
+	it = lower_bound(writes, writes + nwrites, key, WriteLess);
+
+	/* Walk back through older writes to this word */
+	while (it != writes) {
+		it--;
+
+		if (it->word != key.word)
+			break;
+
+		/* Write covers the address */
+		if (address >= it->address && address - it->address < it->size) {
+			entry = *it;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+u64 TraceIndex::Executions(u32 pc, const IndexExec *&first)
+{
+	IndexExec lo, hi;
+
+	/* Search range */
+	lo.pc    = hi.pc = pc;
+	lo.index = 0;
+	hi.index = ~0ULL;
+
+	first = lower_bound(execs, execs + nexecs, lo, ExecLess);
+
+	return upper_bound(first, execs + nexecs, hi, ExecLess) - first;
+}
@@ -0,0 +1,93 @@
+/*
+ * ARM9 emulator - Trace index
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TRACEIDX_HPP__
+#define __TRACEIDX_HPP__
+
+#include "types.h"
+
+/* Constants */
+#define INDEX_MAGIC	0x58444E49	// "INDX"
+#define INDEX_VERSION	1
+
+/* Index kinds */
+enum {
+	INDEX_EXEC  = 0,
+	INDEX_WRITE = 1,
+	INDEX_COUNT = 2,
+};
+
+/* File header */
+struct IndexHeader {
+	u32 magic;
+	u32 version;
+	u64 count;
+};
+
+/* Execution entry (sorted by pc, index) */
+struct IndexExec {
+	u32 pc;
+	u32 pad;
+	u64 index;
+};
+
+/* Write entry (sorted by word, index) */
+struct IndexWrite {
+	u32 word;			// Word containing the write
+	u32 address;			// First byte written
+	u32 size;			// Bytes written
+	u32 value;			// Value (0 for block writes)
+	u64 index;
+};
+
+
+/* Trace index class */
+class TraceIndex {
+	/* Mapped indexes */
+	void *map [INDEX_COUNT];
+	u64   size[INDEX_COUNT];
+
+	/* Entries */
+	const IndexExec  *execs;
+	const IndexWrite *writes;
+	u64 nexecs;
+	u64 nwrites;
+
+private:
+	static bool Save(const char *filename, const void *data, u64 count, u32 size);
+
+	bool Map(const char *filename, u32 kind);
+
+public:
+	 TraceIndex(void);
+	~TraceIndex(void);
+
+	/* Build function */
+	static bool Build(const char *filename);
+
+	/* Open/Close functions */
+	bool Open (const char *filename);
+	void Close(void);
+
+	/* Query functions */
+	bool LastWrite (u32 address, u64 before, IndexWrite &entry);
+	u64  Executions(u32 pc, const IndexExec *&first);
+};
+
+#endif /* __TRACEIDX_HPP__ */
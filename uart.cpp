@@ -0,0 +1,73 @@
+/*
+ * ARM9 emulator - UART device
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "memory.hpp"
+#include "uart.hpp"
+
+/*
+ * Transmitted bytes go through a host Writer, so guest console output
+ * is buffered and flushed with the same policy as SWI writes. The
+ * transmitter is always ready and nothing is ever received.
+ */
+
+
+Uart::Uart(Writer *output)
+{
+	/* Set parameters */
+	this->output = output;
+}
+
+u32 Uart::Read(void *priv, u32 offset, u8 size)
+{
+	switch (offset) {
+	case UART_FR:
+		/* Idle transmitter, no input */
+		return UART_FR_TXFE | UART_FR_RXFE;
+
+	default:
+		return 0;
+	}
+}
+
+void Uart::Write(void *priv, u32 offset, u32 value, u8 size)
+{
+	Uart *Dev = (Uart *)priv;
+
+	struct iovec iov;
+	u8 c = value;
+
+	switch (offset) {
+	case UART_DR:
+		/* Transmit byte */
+		iov.iov_base = &c;
+		iov.iov_len  = 1;
+
+		Dev->output->Write(&iov, 1);
+		break;
+
+	default:
+		break;
+	}
+}
+
+bool Uart::Attach(u32 base)
+{
+	/* Register device */
+	return Memory::Register(base, UART_SIZE, Read, Write, this);
+}
@@ -0,0 +1,58 @@
+/*
+ * ARM9 emulator - UART device
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UART_HPP__
+#define __UART_HPP__
+
+#include "types.h"
+#include "writer.hpp"
+
+/* Constants */
+#define UART_SIZE	0x1000		// Register window
+
+/* Registers (PL011 subset) */
+enum {
+	UART_DR = 0x000,		// Data
+	UART_FR = 0x018,		// Flags
+};
+
+/* Flag register bits */
+enum {
+	UART_FR_RXFE = 1 << 4,		// Receive FIFO empty
+	UART_FR_TXFE = 1 << 7,		// Transmit FIFO empty
+};
+
+
+/* UART class */
+class Uart {
+	/* Host output */
+	Writer *output;
+
+private:
+	static u32  Read (void *priv, u32 offset, u8 size);
+	static void Write(void *priv, u32 offset, u32 value, u8 size);
+
+public:
+	Uart(Writer *output);
+
+	/* Attach function */
+	bool Attach(u32 base);
+};
+
+#endif /* __UART_HPP__ */
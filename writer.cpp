@@ -0,0 +1,149 @@
+/*
+ * ARM9 emulator - Buffered host output
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#include "writer.hpp"
+
+
+Writer::Writer(FILE *stream, u32 policy, u32 size)
+{
+	/* Set parameters */
+	this->stream = stream;
+	this->fd     = fileno(stream);
+	this->policy = policy;
+	this->size   = size;
+
+	/* Allocate buffer */
+	buffer = new u8[size];
+	fill   = 0;
+}
+
+Writer::~Writer(void)
+{
+	/* Flush buffer */
+	Flush();
+
+	/* Free buffer */
+	delete[] buffer;
+}
+
+bool Writer::Output(struct iovec *iov, u32 count)
+{
+	/* Keep ordering with stdio output */
+	fflush(stream);
+
+	while (count) {
+		ssize_t ret;
+
+		/* Write spans */
+		ret = writev(fd, iov, count);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+
+		/* Skip written spans */
+		while (count && (size_t)ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			count--;
+		}
+
+		/* Partial span */
+		if (count) {
+			iov->iov_base = (u8 *)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return true;
+}
+
+void Writer::Write(const struct iovec *iov, u32 count)
+{
+	struct iovec vec[WRITER_IOVS + 1];
+
+	bool newline = false;
+	u32  total   = 0;
+
+	/* Data size */
+	for (u32 i = 0; i < count; i++) {
+		total += iov[i].iov_len;
+
+		if (policy == FLUSH_LINE && memchr(iov[i].iov_base, '\n', iov[i].iov_len))
+			newline = true;
+	}
+
+	/* Buffer it */
+	if (fill + total <= size && count <= WRITER_IOVS) {
+		for (u32 i = 0; i < count; i++) {
+			memcpy(buffer + fill, iov[i].iov_base, iov[i].iov_len);
+			fill += iov[i].iov_len;
+		}
+
+		/* Apply policy */
+		if (policy == FLUSH_ALWAYS || newline || fill == size)
+			Flush();
+
+		return;
+	}
+
+	/* Pending data goes first */
+	u32 n = 0;
+
+	if (fill) {
+		vec[n].iov_base = buffer;
+		vec[n].iov_len  = fill;
+		n++;
+	}
+
+	/* Write everything at once */
+	for (u32 i = 0; i < count; i++) {
+		if (n == WRITER_IOVS + 1) {
+			Output(vec, n);
+			n = 0;
+		}
+
+		vec[n++] = iov[i];
+	}
+
+	Output(vec, n);
+	fill = 0;
+}
+
+void Writer::Flush(void)
+{
+	struct iovec vec;
+
+	/* Nothing to flush */
+	if (!fill)
+		return;
+
+	/* Write buffer */
+	vec.iov_base = buffer;
+	vec.iov_len  = fill;
+
+	Output(&vec, 1);
+	fill = 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * ARM9 emulator - Buffered host output
+ * 
+ * Copyright (C) 2011 - Miguel Boton (Waninkoko)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __WRITER_HPP__
+#define __WRITER_HPP__
+
+#include <cstdio>
+#include <sys/uio.h>
+#include "types.h"
+
+/* Constants */
+#define WRITER_SIZE	4096		// Default buffer size
+#define WRITER_IOVS	16		// Max spans per write
+
+/* Flush policies */
+enum {
+	FLUSH_FULL   = 0,		// Only when the buffer fills up
+	FLUSH_LINE   = 1,		// After every newline
+	FLUSH_ALWAYS = 2,		// After every write
+};
+
+
+/* Writer class */
+class Writer {
+	/* Host stream */
+	FILE *stream;
+	s32   fd;
+
+	/* Buffer */
+	u8 *buffer;
+	u32 size;
+	u32 fill;
+
+	/* Flush policy */
+	u32 policy;
+
+private:
+	bool Output(struct iovec *iov, u32 count);
+
+public:
+	 Writer(FILE *stream, u32 policy = FLUSH_LINE, u32 size = WRITER_SIZE);
+	~Writer(void);
+
+	/* Write functions */
+	void Write(const struct iovec *iov, u32 count);
+	void Flush(void);
+
+	/* Policy setup */
+	inline void SetPolicy(u32 val) {
+		policy = val;
+	}
+};
+
+#endif /* __WRITER_HPP__ */